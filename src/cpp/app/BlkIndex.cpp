@@ -0,0 +1,148 @@
+#include "BlkIndex.h"
+
+#include <app/CompressedBlk.h>
+#include <util/log.h>
+#include <util/writeBinary.h>
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr auto headerSize = size_t(4 + 4);
+
+} // namespace
+
+namespace buv {
+
+auto blkIndexFilename(std::filesystem::path const& blkFile) -> std::filesystem::path {
+    auto filename = blkFile;
+    filename += ".idx";
+    return filename;
+}
+
+BlkIndexWriter::BlkIndexWriter(std::filesystem::path const& filename)
+    : mFilename(filename)
+    , mOut(filename, std::ios::binary | std::ios::out) {
+    if (!mOut.is_open()) {
+        throw std::runtime_error(fmt::format("could not open '{}' for writing", filename.string()));
+    }
+    mOut.write("BIDX", 4);
+    util::writeBinary<4>(static_cast<uint32_t>(sizeof(BlkIndexEntry)), mOut);
+}
+
+BlkIndexWriter::BlkIndexWriter(std::filesystem::path const& filename, size_t numBlocks)
+    : mFilename(filename) {
+    auto numEntries = BlkIndex(filename).size();
+    if (numEntries < numBlocks) {
+        throw std::runtime_error(
+            fmt::format("'{}' has {} blocks, expected at least {}", filename.string(), numEntries, numBlocks));
+    }
+    truncate(numBlocks);
+}
+
+void BlkIndexWriter::append(uint64_t fileOffset, uint32_t numBytes, BlockData const& blockData) {
+    if (blockData.blockHeight != mNumEntries) {
+        throw std::runtime_error(fmt::format("BlkIndexWriter: expected block {} but got {}", mNumEntries, blockData.blockHeight));
+    }
+    auto entry = BlkIndexEntry();
+    entry.fileOffset = fileOffset;
+    entry.numBytes = numBytes;
+    entry.blockData = blockData;
+    util::writeBinary<sizeof(BlkIndexEntry)>(entry, mOut);
+    ++mNumEntries;
+}
+
+void BlkIndexWriter::truncate(size_t numBlocks) {
+    mOut.close();
+    std::filesystem::resize_file(mFilename, headerSize + numBlocks * sizeof(BlkIndexEntry));
+    mOut.open(mFilename, std::ios::binary | std::ios::out | std::ios::app);
+    mNumEntries = numBlocks;
+}
+
+void BlkIndexWriter::flush() {
+    mOut.flush();
+}
+
+BlkIndex::BlkIndex(std::filesystem::path const& filename)
+    : mMmap(filename) {
+    if (!mMmap.is_open()) {
+        return;
+    }
+
+    auto recordSize = uint32_t();
+    if (mMmap.size() >= headerSize) {
+        std::memcpy(&recordSize, mMmap.data() + 4, sizeof(uint32_t));
+    }
+    if (recordSize != sizeof(BlkIndexEntry) || 0 != std::memcmp(mMmap.data(), "BIDX", 4)) {
+        throw std::runtime_error(fmt::format("'{}' is not a valid index file", filename.string()));
+    }
+}
+
+auto BlkIndex::is_open() const -> bool {
+    return mMmap.is_open();
+}
+
+auto BlkIndex::size() const -> size_t {
+    if (!is_open()) {
+        return 0;
+    }
+    return (mMmap.size() - headerSize) / sizeof(BlkIndexEntry);
+}
+
+auto BlkIndex::operator[](size_t blockHeight) const -> BlkIndexEntry {
+    auto entry = BlkIndexEntry();
+    std::memcpy(&entry, mMmap.data() + headerSize + blockHeight * sizeof(BlkIndexEntry), sizeof(BlkIndexEntry));
+    return entry;
+}
+
+auto BlkIndex::matches(util::Mmap const& blkFile) const -> bool {
+    if (size() == 0) {
+        return blkFile.size() == 0;
+    }
+    auto last = (*this)[size() - 1];
+
+    // "BLKx" + blockheight + payloadSize
+    return last.fileOffset + 4U + 4U + 4U + last.numBytes == blkFile.size();
+}
+
+auto BlkIndex::frame(util::Mmap const& blkFile, size_t blockHeight) const -> char const* {
+    return blkFile.data() + (*this)[blockHeight].fileOffset;
+}
+
+void buildBlkIndex(util::Mmap const& blkFile, std::filesystem::path const& indexFilename) {
+    if (!blkFile.is_open()) {
+        throw std::runtime_error("file not open");
+    }
+
+    auto writer = BlkIndexWriter(indexFilename);
+    auto const* ptr = blkFile.begin();
+    while (ptr != blkFile.end()) {
+        auto [blockData, nextPtr] = ChangesInBlock::decodeBlockData(ptr);
+        auto numBytes = static_cast<uint32_t>(nextPtr - ptr - (4U + 4U + 4U));
+        writer.append(static_cast<uint64_t>(ptr - blkFile.begin()), numBytes, blockData);
+        ptr = nextPtr;
+    }
+}
+
+auto loadOrBuildBlkIndex(std::filesystem::path const& blkFilename, util::Mmap const& blkFile) -> BlkIndex {
+    if (CompressedBlk::isCompressed(blkFile)) {
+        throw std::runtime_error(
+            fmt::format("'{}' is a compressed .blk file, read it with CompressedBlk instead", blkFilename.string()));
+    }
+    auto indexFilename = blkIndexFilename(blkFilename);
+    {
+        auto index = BlkIndex(indexFilename);
+        if (index.is_open() && index.matches(blkFile)) {
+            return index;
+        }
+    }
+
+    LOG("index '{}' missing or outdated, rebuilding. This could take a while...", indexFilename.string());
+    buildBlkIndex(blkFile, indexFilename);
+    return BlkIndex(indexFilename);
+}
+
+} // namespace buv
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <app/BlockEncoder.h>
+#include <util/Mmap.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+namespace buv {
+
+// Sidecar index for a .blk file. It has a fixed size record for each block height, so any block can be found in O(1) without
+// walking through all the frames before it.
+//
+// clang-format off
+//
+// field size | description  | data type | commment
+// -----------|--------------|-----------|---
+//          4 | marker       | string    | magic marker "BIDX".
+//          4 | record_size  | uint32_t  | sizeof(BlkIndexEntry), to detect incompatible layouts
+// followed by one BlkIndexEntry for each block height, starting at 0.
+//
+// clang-format on
+struct BlkIndexEntry {
+    // offset of the block's "BLK" marker in the .blk file
+    uint64_t fileOffset{};
+
+    // payload size, same as num_bytes in the frame's header
+    uint32_t numBytes{};
+    uint32_t reserved{};
+
+    BlockData blockData{};
+};
+static_assert(std::has_unique_object_representations_v<BlkIndexEntry>);
+
+// the index file that belongs to the .blk file
+[[nodiscard]] auto blkIndexFilename(std::filesystem::path const& blkFile) -> std::filesystem::path;
+
+// Writes the index while the .blk file is written
+class BlkIndexWriter {
+    std::filesystem::path mFilename{};
+    std::ofstream mOut{};
+    size_t mNumEntries{};
+
+public:
+    // Creates (or truncates) the index file
+    explicit BlkIndexWriter(std::filesystem::path const& filename);
+
+    // Opens an existing index file to append to it. Cuts it down to the given number of blocks.
+    BlkIndexWriter(std::filesystem::path const& filename, size_t numBlocks);
+
+    // adds the entry for the next block height. The frame was written at fileOffset of the .blk file.
+    void append(uint64_t fileOffset, uint32_t numBytes, BlockData const& blockData);
+
+    // Cuts the index down to the given number of blocks
+    void truncate(size_t numBlocks);
+
+    void flush();
+};
+
+// Read access to a mmapped index file.
+class BlkIndex {
+    util::Mmap mMmap;
+
+public:
+    explicit BlkIndex(std::filesystem::path const& filename);
+
+    [[nodiscard]] auto is_open() const -> bool;
+
+    // Number of blocks in the index. O(1)
+    [[nodiscard]] auto size() const -> size_t;
+
+    [[nodiscard]] auto operator[](size_t blockHeight) const -> BlkIndexEntry;
+
+    // Checks that the index covers exactly the whole .blk file, without walking through the file.
+    [[nodiscard]] auto matches(util::Mmap const& blkFile) const -> bool;
+
+    // Pointer to the block's frame in the mmapped .blk file
+    [[nodiscard]] auto frame(util::Mmap const& blkFile, size_t blockHeight) const -> char const*;
+};
+
+// Walks through the whole .blk file and writes the index
+void buildBlkIndex(util::Mmap const& blkFile, std::filesystem::path const& indexFilename);
+
+// Opens the .blk file's index. If it does not exist or does not match the .blk file, it is rebuilt first. Throws for a compressed
+// .blk file, that has its own group index.
+[[nodiscard]] auto loadOrBuildBlkIndex(std::filesystem::path const& blkFilename, util::Mmap const& blkFile) -> BlkIndex;
+
+} // namespace buv
@@ -0,0 +1,205 @@
+#include "BlkWriter.h"
+
+#include <util/log.h>
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace buv {
+
+namespace {
+
+// frames are collected until the buffer has that size, then it is written in one go
+constexpr auto bufferSize = size_t(8) * 1024 * 1024;
+
+// the file is preallocated in steps of 256 MB
+constexpr auto allocationStep = uint64_t(256) * 1024 * 1024;
+
+} // namespace
+
+BlkWriter::BlkWriter(std::filesystem::path const& blkFilename, BlkFormat format)
+    : mBlkFilename(blkFilename)
+    , mIndex(blkIndexFilename(blkFilename))
+    , mFormat(format) {
+    // NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    mFileDescriptor = ::open(blkFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFileDescriptor == -1) {
+        throw std::runtime_error(fmt::format("could not open '{}' for writing", blkFilename.string()));
+    }
+    startWriting();
+}
+
+BlkWriter::BlkWriter(std::filesystem::path const& blkFilename, BlkFormat format, size_t numBlocks)
+    : mBlkFilename(blkFilename)
+    , mIndex(blkIndexFilename(blkFilename), numBlocks)
+    , mFormat(format) {
+    if (numBlocks != 0) {
+        auto last = BlkIndex(blkIndexFilename(blkFilename))[numBlocks - 1];
+
+        // "BLKx" + blockheight + payloadSize
+        mFileOffset = last.fileOffset + 4U + 4U + 4U + last.numBytes;
+    }
+
+    // NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    mFileDescriptor = ::open(blkFilename.c_str(), O_WRONLY | O_CLOEXEC);
+    if (mFileDescriptor == -1) {
+        throw std::runtime_error(fmt::format("could not open '{}' for writing", blkFilename.string()));
+    }
+    auto fileSize = std::filesystem::file_size(blkFilename);
+    if (fileSize < mFileOffset || 0 != ::ftruncate(mFileDescriptor, static_cast<off_t>(mFileOffset))) {
+        ::close(mFileDescriptor);
+        throw std::runtime_error(
+            fmt::format("could not cut '{}' with {} bytes down to {} bytes", blkFilename.string(), fileSize, mFileOffset));
+    }
+    mAllocatedSize = mFileOffset;
+    startWriting();
+}
+
+BlkWriter::~BlkWriter() {
+    try {
+        submit();
+        waitIdle();
+    } catch (std::exception const& e) {
+        LOG("BlkWriter: could not write '{}': {}", mBlkFilename.string(), e.what());
+    }
+    {
+        auto lock = std::lock_guard(mMutex);
+        mIsStopped = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+
+    // cut off the preallocated but unused part
+    (void)::ftruncate(mFileDescriptor, static_cast<off_t>(mFileOffset));
+    ::close(mFileDescriptor);
+}
+
+void BlkWriter::write(ChangesInBlock const& cib) {
+    auto frameBegin = mBuffer.size();
+    cib.encodeInto(mBuffer, mFormat);
+    auto frameSize = mBuffer.size() - frameBegin;
+
+    // "BLKx" + blockheight + payloadSize
+    mIndex.append(mFileOffset, static_cast<uint32_t>(frameSize - (4U + 4U + 4U)), cib.blockData());
+    mFileOffset += frameSize;
+
+    if (mBuffer.size() >= bufferSize) {
+        submit();
+    }
+}
+
+void BlkWriter::flush() {
+    submit();
+    waitIdle();
+    if (0 != ::fdatasync(mFileDescriptor)) {
+        throw std::runtime_error(fmt::format("could not sync '{}': {}", mBlkFilename.string(), std::strerror(errno)));
+    }
+    mIndex.flush();
+}
+
+void BlkWriter::truncate(size_t numBlocks, uint64_t fileOffset) {
+    submit();
+    waitIdle();
+    if (0 != ::ftruncate(mFileDescriptor, static_cast<off_t>(fileOffset))) {
+        throw std::runtime_error(fmt::format("could not truncate '{}': {}", mBlkFilename.string(), std::strerror(errno)));
+    }
+    mIndex.truncate(numBlocks);
+    mFileOffset = fileOffset;
+}
+
+void BlkWriter::startWriting() {
+    mBuffer.reserve(bufferSize + bufferSize / 4);
+    mPending.reserve(bufferSize + bufferSize / 4);
+    mThread = std::thread([this] {
+        writeLoop();
+    });
+}
+
+auto BlkWriter::fileOffset() const -> uint64_t {
+    return mFileOffset;
+}
+
+void BlkWriter::submit() {
+    if (mBuffer.empty()) {
+        return;
+    }
+    waitIdle();
+    {
+        auto lock = std::lock_guard(mMutex);
+
+        // swap, so both buffers keep their capacity
+        std::swap(mBuffer, mPending);
+        mPendingFileOffset = mFileOffset - mPending.size();
+        mHasPending = true;
+    }
+    mCondition.notify_all();
+}
+
+void BlkWriter::waitIdle() {
+    auto lock = std::unique_lock(mMutex);
+    mCondition.wait(lock, [this] {
+        return !mHasPending;
+    });
+    if (mError) {
+        std::rethrow_exception(std::exchange(mError, nullptr));
+    }
+}
+
+void BlkWriter::writeLoop() {
+    auto lock = std::unique_lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] {
+            return mHasPending || mIsStopped;
+        });
+        if (!mHasPending) {
+            return;
+        }
+
+        // mPending is not touched by the main thread while mHasPending is set
+        lock.unlock();
+        try {
+            auto endOffset = mPendingFileOffset + mPending.size();
+            if (endOffset > mAllocatedSize) {
+                // KEEP_SIZE so that readers never see the preallocated zeros. Not all filesystems support it, that's fine.
+                auto newSize = endOffset + allocationStep;
+                (void)::fallocate(mFileDescriptor,
+                                  FALLOC_FL_KEEP_SIZE,
+                                  static_cast<off_t>(mAllocatedSize),
+                                  static_cast<off_t>(newSize - mAllocatedSize));
+                mAllocatedSize = newSize;
+            }
+
+            auto const* ptr = mPending.data();
+            auto remaining = mPending.size();
+            auto offset = static_cast<off_t>(mPendingFileOffset);
+            while (remaining > 0) {
+                auto numWritten = ::pwrite(mFileDescriptor, ptr, remaining, offset);
+                if (numWritten < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error(fmt::format("pwrite failed: {}", std::strerror(errno)));
+                }
+                ptr += numWritten;
+                remaining -= static_cast<size_t>(numWritten);
+                offset += numWritten;
+            }
+            lock.lock();
+        } catch (...) {
+            lock.lock();
+            mError = std::current_exception();
+        }
+        mPending.clear();
+        mHasPending = false;
+        mCondition.notify_all();
+    }
+}
+
+} // namespace buv
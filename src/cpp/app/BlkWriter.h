@@ -0,0 +1,84 @@
+#pragma once
+
+#include <app/BlkIndex.h>
+#include <app/BlockEncoder.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace buv {
+
+// Writes the .blk file together with its index.
+//
+// Frames are encoded into a large buffer. When it is full, it is handed to a background thread that writes it with pwrite, while
+// the next frames are encoded into the other buffer. The file is preallocated with fallocate in large steps, so it does not
+// fragment. Nothing is guaranteed to be on disk until flush() is called.
+class BlkWriter {
+    std::filesystem::path mBlkFilename{};
+    int mFileDescriptor = -1;
+    BlkIndexWriter mIndex;
+    BlkFormat mFormat{};
+    uint64_t mFileOffset{};
+
+    // frames that have not yet been handed to the background thread
+    std::string mBuffer{};
+
+    // shared with the background thread
+    std::mutex mMutex{};
+    std::condition_variable mCondition{};
+    std::string mPending{};
+    uint64_t mPendingFileOffset{};
+    bool mHasPending = false;
+    bool mIsStopped = false;
+    std::exception_ptr mError{};
+
+    // only used by the background thread
+    uint64_t mAllocatedSize{};
+
+    std::thread mThread{};
+
+public:
+    // Creates (or truncates) the .blk file and its index
+    explicit BlkWriter(std::filesystem::path const& blkFilename, BlkFormat format = BlkFormat::varint);
+
+    // Opens an existing .blk file and its index to append to them. Everything after the first numBlocks blocks is cut off.
+    BlkWriter(std::filesystem::path const& blkFilename, BlkFormat format, size_t numBlocks);
+
+    // writes everything that is still buffered
+    ~BlkWriter();
+
+    BlkWriter(BlkWriter const&) = delete;
+    BlkWriter(BlkWriter&&) = delete;
+    auto operator=(BlkWriter const&) -> BlkWriter& = delete;
+    auto operator=(BlkWriter&&) -> BlkWriter& = delete;
+
+    // appends the encoded frame of the next block
+    void write(ChangesInBlock const& cib);
+
+    // Checkpoint: writes all buffered frames, waits until they are on disk (fdatasync), and flushes the index.
+    void flush();
+
+    // Cuts off everything after the given block
+    void truncate(size_t numBlocks, uint64_t fileOffset);
+
+    // where the next frame will be written
+    [[nodiscard]] auto fileOffset() const -> uint64_t;
+
+private:
+    void startWriting();
+
+    // hands mBuffer to the background thread. Waits if it is still busy with the previous buffer.
+    void submit();
+
+    // waits until the background thread is idle, and rethrows its error
+    void waitIdle();
+
+    void writeLoop();
+};
+
+} // namespace buv
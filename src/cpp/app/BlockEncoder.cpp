@@ -1,19 +1,148 @@
 #include "BlockEncoder.h"
 
 #include <util/BinaryStreamWriter.h>
+#include <util/BitStream.h>
+#include <util/StreamVByte.h>
 #include <util/VarInt.h>
 #include <util/hex.h>
+#include <util/radixSort.h>
 #include <util/writeBinary.h>
 
 #include <fmt/format.h>
 
 namespace buv {
 
+namespace {
+
+// The values stored by BlkFormat::streamVByte and BlkFormat::golombRice
+struct Columns {
+    // difference to the previous amount, for all but the first change
+    std::vector<uint64_t> amountDiffs{};
+
+    // zig-zag encoded difference to the previous block height (starting with 0), for all spent changes
+    std::vector<uint32_t> blockDiffs{};
+};
+
+// fills the columns, reusing their capacity
+void toColumns(ChangeSpans const& changes, size_t numSpent, Columns& columns) {
+    columns.amountDiffs.clear();
+    columns.blockDiffs.clear();
+    if (changes.empty()) {
+        return;
+    }
+
+    // counts are expanded into repeats, which have a diff of 0. Due to the sorting, all spent changes come first.
+    columns.amountDiffs.reserve(changes.size() - 1);
+    auto idx = size_t();
+    auto preSatoshi = int64_t();
+    auto preBlockHeight = int32_t();
+    changes.forEach([&](int64_t satoshi, uint32_t blockHeight, uint32_t count) {
+        if (idx != 0) {
+            columns.amountDiffs.push_back(static_cast<uint64_t>(satoshi - preSatoshi));
+        }
+        columns.amountDiffs.insert(columns.amountDiffs.end(), count - 1, 0);
+        preSatoshi = satoshi;
+
+        if (idx < numSpent) {
+            auto diff = static_cast<int32_t>(blockHeight) - preBlockHeight;
+            columns.blockDiffs.push_back(static_cast<uint32_t>((diff << 1) ^ (diff >> 31)));
+            columns.blockDiffs.insert(columns.blockDiffs.end(), count - 1, 0);
+            preBlockHeight = static_cast<int32_t>(blockHeight);
+        }
+        ++idx;
+    });
+}
+
+} // namespace
+
+void ChangesInBlock::clearChanges() {
+    mSatoshis.clear();
+    mBlockHeights.clear();
+    mRuns.clear();
+    mNumSpent = 0;
+}
+
+void ChangesInBlock::appendChange(int64_t satoshi, uint32_t blockHeight, uint32_t count) {
+    if (!mSatoshis.empty() && mSatoshis.back() == satoshi && mBlockHeights.back() == blockHeight) {
+        addCount(mSatoshis.size() - 1, count);
+        return;
+    }
+    mSatoshis.push_back(satoshi);
+    mBlockHeights.push_back(blockHeight);
+    if (count != 1) {
+        mRuns.push_back(CountRun{static_cast<uint32_t>(mSatoshis.size() - 1), count});
+    }
+}
+
+void ChangesInBlock::addCount(size_t idx, uint32_t count) {
+    if (!mRuns.empty() && mRuns.back().idx == idx) {
+        mRuns.back().count += count;
+    } else {
+        mRuns.push_back(CountRun{static_cast<uint32_t>(idx), 1 + count});
+    }
+}
+
+void ChangesInBlock::updateNumSpent() {
+    auto it = std::partition_point(mSatoshis.begin(), mSatoshis.end(), [](int64_t satoshi) {
+        return satoshi <= 0;
+    });
+    mNumSpent = static_cast<size_t>(std::distance(mSatoshis.begin(), it));
+}
+
+// Repeats are merged into counts. A repeat is a diff of 0 in all columns, so no values have to be compared. The columns are sized
+// for the worst case and written directly, then cut down to the number of distinct changes.
+void ChangesInBlock::fromColumns(int64_t satoshi,
+                                 uint64_t const* amountDiffs,
+                                 size_t numChanges,
+                                 uint32_t const* blockDiffs,
+                                 size_t numSpent) {
+    if (numSpent > numChanges) {
+        throw std::runtime_error(fmt::format("Decoding error, {} spent but only {} changes", numSpent, numChanges));
+    }
+    mSatoshis.resize(numChanges);
+    mBlockHeights.resize(numChanges);
+    mRuns.clear();
+    auto* satoshis = mSatoshis.data();
+    auto* blockHeights = mBlockHeights.data();
+
+    // first change of each part is never a repeat: spent and unspent changes differ in the sign of the amount
+    auto numDistinct = size_t();
+    auto blockHeight = int32_t();
+    for (size_t i = 0; i < numSpent; ++i) {
+        auto amountDiff = i == 0 ? uint64_t() : amountDiffs[i - 1];
+        satoshi += static_cast<int64_t>(amountDiff);
+        blockHeight += util::zigzagDecode<int32_t>(blockDiffs[i]);
+        if (i != 0 && (amountDiff | blockDiffs[i]) == 0) {
+            addCount(numDistinct - 1, 1);
+            continue;
+        }
+        satoshis[numDistinct] = satoshi;
+        blockHeights[numDistinct] = static_cast<uint32_t>(blockHeight);
+        ++numDistinct;
+    }
+    for (size_t i = numSpent; i < numChanges; ++i) {
+        auto amountDiff = i == 0 ? uint64_t() : amountDiffs[i - 1];
+        satoshi += static_cast<int64_t>(amountDiff);
+        if (i != numSpent && amountDiff == 0) {
+            addCount(numDistinct - 1, 1);
+            continue;
+        }
+        satoshis[numDistinct] = satoshi;
+        blockHeights[numDistinct] = mBlockData.blockHeight;
+        ++numDistinct;
+    }
+
+    mSatoshis.resize(numDistinct);
+    mBlockHeights.resize(numDistinct);
+    updateNumSpent();
+}
+
 auto ChangesInBlock::beginBlock(uint32_t blockHeight) -> BlockData& {
     mIsFinalized = false;
     mBlockData = {};
     mBlockData.blockHeight = blockHeight;
-    mChangeAtBlockheights.clear();
+    mAddedChanges.clear();
+    clearChanges();
     return mBlockData;
 }
 
@@ -22,11 +151,21 @@ void ChangesInBlock::finalizeBlock() {
         throw std::runtime_error("finalizeBlock() has already been called, not needed any more");
     }
     sort();
+
+    // identical changes are next to each other after sorting, appendChange() merges them
+    clearChanges();
+    mSatoshis.reserve(mAddedChanges.size());
+    mBlockHeights.reserve(mAddedChanges.size());
+    for (auto const& change : mAddedChanges) {
+        appendChange(change.satoshi(), change.blockHeight(), change.count());
+    }
+    updateNumSpent();
+    mAddedChanges.clear();
     mIsFinalized = true;
 }
 
 void ChangesInBlock::sort() {
-    std::sort(mChangeAtBlockheights.begin(), mChangeAtBlockheights.end());
+    sortChanges(mAddedChanges);
 }
 
 void ChangesInBlock::addChange(int64_t satoshi, uint32_t blockHeight) {
@@ -36,17 +175,83 @@ void ChangesInBlock::addChange(int64_t satoshi, uint32_t blockHeight) {
     if (mIsFinalized) {
         throw std::runtime_error("can't add an amount after finalizeBlock()");
     }
-    mChangeAtBlockheights.emplace_back(satoshi, blockHeight);
+    mAddedChanges.emplace_back(satoshi, blockHeight);
+}
+
+void sortChanges(std::vector<ChangeAtBlockheight>& changes) {
+    if (std::is_sorted(changes.begin(), changes.end())) {
+        // e.g. already sorted while preprocessing the block
+        return;
+    }
+
+    // the radix sort needs several passes over all changes, which only pays off for large blocks
+    static constexpr auto minRadixSortSize = size_t(2000);
+    if (changes.size() < minRadixSortSize) {
+        std::sort(changes.begin(), changes.end());
+        return;
+    }
+
+    // reused across blocks, so sorting does not allocate
+    thread_local auto scratch = std::vector<ChangeAtBlockheight>();
+
+    // radix sort is stable, so sort by blockheight first and then by satoshi. Keys are relative to the smallest value, so only
+    // as many passes as the range of values needs.
+    auto [minHeightIt, maxHeightIt] = std::minmax_element(changes.begin(), changes.end(), [](auto const& a, auto const& b) {
+        return a.blockHeight() < b.blockHeight();
+    });
+    auto minHeight = minHeightIt->blockHeight();
+    auto numHeightBits = util::radixKeyBits(maxHeightIt->blockHeight() - minHeight);
+    util::radixSort(changes, scratch, numHeightBits, [minHeight](ChangeAtBlockheight const& change) {
+        return change.blockHeight() - minHeight;
+    });
+
+    auto [minIt, maxIt] = std::minmax_element(changes.begin(), changes.end(), [](auto const& a, auto const& b) {
+        return a.satoshi() < b.satoshi();
+    });
+    auto minSatoshi = static_cast<uint64_t>(minIt->satoshi());
+    auto numKeyBits = util::radixKeyBits(static_cast<uint64_t>(maxIt->satoshi()) - minSatoshi);
+    util::radixSort(changes, scratch, numKeyBits, [minSatoshi](ChangeAtBlockheight const& change) {
+        return static_cast<uint64_t>(change.satoshi()) - minSatoshi;
+    });
 }
 
-auto ChangesInBlock::encode() const -> std::string {
+auto parseBlkFormat(std::string_view name) -> BlkFormat {
+    if (name == "varint") {
+        return BlkFormat::varint;
+    }
+    if (name == "streamvbyte") {
+        return BlkFormat::streamVByte;
+    }
+    if (name == "golombrice") {
+        return BlkFormat::golombRice;
+    }
+    if (name == "varintrle") {
+        return BlkFormat::varintRle;
+    }
+    throw std::runtime_error(
+        fmt::format("unknown blk format '{}', use 'varint', 'streamvbyte', 'golombrice', or 'varintrle'", name));
+}
+
+auto ChangesInBlock::encode(BlkFormat format) const -> std::string {
+    auto data = std::string();
+    encodeInto(data, format);
+    return data;
+}
+
+void ChangesInBlock::encodeInto(std::string& data, BlkFormat format) const {
     if (!mIsFinalized) {
         throw std::runtime_error("can't encode finalizedBlock() was not called");
     }
 
-    auto data = std::string();
+    // Upper bound for the varint formats, so the many small appends don't need to grow the buffer: fixed header with 4 varints,
+    // and for each change 2 varints plus the count.
+    static constexpr auto maxHeaderSize = size_t(4 + 4 + 4 + 32 + 32 + 32 + 8 + 4 + 4 + 4 + 4 + 4 + 4 * 5);
+    static constexpr auto maxChangeSize = size_t(10 + 10 + 10 + 5);
+    auto const frameBegin = data.size();
+    data.reserve(frameBegin + maxHeaderSize + mSatoshis.size() * maxChangeSize);
 
-    data += std::string_view("BLK\x02");
+    data += std::string_view("BLK");
+    data += static_cast<char>(format);
     util::writeBinary<4>(mBlockData.blockHeight, data);
 
     // skip 4 bytes, which will later contain the size of the remaining payload. This can be used to quickly skip to the next
@@ -69,53 +274,157 @@ auto ChangesInBlock::encode() const -> std::string {
     data += varIntEncoder.encode<uint32_t>(mBlockData.strippedSize);
     data += varIntEncoder.encode<uint32_t>(mBlockData.weight);
 
-    if (!mChangeAtBlockheights.empty()) {
-        // now comes the data in mChangeAtBlockheight. Sorted by satoshi, so the satoshi's only increase.
-        // The first entry will probably be negative, if any old amount was spent. That is encoded as var_int.
-        //
-        // We only store the difference to the previous satoshi amount for the following entries, encoded as unsigned varint.
-        // Thus, the amounts will be stored quite compact. Only thing better would be golomb coded sets
-        // https://en.wikipedia.org/wiki/Golomb_coding
-        //
-        // We also store diffs of block size, but they will be encoded as signed integers, because they can be quite random.
-        // already sorted in finishBlock()
-
-        auto it = mChangeAtBlockheights.begin();
-        data += varIntEncoder.encode<int64_t>(it->satoshi());
-        data += varIntEncoder.encode<uint64_t>(it->blockHeight());
-
-        auto pre = it;
-        ++it;
-
-        while (it != mChangeAtBlockheights.end()) {
-            // the amount diff will always be positive since its sorted, so we can serialize an uint
-            data += varIntEncoder.encode<uint64_t>(it->satoshi() - pre->satoshi());
-
-            // only encode blockheight if satoshi is negative. Any satoshi that is positive will have the current block.
-            if (it->satoshi() <= 0) {
-                // diff of blockheight can be negative as well
-                data += varIntEncoder.encode<int64_t>(static_cast<int64_t>(it->blockHeight()) -
-                                                      static_cast<int64_t>(pre->blockHeight()));
-            }
-            pre = it;
-            ++it;
+    if (format == BlkFormat::streamVByte) {
+        encodeStreamVByte(data);
+    } else if (format == BlkFormat::golombRice) {
+        encodeGolombRice(data);
+    } else if (!mSatoshis.empty()) {
+        encodeVarint(data, format == BlkFormat::varintRle);
+    } else {
+        // without changes the payload size stays 0
+        return;
+    }
+
+    // finally, fill in the payload size
+    // "BLKx" + blockheight + payloadSize
+    auto payloadSize = static_cast<uint32_t>(data.size() - frameBegin - (4U + 4U + 4U));
+    std::memcpy(data.data() + frameBegin + (4U + 4U), &payloadSize, 4U);
+}
+
+void ChangesInBlock::encodeVarint(std::string& data, bool isRle) const {
+    // now comes the data in the columns. Sorted by satoshi, so the satoshi's only increase.
+    // The first entry will probably be negative, if any old amount was spent. That is encoded as var_int.
+    //
+    // We only store the difference to the previous satoshi amount for the following entries, encoded as unsigned varint.
+    // Thus, the amounts will be stored quite compact. Only thing better would be golomb coded sets
+    // https://en.wikipedia.org/wiki/Golomb_coding
+    //
+    // We also store diffs of block size, but they will be encoded as signed integers, because they can be quite random.
+    // already sorted in finishBlock()
+    auto varIntEncoder = util::VarInt();
+
+    // a repeat of the previous change has amount_diff 0, and block_diff 0 if spent. Called for each change in order, so the runs
+    // are walked alongside.
+    auto run = mRuns.begin();
+    auto encodeCount = [&](size_t idx) {
+        if (run == mRuns.end() || run->idx != idx) {
+            return;
         }
+        auto count = run->count;
+        ++run;
+        auto isSpent = idx < mNumSpent;
+        data += varIntEncoder.encode<uint64_t>(0);
+        if (isSpent) {
+            data += varIntEncoder.encode<int64_t>(0);
+        }
+        if (isRle) {
+            data += varIntEncoder.encode<uint64_t>(count - 2);
+            return;
+        }
+        // BlkFormat::varint repeats the change. Both varints of 0 are a single 0 byte.
+        auto repeatSize = size_t(isSpent ? 2 : 1);
+        data.append((count - 2) * repeatSize, '\0');
+    };
+
+    data += varIntEncoder.encode<int64_t>(mSatoshis[0]);
+    data += varIntEncoder.encode<uint64_t>(mBlockHeights[0]);
+    encodeCount(0);
+
+    for (size_t i = 1; i < mSatoshis.size(); ++i) {
+        // the amount diff will always be positive since its sorted, so we can serialize an uint
+        data += varIntEncoder.encode<uint64_t>(mSatoshis[i] - mSatoshis[i - 1]);
+
+        // only encode blockheight if satoshi is negative. Any satoshi that is positive will have the current block.
+        if (i < mNumSpent) {
+            // diff of blockheight can be negative as well
+            data += varIntEncoder.encode<int64_t>(static_cast<int64_t>(mBlockHeights[i]) -
+                                                  static_cast<int64_t>(mBlockHeights[i - 1]));
+        }
+        encodeCount(i);
+    }
+}
 
-        // finally, fill in the payload size
-        // "BLKx" + blockheight + payloadSize
-        auto payloadSize = static_cast<uint32_t>(data.size() - (4U + 4U + 4U));
-        std::memcpy(data.data() + (4U + 4U), &payloadSize, 4U);
+void ChangesInBlock::encodeStreamVByte(std::string& data) const {
+    // reused so encoding doesn't need to allocate for each block
+    thread_local auto columns = Columns();
+    auto varIntEncoder = util::VarInt();
+    toColumns(changes(), mNumSpent, columns);
+
+    // counts are expanded, so this is the number of utxos
+    data += varIntEncoder.encode<uint64_t>(mSatoshis.empty() ? 0 : columns.amountDiffs.size() + 1);
+    data += varIntEncoder.encode<uint64_t>(columns.blockDiffs.size());
+    if (mSatoshis.empty()) {
+        return;
     }
+    data += varIntEncoder.encode<int64_t>(mSatoshis.front());
 
-    return data;
+    thread_local auto amountColumn = std::string();
+    amountColumn.clear();
+    util::streamVByteEncode64(columns.amountDiffs.data(), columns.amountDiffs.size(), amountColumn);
+    data += varIntEncoder.encode<uint64_t>(amountColumn.size());
+    data += amountColumn;
+
+    util::streamVByteEncode32(columns.blockDiffs.data(), columns.blockDiffs.size(), data);
+}
+
+void ChangesInBlock::encodeGolombRice(std::string& data) const {
+    // reused so encoding doesn't need to allocate for each block
+    thread_local auto columns = Columns();
+    auto varIntEncoder = util::VarInt();
+    toColumns(changes(), mNumSpent, columns);
+
+    // counts are expanded, so this is the number of utxos
+    data += varIntEncoder.encode<uint64_t>(mSatoshis.empty() ? 0 : columns.amountDiffs.size() + 1);
+    data += varIntEncoder.encode<uint64_t>(columns.blockDiffs.size());
+    if (mSatoshis.empty()) {
+        return;
+    }
+    data += varIntEncoder.encode<int64_t>(mSatoshis.front());
+
+    thread_local auto blockDiffs = std::vector<uint64_t>();
+    blockDiffs.assign(columns.blockDiffs.begin(), columns.blockDiffs.end());
+    auto kAmount = util::optimalRiceK(columns.amountDiffs.data(), columns.amountDiffs.size());
+    auto kBlock = util::optimalRiceK(blockDiffs.data(), blockDiffs.size());
+    data += static_cast<char>(kAmount);
+    data += static_cast<char>(kBlock);
+
+    auto writer = util::BitWriter(data);
+    for (auto val : columns.amountDiffs) {
+        writer.writeRice(val, kAmount);
+    }
+    for (auto val : blockDiffs) {
+        writer.writeRice(val, kBlock);
+    }
+    writer.finish();
 }
 
 [[nodiscard]] auto ChangesInBlock::blockData() const noexcept -> BlockData const& {
     return mBlockData;
 }
 
-[[nodiscard]] auto ChangesInBlock::changeAtBlockheights() const noexcept -> std::vector<ChangeAtBlockheight> const& {
-    return mChangeAtBlockheights;
+[[nodiscard]] auto ChangesInBlock::numChanges() const noexcept -> size_t {
+    return mSatoshis.size();
+}
+
+[[nodiscard]] auto ChangesInBlock::changes() const noexcept -> ChangeSpans {
+    return ChangeSpans{mSatoshis, mBlockHeights, mRuns, 0};
+}
+
+[[nodiscard]] auto ChangesInBlock::spent() const noexcept -> ChangeSpans {
+    return changes().subspan(0, mNumSpent);
+}
+
+[[nodiscard]] auto ChangesInBlock::created() const noexcept -> ChangeSpans {
+    return changes().subspan(mNumSpent, mSatoshis.size() - mNumSpent);
+}
+
+[[nodiscard]] auto ChangesInBlock::changeAtBlockheights() const -> std::vector<ChangeAtBlockheight> {
+    auto result = std::vector<ChangeAtBlockheight>();
+    result.reserve(mSatoshis.size());
+    changes().forEach([&](int64_t satoshi, uint32_t blockHeight, uint32_t count) {
+        result.emplace_back(satoshi, blockHeight, count);
+    });
+    return result;
 }
 
 [[nodiscard]] auto ChangesInBlock::numUtxoDestroyed() const noexcept -> size_t {
@@ -141,13 +450,40 @@ auto parseHeader(char const* ptr) -> std::pair<Header, char const*> {
     auto header = Header();
     std::memcpy(&header, ptr, sizeof(Header));
 
-    if (header.magicMarker != uint32_t(0x024b4c42)) {
-        throw std::runtime_error("Decoding error, 'BLK\\2' does not match");
+    // "BLK" followed by the format
+    if ((header.magicMarker & 0x00ffffffU) != uint32_t(0x004b4c42)) {
+        throw std::runtime_error("Decoding error, 'BLK' does not match");
+    }
+    auto format = header.magicMarker >> 24U;
+    if (format < static_cast<uint32_t>(BlkFormat::varint) || format > static_cast<uint32_t>(BlkFormat::varintRle)) {
+        throw std::runtime_error(fmt::format("Decoding error, unknown format {}", format));
     }
 
     return std::make_pair(header, ptr + sizeof(Header));
 }
 
+[[nodiscard]] auto blkFormat(Header const& header) -> BlkFormat {
+    return static_cast<BlkFormat>(header.magicMarker >> 24U);
+}
+
+// decodes block header info, advances payloadPtr
+void decodeBlockInfo(Header const& header, char const*& payloadPtr, BlockData& bd) {
+    bd.blockHeight = header.blockHeight;
+    util::read<32>(payloadPtr, bd.hash);
+    util::read<32>(payloadPtr, bd.merkleRoot);
+    util::read<32>(payloadPtr, bd.chainWork);
+    util::read<8>(payloadPtr, bd.difficultyArray);
+    util::read<4>(payloadPtr, bd.version);
+    util::read<4>(payloadPtr, bd.time);
+    util::read<4>(payloadPtr, bd.medianTime);
+    util::read<4>(payloadPtr, bd.nonce);
+    util::read<4>(payloadPtr, bd.bits);
+    util::VarInt::decode<uint32_t>(bd.nTx, payloadPtr);
+    util::VarInt::decode<uint32_t>(bd.size, payloadPtr);
+    util::VarInt::decode<uint32_t>(bd.strippedSize, payloadPtr);
+    util::VarInt::decode<uint32_t>(bd.weight, payloadPtr);
+}
+
 } // namespace
 
 auto ChangesInBlock::skip(char const* ptr) -> std::pair<uint32_t, char const*> {
@@ -155,9 +491,17 @@ auto ChangesInBlock::skip(char const* ptr) -> std::pair<uint32_t, char const*> {
     return std::make_pair(header.blockHeight, payloadPtr + header.numBytes);
 }
 
+auto ChangesInBlock::decodeBlockData(char const* ptr) -> std::pair<BlockData, char const*> {
+    auto [header, payloadPtr] = parseHeader(ptr);
+    auto const* nextPtr = payloadPtr + header.numBytes;
+    auto bd = BlockData();
+    decodeBlockInfo(header, payloadPtr, bd);
+    return std::make_pair(bd, nextPtr);
+}
+
 [[nodiscard]] auto ChangesInBlock::operator==(ChangesInBlock const& other) const noexcept -> bool {
-    return mBlockData.blockHeight == other.mBlockData.blockHeight && mChangeAtBlockheights == other.mChangeAtBlockheights &&
-           mIsFinalized == other.mIsFinalized;
+    return mBlockData.blockHeight == other.mBlockData.blockHeight && mSatoshis == other.mSatoshis &&
+           mBlockHeights == other.mBlockHeights && mRuns == other.mRuns && mIsFinalized == other.mIsFinalized;
 }
 
 [[nodiscard]] auto ChangesInBlock::operator!=(ChangesInBlock const& other) const noexcept -> bool {
@@ -170,62 +514,196 @@ auto ChangesInBlock::decode(char const* ptr) -> std::pair<ChangesInBlock, char c
 
 auto ChangesInBlock::decode(ChangesInBlock&& reusableChanges, char const* ptr) -> std::pair<ChangesInBlock, char const*> {
     auto [header, payloadPtr] = parseHeader(ptr);
-    reusableChanges.mChangeAtBlockheights.clear();
-
-    auto& bd = reusableChanges.mBlockData;
-    bd.blockHeight = header.blockHeight;
+    reusableChanges.clearChanges();
 
     const auto* endPtr = payloadPtr + header.numBytes;
 
     // decode block header info
-    util::read<32>(payloadPtr, bd.hash);
-    util::read<32>(payloadPtr, bd.merkleRoot);
-    util::read<32>(payloadPtr, bd.chainWork);
-    util::read<8>(payloadPtr, bd.difficultyArray);
-    util::read<4>(payloadPtr, bd.version);
-    util::read<4>(payloadPtr, bd.time);
-    util::read<4>(payloadPtr, bd.medianTime);
-    util::read<4>(payloadPtr, bd.nonce);
-    util::read<4>(payloadPtr, bd.bits);
-    util::VarInt::decode<uint32_t>(bd.nTx, payloadPtr);
-    util::VarInt::decode<uint32_t>(bd.size, payloadPtr);
-    util::VarInt::decode<uint32_t>(bd.strippedSize, payloadPtr);
-    util::VarInt::decode<uint32_t>(bd.weight, payloadPtr);
+    decodeBlockInfo(header, payloadPtr, reusableChanges.mBlockData);
+
+    switch (blkFormat(header)) {
+    case BlkFormat::streamVByte:
+        reusableChanges.decodeStreamVByte(payloadPtr, endPtr);
+        return std::make_pair(std::move(reusableChanges), endPtr);
+
+    case BlkFormat::golombRice:
+        reusableChanges.decodeGolombRice(payloadPtr, endPtr);
+        return std::make_pair(std::move(reusableChanges), endPtr);
+
+    case BlkFormat::varintRle:
+        reusableChanges.decodeVarintRle(payloadPtr, endPtr);
+        return std::make_pair(std::move(reusableChanges), endPtr);
+
+    case BlkFormat::varint:
+        break;
+    }
 
     // decode transaction info
 
     auto satoshi = int64_t();
-    util::VarInt::decode<int64_t>(satoshi, payloadPtr);
+    util::VarInt::decode<int64_t>(satoshi, payloadPtr, endPtr);
 
     // use a tmp variable so we con decode as uint
     auto tmpBlockHeight = uint64_t();
-    util::VarInt::decode<uint64_t>(tmpBlockHeight, payloadPtr);
-    reusableChanges.mChangeAtBlockheights.emplace_back(satoshi, tmpBlockHeight);
+    util::VarInt::decode<uint64_t>(tmpBlockHeight, payloadPtr, endPtr);
+    reusableChanges.appendChange(satoshi, static_cast<uint32_t>(tmpBlockHeight));
 
     auto blockHeight = int64_t(tmpBlockHeight);
-    reusableChanges.mNumUtxoCreated = 0;
-    reusableChanges.mNumUtxoDestroyed = 0;
+    reusableChanges.mNumUtxoCreated = satoshi > 0 ? 1 : 0;
+    reusableChanges.mNumUtxoDestroyed = satoshi > 0 ? 0 : 1;
+
+    // decode in batches, so the varint decoding loop does not have to deal with the vector
+    static constexpr auto batchSize = size_t(256);
+    auto diffSatoshis = std::array<uint64_t, batchSize>();
+    auto diffBlockheights = std::array<int64_t, batchSize>();
 
     while (payloadPtr < endPtr) {
-        auto diffSatoshi = uint64_t();
-        auto diffBlockheight = int64_t();
+        auto runSatoshi = satoshi;
+        auto count = util::decodeAmountBlockDiffs(
+            payloadPtr, endPtr, runSatoshi, diffSatoshis.data(), diffBlockheights.data(), batchSize);
+
+        for (size_t i = 0; i < count; ++i) {
+            satoshi += static_cast<int64_t>(diffSatoshis[i]);
+            if (satoshi <= 0) {
+                // blockheight is only stored if satoshi was spent
+                blockHeight += diffBlockheights[i];
+                reusableChanges.appendChange(satoshi, static_cast<uint32_t>(blockHeight));
+                ++reusableChanges.mNumUtxoDestroyed;
+            } else {
+                reusableChanges.appendChange(satoshi, header.blockHeight);
+                ++reusableChanges.mNumUtxoCreated;
+            }
+        }
+    }
+    reusableChanges.updateNumSpent();
 
-        util::VarInt::decode<uint64_t>(diffSatoshi, payloadPtr);
-        satoshi += diffSatoshi;
+    return std::make_pair(std::move(reusableChanges), payloadPtr);
+}
+
+void ChangesInBlock::decodeVarintRle(char const* payloadPtr, char const* endPtr) {
+    auto satoshi = int64_t();
+    auto tmpBlockHeight = uint64_t();
+    util::VarInt::decode<int64_t>(satoshi, payloadPtr, endPtr);
+    util::VarInt::decode<uint64_t>(tmpBlockHeight, payloadPtr, endPtr);
+    appendChange(satoshi, static_cast<uint32_t>(tmpBlockHeight));
+
+    auto blockHeight = int64_t(tmpBlockHeight);
+    mNumUtxoCreated = satoshi > 0 ? 1 : 0;
+    mNumUtxoDestroyed = satoshi > 0 ? 0 : 1;
 
+    // the count follows a repeat, so this can't use the batch decoding of BlkFormat::varint
+    while (payloadPtr < endPtr) {
+        auto diffSatoshi = util::decodeUintFast<uint64_t>(payloadPtr, endPtr);
+        satoshi += static_cast<int64_t>(diffSatoshi);
+
+        auto diffBlockHeight = int64_t();
         if (satoshi <= 0) {
-            // only decode blockheight if satoshi was spent
-            util::VarInt::decode<int64_t>(diffBlockheight, payloadPtr);
-            blockHeight += diffBlockheight;
-            reusableChanges.mChangeAtBlockheights.emplace_back(satoshi, blockHeight);
-            ++reusableChanges.mNumUtxoDestroyed;
+            diffBlockHeight = util::zigzagDecode<int64_t>(util::decodeUintFast<uint64_t>(payloadPtr, endPtr));
+            blockHeight += diffBlockHeight;
+        }
+        auto& numUtxo = satoshi <= 0 ? mNumUtxoDestroyed : mNumUtxoCreated;
+
+        if (diffSatoshi == 0 && diffBlockHeight == 0) {
+            auto count = static_cast<uint32_t>(util::decodeUintFast<uint64_t>(payloadPtr, endPtr) + 1);
+            addCount(mSatoshis.size() - 1, count);
+            numUtxo += count;
         } else {
-            reusableChanges.mChangeAtBlockheights.emplace_back(satoshi, header.blockHeight);
-            ++reusableChanges.mNumUtxoCreated;
+            mSatoshis.push_back(satoshi);
+            mBlockHeights.push_back(satoshi <= 0 ? static_cast<uint32_t>(blockHeight) : mBlockData.blockHeight);
+            ++numUtxo;
         }
     }
+    updateNumSpent();
+}
+
+void ChangesInBlock::decodeStreamVByte(char const* payloadPtr, char const* endPtr) {
+    // columns are decoded into these buffers, so they don't need to be allocated for each block
+    thread_local auto amountDiffs = std::vector<uint64_t>();
+    thread_local auto blockDiffs = std::vector<uint32_t>();
+
+    auto numChanges = uint64_t();
+    auto numSpent = uint64_t();
+    util::VarInt::decode(numChanges, payloadPtr, endPtr);
+    util::VarInt::decode(numSpent, payloadPtr, endPtr);
+    if (numSpent > numChanges) {
+        throw std::runtime_error(fmt::format("Decoding error, {} spent but only {} changes", numSpent, numChanges));
+    }
+    mNumUtxoDestroyed = numSpent;
+    mNumUtxoCreated = numChanges - numSpent;
+    if (numChanges == 0) {
+        return;
+    }
 
-    return std::make_pair(std::move(reusableChanges), payloadPtr);
+    auto satoshi = int64_t();
+    auto amountBytes = uint64_t();
+    util::VarInt::decode(satoshi, payloadPtr, endPtr);
+    util::VarInt::decode(amountBytes, payloadPtr, endPtr);
+
+    // each column has to fit into the frame, checked before the counts are used to size the buffers
+    if (payloadPtr > endPtr || amountBytes > static_cast<uint64_t>(endPtr - payloadPtr)) {
+        throw std::runtime_error(fmt::format("Decoding error, amount column of {} bytes exceeds the frame", amountBytes));
+    }
+    auto const* amountEnd = payloadPtr + amountBytes;
+    if (util::streamVByteNumControlBytes(numChanges - 1) > amountBytes ||
+        util::streamVByteNumControlBytes(numSpent) > static_cast<uint64_t>(endPtr - amountEnd)) {
+        throw std::runtime_error(
+            fmt::format("Decoding error, {} changes with {} spent don't fit into the frame", numChanges, numSpent));
+    }
+
+    amountDiffs.resize(numChanges - 1);
+    blockDiffs.resize(numSpent);
+    (void)util::streamVByteDecode64(payloadPtr, amountEnd, amountDiffs.size(), amountDiffs.data());
+    (void)util::streamVByteDecode32(amountEnd, endPtr, blockDiffs.size(), blockDiffs.data());
+
+    fromColumns(satoshi, amountDiffs.data(), numChanges, blockDiffs.data(), numSpent);
+}
+
+void ChangesInBlock::decodeGolombRice(char const* payloadPtr, char const* endPtr) {
+    thread_local auto amountDiffs = std::vector<uint64_t>();
+    thread_local auto blockDiffs = std::vector<uint32_t>();
+
+    auto numChanges = uint64_t();
+    auto numSpent = uint64_t();
+    util::VarInt::decode(numChanges, payloadPtr, endPtr);
+    util::VarInt::decode(numSpent, payloadPtr, endPtr);
+    if (numSpent > numChanges) {
+        throw std::runtime_error(fmt::format("Decoding error, {} spent but only {} changes", numSpent, numChanges));
+    }
+    mNumUtxoDestroyed = numSpent;
+    mNumUtxoCreated = numChanges - numSpent;
+    if (numChanges == 0) {
+        return;
+    }
+
+    auto satoshi = int64_t();
+    util::VarInt::decode(satoshi, payloadPtr, endPtr);
+    if (payloadPtr > endPtr || endPtr - payloadPtr < 2) {
+        throw std::runtime_error("Decoding error, golomb rice header is truncated");
+    }
+    auto kAmount = static_cast<uint8_t>(*payloadPtr++);
+    auto kBlock = static_cast<uint8_t>(*payloadPtr++);
+    if (kAmount > 32 || kBlock > 32) {
+        throw std::runtime_error(fmt::format("Decoding error, invalid rice parameters {} and {}", kAmount, kBlock));
+    }
+
+    // each value takes at least one bit, checked before the counts are used to size the buffers
+    auto numBits = static_cast<uint64_t>(endPtr - payloadPtr) * 8;
+    if (numChanges - 1 > numBits || numSpent > numBits - (numChanges - 1)) {
+        throw std::runtime_error(
+            fmt::format("Decoding error, {} changes with {} spent don't fit into the frame", numChanges, numSpent));
+    }
+
+    amountDiffs.resize(numChanges - 1);
+    blockDiffs.resize(numSpent);
+    auto reader = util::BitReader(payloadPtr, endPtr);
+    for (auto& val : amountDiffs) {
+        val = reader.readRice(kAmount);
+    }
+    for (auto& val : blockDiffs) {
+        val = static_cast<uint32_t>(reader.readRice(kBlock));
+    }
+
+    fromColumns(satoshi, amountDiffs.data(), numChanges, blockDiffs.data(), numSpent);
 }
 
 } // namespace buv
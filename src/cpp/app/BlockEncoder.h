@@ -1,12 +1,16 @@
 #pragma once
 
+#include <util/Span.h>
+
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -15,14 +19,18 @@ namespace buv {
 // Satoshi can be negative and positive. Negative means it the transaction was spent, positive means it was added.
 // Obviously, changes from past blocks are always negative (always spent), and from current block it will be mostly positive, but
 // some can also be spent within the same block.
+//
+// count is the number of identical (satoshi, blockHeight) changes. Spam like dust outputs or batch payouts has lots of them.
 class ChangeAtBlockheight {
     int64_t mSatoshi{};
     uint32_t mBlockHeight{};
+    uint32_t mCount{1};
 
 public:
-    constexpr ChangeAtBlockheight(int64_t satoshi, uint32_t blockHeight)
+    constexpr ChangeAtBlockheight(int64_t satoshi, uint32_t blockHeight, uint32_t count = 1)
         : mSatoshi(satoshi)
-        , mBlockHeight(blockHeight) {}
+        , mBlockHeight(blockHeight)
+        , mCount(count) {}
 
     [[nodiscard]] constexpr auto satoshi() const noexcept -> int64_t {
         return mSatoshi;
@@ -32,6 +40,19 @@ public:
         return mBlockHeight;
     }
 
+    [[nodiscard]] constexpr auto count() const noexcept -> uint32_t {
+        return mCount;
+    }
+
+    constexpr void addCount(uint32_t count) noexcept {
+        mCount += count;
+    }
+
+    // true when satoshi and blockHeight are the same, ignoring the count
+    [[nodiscard]] constexpr auto isSameChange(ChangeAtBlockheight const& other) const noexcept -> bool {
+        return mSatoshi == other.mSatoshi && mBlockHeight == other.mBlockHeight;
+    }
+
     [[nodiscard]] constexpr auto operator<(ChangeAtBlockheight const& other) const noexcept -> bool {
         if (mSatoshi != other.mSatoshi) {
             return mSatoshi < other.mSatoshi;
@@ -40,7 +61,7 @@ public:
     }
 
     [[nodiscard]] constexpr auto operator==(ChangeAtBlockheight const& other) const noexcept -> bool {
-        return mSatoshi == other.mSatoshi && mBlockHeight == other.mBlockHeight;
+        return isSameChange(other) && mCount == other.mCount;
     }
 
     [[nodiscard]] constexpr auto operator!=(ChangeAtBlockheight const& other) const noexcept -> bool {
@@ -48,6 +69,78 @@ public:
     }
 };
 
+// Sorts by (satoshi, blockHeight) with a radix sort, which is faster than std::sort for the thousands of changes of a block
+void sortChanges(std::vector<ChangeAtBlockheight>& changes);
+
+// A change that occurs more than once: its index in the block's columns, and the count
+struct CountRun {
+    uint32_t idx{};
+    uint32_t count{};
+
+    [[nodiscard]] constexpr auto operator==(CountRun const& other) const noexcept -> bool {
+        return idx == other.idx && count == other.count;
+    }
+};
+
+// The changes of a block in separate columns, sorted by (satoshi, blockHeight). Can be all changes of a block, or a part of them.
+//
+// Most changes have a count of 1, so counts are sparse: only changes with a count > 1 have an entry in runs.
+struct ChangeSpans {
+    util::Span<int64_t const> satoshis{};
+    util::Span<uint32_t const> blockHeights{};
+
+    // sorted by idx, which is relative to the whole block. offset is the index of the first change of these spans.
+    util::Span<CountRun const> runs{};
+    size_t offset{};
+
+    [[nodiscard]] auto size() const noexcept -> size_t {
+        return satoshis.size();
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool {
+        return satoshis.empty();
+    }
+
+    // binary search in runs. Loops over all changes should use forEach().
+    [[nodiscard]] auto count(size_t idx) const noexcept -> uint32_t {
+        auto it = std::lower_bound(runs.begin(), runs.end(), offset + idx, [](CountRun const& run, size_t i) {
+            return run.idx < i;
+        });
+        return it != runs.end() && it->idx == offset + idx ? it->count : 1;
+    }
+
+    [[nodiscard]] auto operator[](size_t idx) const noexcept -> ChangeAtBlockheight {
+        return ChangeAtBlockheight(satoshis[idx], blockHeights[idx], count(idx));
+    }
+
+    // calls op(satoshi, blockHeight, count) for each change in order, walking through runs alongside
+    template <typename Op>
+    void forEach(Op&& op) const {
+        auto const* run = runs.begin();
+        for (size_t i = 0; i < size(); ++i) {
+            auto c = uint32_t(1);
+            if (run != runs.end() && run->idx == offset + i) {
+                c = run->count;
+                ++run;
+            }
+            op(satoshis[i], blockHeights[i], c);
+        }
+    }
+
+    // count changes starting at offset
+    [[nodiscard]] auto subspan(size_t subOffset, size_t count) const noexcept -> ChangeSpans {
+        auto byIdx = [](CountRun const& run, size_t i) {
+            return run.idx < i;
+        };
+        auto const* runsBegin = std::lower_bound(runs.begin(), runs.end(), offset + subOffset, byIdx);
+        auto const* runsEnd = std::lower_bound(runsBegin, runs.end(), offset + subOffset + count, byIdx);
+        return ChangeSpans{satoshis.subspan(subOffset, count),
+                           blockHeights.subspan(subOffset, count),
+                           util::Span<CountRun const>(runsBegin, static_cast<size_t>(runsEnd - runsBegin)),
+                           offset + subOffset};
+    }
+};
+
 struct BlockData {
     // fields are ordered by alignment requirements (not size)
     // 4
@@ -90,6 +183,24 @@ struct BlockData {
     return !(a == b);
 }
 
+// Format of the change data in a frame. The value is stored in the marker, e.g. "BLK\x02"
+enum class BlkFormat : uint8_t {
+    // interleaved LEB128 varints
+    varint = 2,
+
+    // amounts and blockheights in separate Stream VByte columns, for SIMD decoding
+    streamVByte = 3,
+
+    // Golomb-Rice coded bit stream with a per-block parameter. Smallest, but slower to decode.
+    golombRice = 4,
+
+    // like varint, but identical changes are stored once with a count
+    varintRle = 5,
+};
+
+// "varint", "streamvbyte", "golombrice", or "varintrle", e.g. from the configuration. Throws if unknown.
+[[nodiscard]] auto parseBlkFormat(std::string_view name) -> BlkFormat;
+
 // Encodes & decodes block change data
 //
 // The format is designed to be compact, fast to parse, and contain all (amounts, blockheight) tuples of the current block.
@@ -125,9 +236,45 @@ struct BlockData {
 //  The following fields are repeated until for all new amounts (satoshi > 0). Sorted by amount. No need for blockheight because it must be the current block.
 //         1+ | amount_diff  | var_uint  | var-uint encoded difference to previous amount. Guaranteed to be positive due to the sorting.
 //
+// Identical changes are written once for each count, so an amount_diff of 0 (and block_diff of 0 if spent) repeats the previous
+// change. All formats decode these into a single change with a count.
+//
+// BlkFormat::varintRle ("BLK\x05") is the same as BlkFormat::varint, but each change is written only once. A change with a
+// count > 1 is followed by a single repeat (amount_diff 0, and block_diff 0 if spent), and then the rest of the count:
+//
+//         1+ | count_minus_2 | var_uint | count - 2
+//
+// BlkFormat::streamVByte ("BLK\x03") has the same header, but the transaction info is stored in two columns:
+//
+//         1+ | num_changes  | var_uint  | number of changes
+//         1+ | num_spent    | var_uint  | number of changes with amount <= 0. Due to the sorting, they are first.
+//         1+ | amount       | var_int   | smallest change
+//         1+ | amount_bytes | var_uint  | size in bytes of the amount_diffs column
+//          * | amount_diffs | svb64     | num_changes - 1 Stream VByte encoded differences to previous amount
+//          * | block_diffs  | svb32     | num_spent Stream VByte encoded zig-zag differences to previous block height (starting with 0)
+//
+// BlkFormat::golombRice ("BLK\x04") stores the same values as BlkFormat::streamVByte, but rice coded in a bit stream:
+//
+//         1+ | num_changes  | var_uint  | number of changes
+//         1+ | num_spent    | var_uint  | number of changes with amount <= 0
+//         1+ | amount       | var_int   | smallest change
+//          1 | k_amount     | uint8_t   | rice parameter for the amount diffs, chosen for each block
+//          1 | k_block      | uint8_t   | rice parameter for the block diffs
+//          * | amount_diffs | rice      | num_changes - 1 differences to previous amount
+//          * | block_diffs  | rice      | num_spent zig-zag differences to previous block height (starting with 0)
+//
 // clang-format on
 class ChangesInBlock {
-    std::vector<ChangeAtBlockheight> mChangeAtBlockheights{};
+    // unsorted changes from addChange(), until finalizeBlock() moves them into the columns
+    std::vector<ChangeAtBlockheight> mAddedChanges{};
+
+    // Changes as structure of arrays. Sorted by (satoshi, blockHeight), so the spent changes (satoshi <= 0) come first. Counts
+    // are sparse, so a change takes 12 bytes instead of the 16 bytes of ChangeAtBlockheight.
+    std::vector<int64_t> mSatoshis{};
+    std::vector<uint32_t> mBlockHeights{};
+    std::vector<CountRun> mRuns{};
+    size_t mNumSpent{};
+
     BlockData mBlockData{};
     bool mIsFinalized = false;
 
@@ -138,19 +285,36 @@ public:
     [[nodiscard]] auto beginBlock(uint32_t blockHeight) -> BlockData&;
 
     void addChange(int64_t satoshi, uint32_t blockHeight);
+
+    // sorts, merges identical changes into one with a count, and stores them in the columns
     void finalizeBlock();
 
     // sorting is automatically don in finalizeBlock. It might be beneficial though to call sort() even when later more change is
     // added, so that the final sort() is faster.
     void sort();
     
-    [[nodiscard]] auto encode() const -> std::string;
+    [[nodiscard]] auto encode(BlkFormat format = BlkFormat::varint) const -> std::string;
+
+    // Appends the encoded frame to data. Reusing data's capacity, encoding does not need to allocate.
+    void encodeInto(std::string& data, BlkFormat format = BlkFormat::varint) const;
 
     [[nodiscard]] auto operator==(ChangesInBlock const& other) const noexcept -> bool;
     [[nodiscard]] auto operator!=(ChangesInBlock const& other) const noexcept -> bool;
 
     [[nodiscard]] auto blockData() const noexcept -> BlockData const&;
-    [[nodiscard]] auto changeAtBlockheights() const noexcept -> std::vector<ChangeAtBlockheight> const&;
+
+    // number of distinct changes, i.e. without counts
+    [[nodiscard]] auto numChanges() const noexcept -> size_t;
+
+    // all changes; the spent ones (satoshi <= 0) first, then the created ones
+    [[nodiscard]] auto changes() const noexcept -> ChangeSpans;
+    [[nodiscard]] auto spent() const noexcept -> ChangeSpans;
+    [[nodiscard]] auto created() const noexcept -> ChangeSpans;
+
+    // Copies the columns into a vector. Convenient for tests and tools, hot loops should use changes().
+    [[nodiscard]] auto changeAtBlockheights() const -> std::vector<ChangeAtBlockheight>;
+
+    // number of utxos, so this includes the counts. Only set by decode.
     [[nodiscard]] auto numUtxoDestroyed() const noexcept -> size_t;
     [[nodiscard]] auto numUtxoCreated() const noexcept -> size_t;
 
@@ -160,6 +324,45 @@ public:
 
     // skips the whole block, and returns the skipped block's blockHeight, and pointer to the next block
     [[nodiscard]] static auto skip(char const* ptr) -> std::pair<uint32_t, char const*>;
+
+    // decodes only the block header info, and returns pointer to the next block.
+    [[nodiscard]] static auto decodeBlockData(char const* ptr) -> std::pair<BlockData, char const*>;
+
+private:
+    void clearChanges();
+
+    // Adds a change at the end of the columns, or increases the count if it is the same as the last one. Decoders use this, so
+    // repeated changes are merged.
+    void appendChange(int64_t satoshi, uint32_t blockHeight, uint32_t count = 1);
+
+    // adds count to the change at idx, which has to be the last one
+    void addCount(size_t idx, uint32_t count);
+
+    // sets mNumSpent after the columns were filled
+    void updateNumSpent();
+
+    // appends the changes of BlkFormat::varint or BlkFormat::varintRle
+    void encodeVarint(std::string& data, bool isRle) const;
+
+    // decodes the changes of BlkFormat::varintRle
+    void decodeVarintRle(char const* payloadPtr, char const* endPtr);
+
+    // Recreates the changes from the values of BlkFormat::streamVByte and BlkFormat::golombRice: amountDiffs has numChanges - 1
+    // values, blockDiffs one for each spent change. Replaces all changes.
+    void fromColumns(
+        int64_t satoshi, uint64_t const* amountDiffs, size_t numChanges, uint32_t const* blockDiffs, size_t numSpent);
+
+    // appends the columns of BlkFormat::streamVByte
+    void encodeStreamVByte(std::string& data) const;
+
+    // decodes the columns of BlkFormat::streamVByte
+    void decodeStreamVByte(char const* payloadPtr, char const* endPtr);
+
+    // appends the bit stream of BlkFormat::golombRice
+    void encodeGolombRice(std::string& data) const;
+
+    // decodes the bit stream of BlkFormat::golombRice
+    void decodeGolombRice(char const* payloadPtr, char const* endPtr);
 };
 
 } // namespace buv
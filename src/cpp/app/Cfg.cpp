@@ -50,10 +50,18 @@ auto parseCfg(std::filesystem::path const& cfgFile) -> Cfg {
     LOG("Loading config file {}", cfgFile.string());
     cfg.bitcoinRpcUrl = std::string(load<std::string_view>(data, "bitcoinRpcUrl"));
     cfg.blkFile = std::string(load<std::string_view>(data, "blkFile"));
+    cfg.blkFormat = std::string(load<std::string_view>(data, "blkFormat"));
+    cfg.blkReadMode = std::string(load<std::string_view>(data, "blkReadMode"));
     cfg.utxoToChangeNumThreads = load<int64_t>(data, "utxoToChangeNumThreads");
     cfg.utxoToChangeNumResources = load<int64_t>(data, "utxoToChangeNumResources");
+    cfg.utxoEngine = std::string(load<std::string_view>(data, "utxoEngine"));
+    cfg.utxoColumnsDir = std::string(load<std::string_view>(data, "utxoColumnsDir"));
+    cfg.followTipPollIntervalMs = load<uint64_t>(data, "followTipPollIntervalMs");
+    cfg.followTipUndoDepth = load<uint64_t>(data, "followTipUndoDepth");
+    cfg.utxoCheckpointFile = std::string(load<std::string_view>(data, "utxoCheckpointFile"));
     cfg.imageWidth = load<uint64_t>(data, "imageWidth");
     cfg.imageHeight = load<uint64_t>(data, "imageHeight");
+    cfg.densityNumThreads = load<uint64_t>(data, "densityNumThreads");
 
     auto rect = loadArray<size_t, 4>(data, "graphRect");
     cfg.graphRect.x = rect[0];
@@ -66,8 +74,14 @@ auto parseCfg(std::filesystem::path const& cfgFile) -> Cfg {
     cfg.startShowAtBlockHeight = load<uint64_t>(data, "startShowAtBlockHeight");
     cfg.skipBlocks = load<uint64_t>(data, "skipBlocks");
     cfg.repeatLastBlockTimes = load<uint64_t>(data, "repeatLastBlockTimes");
+    cfg.outputSink = std::string(load<std::string_view>(data, "outputSink"));
+    cfg.outputPath = std::string(load<std::string_view>(data, "outputPath"));
     cfg.connectionIpAddr = std::string(load<std::string_view>(data, "connectionIpAddr"));
     cfg.connectionSocket = load<uint64_t>(data, "connectionSocket");
+    cfg.outputPixelFormat = std::string(load<std::string_view>(data, "outputPixelFormat"));
+    cfg.outputFrameRate = load<uint64_t>(data, "outputFrameRate");
+    cfg.outputQueueFrames = load<uint64_t>(data, "outputQueueFrames");
+    cfg.outputQueuePolicy = std::string(load<std::string_view>(data, "outputQueuePolicy"));
     cfg.colorUpperValueLimit = load<uint64_t>(data, "colorUpperValueLimit");
     cfg.colorMap = std::string(load<std::string_view>(data, "colorMap"));
     cfg.colorHighlightRGB = loadArray<uint8_t, 3>(data, "colorHighlightRGB");
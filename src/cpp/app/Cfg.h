@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <string>
@@ -17,20 +18,45 @@ struct Cfg {
     std::string bitcoinRpcUrl{};
 
     std::string blkFile{};
+
+    // frame format for new .blk files: "varint", "streamvbyte", "golombrice", or "varintrle"
+    std::string blkFormat = "varint";
+
+    // how the visualizer reads the .blk file: "populate" reads it into memory up front, "lazy" maps it and reads ahead while
+    // decoding, "stream" reads it with pread (for files larger than RAM)
+    std::string blkReadMode = "lazy";
     int64_t utxoToChangeNumThreads{};
     int64_t utxoToChangeNumResources{};
 
+    // "chunked" for buv::Utxo, "columnar" for buv::CompactUtxo
+    std::string utxoEngine = "chunked";
+    std::string utxoColumnsDir{};
+    uint32_t followTipPollIntervalMs = 1000;
+    size_t followTipUndoDepth = 100;
+
+    // utxo_to_change_follow writes utxo and undo data there, and continues from it after a restart. Empty disables it.
+    std::string utxoCheckpointFile{};
+
     size_t imageWidth{};
     size_t imageHeight{};
 
+    // the image is split into one horizontal stripe per thread, 0 uses all cores
+    size_t densityNumThreads{};
+
     Rect<size_t> graphRect{};
     int64_t minSatoshi{};
     int64_t maxSatoshi{};
     uint32_t startShowAtBlockHeight{};
     uint32_t skipBlocks{1};
     uint32_t repeatLastBlockTimes{0};
+    std::string outputSink = "tcp";
+    std::string outputPath = "/tmp/buv.sock";
     std::string connectionIpAddr = "127.0.0.1";
     uint16_t connectionSocket = 12987;
+    std::string outputPixelFormat = "rgb24";
+    uint32_t outputFrameRate = 60;
+    size_t outputQueueFrames = 0;
+    std::string outputQueuePolicy = "block";
     std::string colorMap = "viridis";
     size_t colorUpperValueLimit = 4000U;
     std::array<uint8_t, 3> colorHighlightRGB{};
@@ -76,6 +76,33 @@ auto ChunkStore::insert(uint16_t vout, int64_t satoshi, Chunk* c) -> Chunk* {
     return c;
 }
 
+auto ChunkStore::insertSorted(uint16_t vout, int64_t satoshi, Chunk* root) -> Chunk* {
+    auto* newChunk = takeFromStore();
+    newChunk->voutSatoshi() = {vout, satoshi};
+
+    if (root == nullptr || vout < root->voutSatoshi().vout()) {
+        newChunk->next(root);
+        return newChunk;
+    }
+
+    // find the last chunk with a smaller vout, and link after it
+    auto* c = root;
+    while (c->next() != nullptr && c->next()->voutSatoshi().vout() < vout) {
+        c = c->next();
+    }
+    newChunk->next(c->next());
+    c->next(newChunk);
+    return root;
+}
+
+void ChunkStore::removeAll(Chunk* root) {
+    while (root != nullptr) {
+        auto* next = root->next();
+        putIntoStore(root);
+        root = next;
+    }
+}
+
 // Removes the entry in the chunklist with the given vout. Returns the removed satoshi, and the new root or nullptr if empty.
 auto ChunkStore::remove(uint16_t vout, Chunk* const c) -> std::pair<int64_t, Chunk*> {
     Chunk* preFoundChunk = nullptr;
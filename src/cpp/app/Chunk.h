@@ -131,6 +131,13 @@ public:
     // @return The chunk where it has inserted.
     auto insert(uint16_t vout, int64_t satoshi, Chunk* c) -> Chunk*;
 
+    // Inserts vout so that the list stays sorted by vout, which is required for removeAllSorted().
+    // @return The new root of the list.
+    auto insertSorted(uint16_t vout, int64_t satoshi, Chunk* root) -> Chunk*;
+
+    // Puts all chunks of the list back into the store.
+    void removeAll(Chunk* root);
+
     // Removes the entry in the chunklist with the given vout. Might put a free chunk back into the store. Replaces the removed
     // entry with the last enry.
     // @return The removed satoshi value, and either c or nullptr if that was the last element
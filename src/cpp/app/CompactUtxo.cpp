@@ -0,0 +1,152 @@
+#include "CompactUtxo.h"
+
+#include <util/hex.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// The duplicate coinbase transactions of blocks 91842 and 91880 overwrite those of blocks 91812 and 91722, see BIP30
+[[nodiscard]] auto isBip30Exception(uint32_t blockHeight) -> bool {
+    return blockHeight == 91842 || blockHeight == 91880;
+}
+
+// makes sure the directory exists before any column file is created
+auto createdDir(std::filesystem::path const& dir) -> std::filesystem::path const& {
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+} // namespace
+
+namespace buv {
+
+CompactUtxo::CompactUtxo(std::filesystem::path const& columnsDir, size_t expectedNumTx)
+    : mAmounts(createdDir(columnsDir) / "amounts.col")
+    , mTxFirstVout(columnsDir / "txfirstvout.col") {
+    // ~16 bytes per entry
+    mTxidToLocation.reserve(expectedNumTx);
+    LOG("CompactUtxo: column files in '{}'", columnsDir.string());
+}
+
+void CompactUtxo::insert(TxIdPrefix const& txIdPrefix, uint32_t blockHeight, std::vector<int64_t> const& satoshi) {
+    if (blockHeight + size_t(1) < mBlockFirstTx.size()) {
+        throw std::runtime_error(
+            fmt::format("CompactUtxo: got block {}, but already at block {}", blockHeight, mBlockFirstTx.size() - 1));
+    }
+
+    // new block(s) start with the next transaction
+    while (mBlockFirstTx.size() <= blockHeight) {
+        mBlockFirstTx.push_back(mNumTx);
+    }
+
+    auto loc = TxLocation{blockHeight, static_cast<uint32_t>(mNumTx - mBlockFirstTx[blockHeight])};
+    auto [it, isNew] = mTxidToLocation.try_emplace(txIdPrefix, loc);
+    if (!isNew) {
+        if (!isBip30Exception(blockHeight)) {
+            throw std::runtime_error(fmt::format("CompactUtxo: txid prefix {} of block {} already exists in block {}",
+                                                 util::toHex(txIdPrefix),
+                                                 blockHeight,
+                                                 it->second.blockHeight));
+        }
+        LOG("CompactUtxo: duplicate coinbase {} in block {} replaces the one of block {}",
+            util::toHex(txIdPrefix),
+            blockHeight,
+            it->second.blockHeight);
+
+        // the old outputs are lost
+        auto oldLoc = std::exchange(it->second, loc);
+        auto [voutBegin, voutEnd] = voutRange(oldLoc);
+        for (auto idx = voutBegin; idx < voutEnd; ++idx) {
+            if (!isSpent(idx)) {
+                markSpent(idx);
+            }
+        }
+        releaseTx(oldLoc);
+    }
+
+    if ((mNumTx >> segmentShift) == mNumLiveTx.size()) {
+        mNumLiveTx.push_back(0);
+    }
+    ++mNumLiveTx[mNumTx >> segmentShift];
+
+    mTxFirstVout.append(&mNumVouts, sizeof(uint64_t));
+    mAmounts.append(satoshi.data(), satoshi.size() * sizeof(int64_t));
+    ++mNumTx;
+    for (size_t i = 0; i < satoshi.size(); ++i) {
+        if ((mNumVouts >> segmentShift) == mVoutSegments.size()) {
+            mVoutSegments.emplace_back().isSpent.resize(segmentSize / 64);
+        }
+        ++mVoutSegments[mNumVouts >> segmentShift].numUnspent;
+        ++mNumVouts;
+    }
+}
+
+auto CompactUtxo::voutRange(TxLocation loc) const -> std::pair<uint64_t, uint64_t> {
+    auto txIdx = mBlockFirstTx[loc.blockHeight] + loc.txIdx;
+
+    auto readFirstVout = [this](uint64_t idx) {
+        auto firstVout = uint64_t();
+        std::memcpy(&firstVout, mTxFirstVout.data() + idx * sizeof(uint64_t), sizeof(uint64_t));
+        return firstVout;
+    };
+
+    // the last transaction ends with the last vout
+    auto voutEnd = txIdx + 1 < mNumTx ? readFirstVout(txIdx + 1) : mNumVouts;
+    return std::make_pair(readFirstVout(txIdx), voutEnd);
+}
+
+void CompactUtxo::markSpent(uint64_t voutIdx) {
+    auto segmentIdx = voutIdx >> segmentShift;
+    auto& segment = mVoutSegments[segmentIdx];
+    auto bitIdx = voutIdx & (segmentSize - 1);
+    segment.isSpent[bitIdx / 64] |= uint64_t(1) << (bitIdx % 64);
+
+    // a segment that isn't full yet gets more unspent vouts
+    if (--segment.numUnspent == 0 && mNumVouts >= (segmentIdx + 1) << segmentShift) {
+        segment.isSpent = {};
+        mAmounts.discard(segmentIdx * segmentSize * sizeof(int64_t), segmentSize * sizeof(int64_t));
+    }
+}
+
+auto CompactUtxo::allSpent(uint64_t voutBegin, uint64_t voutEnd) const -> bool {
+    for (auto idx = voutBegin; idx < voutEnd; ++idx) {
+        if (!isSpent(idx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CompactUtxo::releaseTx(TxLocation loc) {
+    auto txIdx = mBlockFirstTx[loc.blockHeight] + loc.txIdx;
+    auto segmentIdx = txIdx >> segmentShift;
+    if (--mNumLiveTx[segmentIdx] == 0 && mNumTx >= (segmentIdx + 1) << segmentShift) {
+        // The segment's first entry is the end of the previous segment's last transaction, so it is kept. discard() only frees
+        // whole pages anyway.
+        auto begin = (segmentIdx << segmentShift) + 1;
+        mTxFirstVout.discard(begin * sizeof(uint64_t), (segmentSize - 1) * sizeof(uint64_t));
+    }
+}
+
+auto CompactUtxo::numLiveVoutSegments() const -> size_t {
+    return static_cast<size_t>(std::count_if(mVoutSegments.begin(), mVoutSegments.end(), [](VoutSegment const& segment) {
+        return !segment.isSpent.empty();
+    }));
+}
+
+auto CompactUtxo::map() const -> Map const& {
+    return mTxidToLocation;
+}
+
+auto CompactUtxo::numTx() const -> uint64_t {
+    return mNumTx;
+}
+
+auto CompactUtxo::numVouts() const -> uint64_t {
+    return mNumVouts;
+}
+
+} // namespace buv
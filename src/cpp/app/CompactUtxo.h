@@ -0,0 +1,136 @@
+#pragma once
+
+#include <app/Utxo.h>
+#include <util/AppendOnlyMmap.h>
+
+#include <fmt/format.h>
+#include <robin_hood.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+namespace buv {
+
+// Where to find a transaction: block height, and position of the transaction within that block.
+struct TxLocation {
+    uint32_t blockHeight{};
+    uint32_t txIdx{};
+};
+static_assert(sizeof(TxLocation) == 8);
+
+// Alternative to Utxo that needs much less RAM. The idea is that amounts never change after they were created, only their spent
+// state changes. So:
+//
+// * The map only holds txid prefix -> TxLocation, 8 + 8 bytes.
+// * All amounts are appended to a file (one int64_t per vout, for all blocks in order), which is mmapped. Same for the index of
+//   the first vout of each transaction. Since these files are append-only, the kernel can evict any page that is not needed.
+// * One bit per vout in RAM marks it as spent.
+//
+// Removal flips the bit, and reads the amount from the mmapped column. When all vouts of a transaction are spent the txid is
+// removed from the map.
+//
+// Vouts and transactions are grouped into segments of 2^16. As soon as everything in a segment is spent, its spent bits are freed
+// and its part of the column files is discarded (a hole is punched into the file). Since old outputs are mostly spent, RAM and disk
+// usage follow the live outputs. Only the bookkeeping per segment and per block (8 bytes each) grows with the whole chain.
+//
+// Transactions have to be inserted in block order, because the transaction's position within a block is derived from the
+// insertion order.
+class CompactUtxo {
+    using Map = robin_hood::unordered_flat_map<TxIdPrefix, TxLocation>;
+
+    static constexpr auto segmentShift = 16U;
+    static constexpr auto segmentSize = uint64_t(1) << segmentShift;
+
+    struct VoutSegment {
+        // one bit per vout, set when spent. Empty when all vouts of the segment are spent.
+        std::vector<uint64_t> isSpent{};
+        uint32_t numUnspent{};
+    };
+
+    Map mTxidToLocation{};
+
+    // int64_t amount for each vout of all transactions
+    util::AppendOnlyMmap mAmounts;
+
+    // uint64_t index into mAmounts of each transaction's first vout
+    util::AppendOnlyMmap mTxFirstVout;
+
+    // global index of each block's first transaction
+    std::vector<uint64_t> mBlockFirstTx{};
+
+    std::vector<VoutSegment> mVoutSegments{};
+
+    // number of transactions of each transaction segment that are still in the map
+    std::vector<uint32_t> mNumLiveTx{};
+
+    uint64_t mNumTx{};
+    uint64_t mNumVouts{};
+
+public:
+    // Creates the column files in the given directory. expectedNumTx is the number of unspent transactions to reserve for.
+    explicit CompactUtxo(std::filesystem::path const& columnsDir, size_t expectedNumTx = 0);
+
+    template <typename Op>
+    void removeAllSorted(TxIdPrefix const& txIdPrefix, std::vector<uint16_t> const& vouts, Op&& op) {
+        auto it = mTxidToLocation.find(txIdPrefix);
+        if (it == mTxidToLocation.end()) {
+            throw std::runtime_error("DAMN! did not find txid");
+        }
+
+        auto loc = it->second;
+        auto [voutBegin, voutEnd] = voutRange(loc);
+        for (auto vout : vouts) {
+            auto idx = voutBegin + vout;
+            if (idx >= voutEnd || isSpent(idx)) {
+                throw std::runtime_error(fmt::format("vout {} at block {} not available", vout, loc.blockHeight));
+            }
+            op(amount(idx), loc.blockHeight);
+            markSpent(idx);
+        }
+
+        if (allSpent(voutBegin, voutEnd)) {
+            mTxidToLocation.erase(it);
+            releaseTx(loc);
+        }
+    }
+
+    // Appends the transaction's amounts. blockHeight must never decrease. Throws when the txid prefix already exists, except for
+    // the duplicate coinbase transactions that BIP30 allowed: they replace the old transaction, whose vouts can't be spent any more.
+    void insert(TxIdPrefix const& txIdPrefix, uint32_t blockHeight, std::vector<int64_t> const& satoshi);
+
+    [[nodiscard]] auto map() const -> Map const&;
+    [[nodiscard]] auto numTx() const -> uint64_t;
+    [[nodiscard]] auto numVouts() const -> uint64_t;
+
+    // Number of vout segments whose spent bits are still in RAM
+    [[nodiscard]] auto numLiveVoutSegments() const -> size_t;
+
+private:
+    // [begin, end) indices into mAmounts
+    [[nodiscard]] auto voutRange(TxLocation loc) const -> std::pair<uint64_t, uint64_t>;
+
+    [[nodiscard]] auto amount(uint64_t voutIdx) const -> int64_t {
+        auto sat = int64_t();
+        std::memcpy(&sat, mAmounts.data() + voutIdx * sizeof(int64_t), sizeof(int64_t));
+        return sat;
+    }
+
+    [[nodiscard]] auto isSpent(uint64_t voutIdx) const -> bool {
+        auto const& bits = mVoutSegments[voutIdx >> segmentShift].isSpent;
+        auto bitIdx = voutIdx & (segmentSize - 1);
+        return bits.empty() || 0U != (bits[bitIdx / 64] & (uint64_t(1) << (bitIdx % 64)));
+    }
+
+    // Frees the segment when this was its last unspent vout
+    void markSpent(uint64_t voutIdx);
+
+    [[nodiscard]] auto allSpent(uint64_t voutBegin, uint64_t voutEnd) const -> bool;
+
+    // The transaction was removed from the map. Discards its segment's first vout indices when it was the last one.
+    void releaseTx(TxLocation loc);
+};
+
+} // namespace buv
@@ -0,0 +1,190 @@
+#include "CompressedBlk.h"
+
+#include <util/writeBinary.h>
+
+#include <fmt/format.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr auto headerSize = size_t(4 + 4);
+constexpr auto footerSize = size_t(8 + 4 + 4);
+
+void throwIfError(size_t zstdResult, char const* what) {
+    if (ZSTD_isError(zstdResult)) {
+        throw std::runtime_error(fmt::format("{}: {}", what, ZSTD_getErrorName(zstdResult)));
+    }
+}
+
+} // namespace
+
+namespace buv {
+
+auto compressGroup(std::string_view frames, int level) -> std::string {
+    auto compressed = std::string(ZSTD_compressBound(frames.size()), '\0');
+    auto size = ZSTD_compress(compressed.data(), compressed.size(), frames.data(), frames.size(), level);
+    throwIfError(size, "ZSTD_compress");
+    compressed.resize(size);
+    return compressed;
+}
+
+CompressedBlkWriter::CompressedBlkWriter(std::filesystem::path const& filename, uint32_t blocksPerGroup)
+    : mOut(filename, std::ios::binary | std::ios::out) {
+    if (!mOut.is_open()) {
+        throw std::runtime_error(fmt::format("could not open '{}' for writing", filename.string()));
+    }
+    mOut.write("BLKZ", 4);
+    util::writeBinary<4>(blocksPerGroup, mOut);
+    mFileOffset = headerSize;
+}
+
+void CompressedBlkWriter::append(uint32_t firstBlockHeight,
+                                 uint32_t numBlocks,
+                                 uint32_t decompressedSize,
+                                 std::string const& compressed) {
+    if (!mGroups.empty() && mGroups.back().firstBlockHeight + mGroups.back().numBlocks != firstBlockHeight) {
+        throw std::runtime_error(fmt::format("CompressedBlkWriter: expected block {} but got {}",
+                                             mGroups.back().firstBlockHeight + mGroups.back().numBlocks,
+                                             firstBlockHeight));
+    }
+
+    auto group = CompressedGroup();
+    group.fileOffset = mFileOffset;
+    group.compressedSize = static_cast<uint32_t>(compressed.size());
+    group.decompressedSize = decompressedSize;
+    group.firstBlockHeight = firstBlockHeight;
+    group.numBlocks = numBlocks;
+    mGroups.push_back(group);
+
+    mOut.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+    mFileOffset += compressed.size();
+}
+
+void CompressedBlkWriter::finish() {
+    auto indexOffset = mFileOffset;
+    for (auto const& group : mGroups) {
+        util::writeBinary<sizeof(CompressedGroup)>(group, mOut);
+    }
+    util::writeBinary<8>(indexOffset, mOut);
+    util::writeBinary<4>(static_cast<uint32_t>(mGroups.size()), mOut);
+    mOut.write("BLKZ", 4);
+    mOut.close();
+}
+
+CompressedBlk::CompressedBlk(std::filesystem::path const& filename)
+    : mMmap(filename) {
+    if (!isCompressed(mMmap) || mMmap.size() < headerSize + footerSize ||
+        0 != std::memcmp(mMmap.end() - 4, "BLKZ", 4)) {
+        throw std::runtime_error(fmt::format("'{}' is not a complete compressed .blk file", filename.string()));
+    }
+    std::memcpy(&mBlocksPerGroup, mMmap.data() + 4, sizeof(uint32_t));
+
+    auto indexOffset = uint64_t();
+    auto numGroups = uint32_t();
+    std::memcpy(&indexOffset, mMmap.end() - footerSize, sizeof(uint64_t));
+    std::memcpy(&numGroups, mMmap.end() - footerSize + 8, sizeof(uint32_t));
+    if (indexOffset < headerSize || indexOffset > mMmap.size() - footerSize ||
+        mMmap.size() - footerSize - indexOffset != numGroups * sizeof(CompressedGroup)) {
+        throw std::runtime_error(fmt::format("'{}': group index does not match the file size", filename.string()));
+    }
+
+    mGroups.resize(numGroups);
+    std::memcpy(mGroups.data(), mMmap.data() + indexOffset, numGroups * sizeof(CompressedGroup));
+
+    // decompress() reads the groups straight from the mapping, and groupOf() relies on contiguous block heights
+    auto nextBlockHeight = uint64_t();
+    for (size_t i = 0; i < mGroups.size(); ++i) {
+        auto const& group = mGroups[i];
+        if (group.fileOffset < headerSize || group.fileOffset > indexOffset ||
+            group.compressedSize > indexOffset - group.fileOffset) {
+            throw std::runtime_error(fmt::format("'{}': group {} with {} bytes at offset {} is outside of the data",
+                                                 filename.string(),
+                                                 i,
+                                                 group.compressedSize,
+                                                 group.fileOffset));
+        }
+        if (group.firstBlockHeight != nextBlockHeight) {
+            throw std::runtime_error(fmt::format("'{}': group {} starts at block {} but expected {}",
+                                                 filename.string(),
+                                                 i,
+                                                 group.firstBlockHeight,
+                                                 nextBlockHeight));
+        }
+        nextBlockHeight += group.numBlocks;
+    }
+}
+
+auto CompressedBlk::isCompressed(util::Mmap const& mmappedFile) -> bool {
+    return mmappedFile.is_open() && mmappedFile.size() >= 4 && 0 == std::memcmp(mmappedFile.data(), "BLKZ", 4);
+}
+
+auto CompressedBlk::numBlocks() const -> size_t {
+    if (mGroups.empty()) {
+        return 0;
+    }
+    return mGroups.back().firstBlockHeight + mGroups.back().numBlocks;
+}
+
+auto CompressedBlk::blocksPerGroup() const -> uint32_t {
+    return mBlocksPerGroup;
+}
+
+auto CompressedBlk::groups() const -> std::vector<CompressedGroup> const& {
+    return mGroups;
+}
+
+auto CompressedBlk::groupOf(uint32_t blockHeight) const -> size_t {
+    auto it = std::upper_bound(mGroups.begin(), mGroups.end(), blockHeight, [](uint32_t h, CompressedGroup const& group) {
+        return h < group.firstBlockHeight;
+    });
+    if (it == mGroups.begin() || blockHeight >= numBlocks()) {
+        throw std::runtime_error(fmt::format("block {} is not in the file", blockHeight));
+    }
+    return static_cast<size_t>(std::distance(mGroups.begin(), it) - 1);
+}
+
+void CompressedBlk::decompress(size_t groupIdx, std::string& out) const {
+    auto const& group = mGroups[groupIdx];
+
+    // the zstd frame knows its size, so a corrupt index can't make this allocate arbitrary amounts
+    auto const* src = mMmap.data() + group.fileOffset;
+    if (ZSTD_getFrameContentSize(src, group.compressedSize) != group.decompressedSize) {
+        throw std::runtime_error(
+            fmt::format("group {}: zstd frame does not have the expected {} bytes", groupIdx, group.decompressedSize));
+    }
+    out.resize(group.decompressedSize);
+    auto size = ZSTD_decompress(out.data(), out.size(), src, group.compressedSize);
+    throwIfError(size, "ZSTD_decompress");
+    if (size != group.decompressedSize) {
+        throw std::runtime_error(fmt::format("group {}: decompressed {} bytes but expected {}", groupIdx, size, out.size()));
+    }
+}
+
+auto CompressedBlk::changesAt(uint32_t blockHeight) const -> ChangesInBlock {
+    auto groupIdx = groupOf(blockHeight);
+    auto frames = std::string();
+    decompress(groupIdx, frames);
+
+    auto const* ptr = frames.data();
+    for (auto h = mGroups[groupIdx].firstBlockHeight; h < blockHeight; ++h) {
+        ptr = ChangesInBlock::skip(ptr).second;
+    }
+    return ChangesInBlock::decode(ptr).first;
+}
+
+auto CompressedBlk::blockDataAt(uint32_t blockHeight) const -> BlockData {
+    auto groupIdx = groupOf(blockHeight);
+    auto frames = std::string();
+    decompress(groupIdx, frames);
+
+    auto const* ptr = frames.data();
+    for (auto h = mGroups[groupIdx].firstBlockHeight; h < blockHeight; ++h) {
+        ptr = ChangesInBlock::skip(ptr).second;
+    }
+    return ChangesInBlock::decodeBlockData(ptr).first;
+}
+
+} // namespace buv
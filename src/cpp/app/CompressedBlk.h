@@ -0,0 +1,91 @@
+#pragma once
+
+#include <app/BlockEncoder.h>
+#include <util/Mmap.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace buv {
+
+// A .blk file where groups of consecutive frames (e.g. 256 blocks) are zstd compressed. The amounts are very repetitive, so this
+// is much smaller than the plain file, and cold reads are much faster. Due to the group index, any block can still be found
+// quickly: only its group needs to be decompressed.
+//
+// clang-format off
+//
+// field size | description       | data type        | commment
+// -----------|-------------------|------------------|---
+//          4 | marker            | string           | magic marker "BLKZ"
+//          4 | blocks_per_group  | uint32_t         | number of frames in each group (the last one can have fewer)
+// for each group:
+//          * | group             | zstd             | zstd frame of the concatenated .blk frames (any BlkFormat)
+// at the end:
+//          * | group index       | CompressedGroup  | one entry for each group
+//          8 | index_offset      | uint64_t         | file offset of the group index
+//          4 | num_groups        | uint32_t         |
+//          4 | marker            | string           | magic marker "BLKZ", so a truncated file is detected
+//
+// clang-format on
+struct CompressedGroup {
+    uint64_t fileOffset{};
+    uint32_t compressedSize{};
+    uint32_t decompressedSize{};
+    uint32_t firstBlockHeight{};
+    uint32_t numBlocks{};
+};
+static_assert(std::has_unique_object_representations_v<CompressedGroup>);
+
+// zstd compression of a group of frames
+[[nodiscard]] auto compressGroup(std::string_view frames, int level) -> std::string;
+
+// Writes a compressed .blk file. Groups have to be appended in block order.
+class CompressedBlkWriter {
+    std::ofstream mOut{};
+    std::vector<CompressedGroup> mGroups{};
+    uint64_t mFileOffset{};
+
+public:
+    CompressedBlkWriter(std::filesystem::path const& filename, uint32_t blocksPerGroup);
+
+    // appends a group that was compressed with compressGroup
+    void append(uint32_t firstBlockHeight, uint32_t numBlocks, uint32_t decompressedSize, std::string const& compressed);
+
+    // writes the group index. Nothing can be appended afterwards.
+    void finish();
+};
+
+// Read access to a compressed .blk file
+class CompressedBlk {
+    util::Mmap mMmap;
+    std::vector<CompressedGroup> mGroups{};
+    uint32_t mBlocksPerGroup{};
+
+public:
+    explicit CompressedBlk(std::filesystem::path const& filename);
+
+    // true if the file starts with "BLKZ"
+    [[nodiscard]] static auto isCompressed(util::Mmap const& mmappedFile) -> bool;
+
+    [[nodiscard]] auto numBlocks() const -> size_t;
+    [[nodiscard]] auto blocksPerGroup() const -> uint32_t;
+    [[nodiscard]] auto groups() const -> std::vector<CompressedGroup> const&;
+
+    // index of the group that contains the block
+    [[nodiscard]] auto groupOf(uint32_t blockHeight) const -> size_t;
+
+    // decompresses the group's frames into out
+    void decompress(size_t groupIdx, std::string& out) const;
+
+    // decompresses the block's group, and decodes the block
+    [[nodiscard]] auto changesAt(uint32_t blockHeight) const -> ChangesInBlock;
+
+    // decompresses the block's group, and decodes only the block header info
+    [[nodiscard]] auto blockDataAt(uint32_t blockHeight) const -> BlockData;
+};
+
+} // namespace buv
@@ -1,6 +1,9 @@
 #include "Hud.h"
 #include "util/hex.h"
 
+#include <buv/AlphaMask.h>
+#include <buv/GlyphAtlas.h>
+#include <buv/Overlay.h>
 #include <buv/SatoshiBlockheightToPixel.h>
 #include <util/date.h>
 #include <util/log.h>
@@ -9,13 +12,20 @@
 #include <opencv2/freetype.hpp>
 #include <opencv2/imgproc.hpp>
 
-#include <cstring>
+#include <algorithm>
+#include <cstdlib>
 #include <map>
+#include <string>
+#include <vector>
 
 namespace {
 
 using UnixClockSeconds = std::chrono::time_point<std::chrono::system_clock, std::chrono::seconds>;
 
+auto const fontFace = cv::FONT_HERSHEY_SIMPLEX;
+auto const fontScale = 0.6;
+auto const thickness = 1;
+
 enum class Origin {
     top_left,
     top_center,
@@ -28,22 +38,11 @@ enum class Origin {
     bottom_right,
 };
 
-template <typename... Args>
-void write(cv::Mat& mat, size_t x, size_t y, Origin origin, char const* format, Args&&... args) {
-    auto color = cv::Scalar(255, 255, 255);
-    auto fontFace = cv::FONT_HERSHEY_SIMPLEX;
-    auto fontScale = 0.6;
-    auto thickness = 1;
-
-    auto text = fmt::format(format, std::forward<Args>(args)...);
+// Start of the baseline for text of the given size, so that the text is aligned at (x, y).
+//
+// ignores baseline, so we get consistent alignment regardless of the letters used. I think. Untested.
+auto alignedPos(int x, int y, Origin origin, cv::Size size) -> cv::Point {
     auto pos = cv::Point(x, y);
-
-    auto baseline = int();
-    auto size = cv::getTextSize(text, fontFace, fontScale, thickness, &baseline);
-    baseline += thickness;
-
-    // ignores baseline, so we get consistent alignment regardless of the letters used. I think. Untested.
-
     switch (origin) {
     case Origin::top_left:
         pos.y += size.height;
@@ -79,75 +78,31 @@ void write(cv::Mat& mat, size_t x, size_t y, Origin origin, char const* format,
         pos.x -= size.width;
         break;
     }
-    cv::putText(mat, text, pos, fontFace, fontScale, color, thickness, cv::LINE_AA);
+    return pos;
 }
 
-template <typename... Args>
-void writeMono(cv::Mat& mat, size_t x, size_t y, Origin origin, char const* format, Args&&... args) {
-    auto color = cv::Scalar(255, 255, 255);
-    auto fontFace = cv::FONT_HERSHEY_SIMPLEX;
-    auto fontScale = 0.6;
-    auto thickness = 1;
-
-    auto text = fmt::format(format, std::forward<Args>(args)...);
-    auto pos = cv::Point(x, y);
+// Rasterizes whatever draw(mat, shift) draws once. All of it has to be within area, and shift is added to all coordinates.
+template <typename Draw>
+auto rasterize(cv::Rect area, Draw draw) -> buv::AlphaMask {
+    auto mat = cv::Mat(area.height, area.width, CV_8UC1, cv::Scalar(0));
+    draw(mat, cv::Point(-area.x, -area.y));
+    return buv::AlphaMask(mat.ptr<uint8_t>(), static_cast<size_t>(mat.cols), static_cast<size_t>(mat.rows), area.x, area.y);
+}
 
+// Rasterizes text aligned at (x, y)
+auto rasterizeText(int x, int y, Origin origin, std::string const& text) -> buv::AlphaMask {
     auto baseline = int();
-
-    // gets spacing for digit '0' and uses this for the spacing.
-    auto letterSize = cv::getTextSize("0", fontFace, fontScale, thickness, &baseline);
-    auto size = letterSize;
-    size.width *= text.size();
-
-    // ignores baseline, so we get consistent alignment regardless of the letters used. I think. Untested.
-
-    switch (origin) {
-    case Origin::top_left:
-        pos.y += size.height;
-        break;
-    case Origin::top_center:
-        pos.x -= size.width / 2;
-        pos.y += size.height;
-        break;
-    case Origin::top_right:
-        pos.x -= size.width;
-        pos.y += size.height;
-        break;
-
-    case Origin::center_left:
-        pos.y += size.height / 2;
-        break;
-    case Origin::center:
-        pos.x -= size.width / 2;
-        pos.y += size.height / 2;
-        break;
-    case Origin::center_right:
-        pos.x -= size.width;
-        pos.y += size.height / 2;
-        break;
-
-    case Origin::bottom_left:
-        // nothing to do, that's the default
-        break;
-    case Origin::bottom_center:
-        pos.x -= size.width / 2;
-        break;
-    case Origin::bottom_right:
-        pos.x -= size.width;
-        break;
-    }
-
-    for (auto ch : text) {
-        auto zeroTerminatedString = std::array<char, 2>();
-        zeroTerminatedString[0] = ch;
-        // center this letter
-        auto thisLetterSize = cv::getTextSize(zeroTerminatedString.data(), fontFace, fontScale, thickness, &baseline);
-
-        auto thisPos = pos;
-        thisPos.x += (letterSize.width - thisLetterSize.width) / 2;
-        cv::putText(mat, zeroTerminatedString.data(), thisPos, fontFace, fontScale, color, thickness, cv::LINE_AA);
-        pos.x += letterSize.width;
-    }
+    auto size = cv::getTextSize(text, fontFace, fontScale, thickness, &baseline);
+    baseline += thickness;
+    auto pos = alignedPos(x, y, origin, size);
+
+    // anti aliasing draws a bit outside of the text's box
+    auto margin = 4;
+    auto area =
+        cv::Rect(pos.x - margin, pos.y - size.height - margin, size.width + 2 * margin, size.height + baseline + 2 * margin);
+    return rasterize(area, [&](cv::Mat& mat, cv::Point shift) {
+        cv::putText(mat, text, pos + shift, fontFace, fontScale, cv::Scalar(255), thickness, cv::LINE_AA);
+    });
 }
 
 } // namespace
@@ -158,240 +113,292 @@ Hud::Hud() = default;
 
 Hud::~Hud() = default;
 
+// Everything that looks the same in every frame is rasterized once in the constructor and only blended in draw(): the axes, the
+// legend (which moves with the current block, but doesn't change), and the labels of the block info. Text that changes is drawn
+// from a glyph atlas.
+//
+// Most of what is drawn below the graph stays the same from frame to frame, and the density never draws there. So that stays in
+// the frame, see Overlay.
 class HudImpl : public Hud {
     Cfg mCfg;
-    cv::Mat mMat{};
     SatoshiBlockheightToPixel mSatoshiBlockheightToPixel;
-    std::map<uint32_t, std::string> mHeightToTimestring{};
     uint32_t mNumBlocks{};
 
+    GlyphAtlas mGlyphAtlas{};
+    Overlay mOverlay;
+    cv::Size mTextSize{};
+    int mMonoCellWidth{};
+
+    // absolute position
+    AlphaMask mBlockLines{};
+
+    // x axis text, only shown when not too close to the current block
+    struct AxisLabel {
+        int x{};
+        AlphaMask thousands{};
+        AlphaMask date{};
+    };
+    std::vector<AxisLabel> mAxisLabels{};
+
+    // relative to the current block's column
+    std::vector<AlphaMask> mLegend{};
+    AlphaMask mCurrentBlockMarker{};
+
+    // relative to the left column of the block info
+    std::vector<AlphaMask> mBlockInfoLabels{};
+
+    static constexpr auto blockInfoY = 10;
+    static constexpr auto blockInfoLineSpacing = 30;
+
 public:
-    explicit HudImpl(Cfg const& cfg, uint32_t numBlocks, util::Mmap const& mmappedFile)
+    HudImpl(Cfg const& cfg, uint32_t numBlocks, std::function<BlockData(uint32_t)> const& blockDataAt)
         : mCfg(cfg)
-        , mMat(cfg.imageHeight, cfg.imageWidth, CV_8UC3)
         , mSatoshiBlockheightToPixel(cfg, numBlocks)
-        , mNumBlocks(numBlocks) {
-
-        // iterate all blocks until end, store the time of each 100k block.
-        if (!mmappedFile.is_open()) {
-            throw std::runtime_error("file not open");
-        }
-
-        auto const* ptr = mmappedFile.begin();
+        , mNumBlocks(numBlocks)
+        , mOverlay(mGlyphAtlas, densityArea(cfg), cfg.colorBackgroundRGB) {
 
+        // store the time of each 100k block, and the last block
+        auto heightToTimestring = std::map<uint32_t, std::string>();
         auto blockHeight = uint32_t();
-        auto nextTargetBlockHeight = uint32_t();
         while (blockHeight < numBlocks) {
-            if (blockHeight == nextTargetBlockHeight) {
-                auto [cib, newPtr] = buv::ChangesInBlock::decode(ptr);
-                nextTargetBlockHeight += 100000;
-                if (nextTargetBlockHeight > numBlocks - 1) {
-                    nextTargetBlockHeight = numBlocks - 1;
-                }
-                ptr = newPtr;
-                auto formattedTime = date::format("%F", UnixClockSeconds(std::chrono::seconds(cib.blockData().time)));
-                mHeightToTimestring[cib.blockData().blockHeight] = formattedTime;
-            } else {
-                auto tmp = uint32_t();
-                std::tie(tmp, ptr) = buv::ChangesInBlock::skip(ptr);
+            auto bd = blockDataAt(blockHeight);
+            auto formattedTime = date::format("%F", UnixClockSeconds(std::chrono::seconds(bd.time)));
+            heightToTimestring[bd.blockHeight] = formattedTime;
+
+            if (blockHeight == numBlocks - 1) {
+                break;
             }
-            ++blockHeight;
-        };
-    }
+            blockHeight += 100000;
+            if (blockHeight > numBlocks - 1) {
+                blockHeight = numBlocks - 1;
+            }
+        }
 
-    void writeAmount(size_t x,
-                     size_t y,
-                     char const* number,
-                     char const* denom,
-                     Origin originNumber = Origin::center_right,
-                     Origin originDenom = Origin::center_left) {
-        auto mid = 60;
-        auto offset = 3;
-        write(mMat, x + mid - offset, y, originNumber, number);
-        write(mMat, x + mid, y, originDenom, denom);
+        buildGlyphAtlas();
+        buildAxis(heightToTimestring);
+        buildLegend();
+
+        for (auto const* label : {"Hash",
+                                  "Height",
+                                  "Timestamp",
+                                  "Size",
+                                  "Weight Units",
+                                  "Number of Transactions",
+                                  "Number of UTXO created",
+                                  "Number of UTXO destroyed",
+                                  "Difficulty",
+                                  "Merkle Root",
+                                  "Chainwork",
+                                  "Version",
+                                  "Bits",
+                                  "Nonce"}) {
+            auto y = blockInfoY + static_cast<int>(mBlockInfoLabels.size()) * blockInfoLineSpacing;
+            mBlockInfoLabels.push_back(rasterizeText(0, y, Origin::top_left, label));
+        }
     }
 
-    // prints current block info
-    void writeBlockInfo(ChangesInBlock const& cib) {
-        auto legendX = mSatoshiBlockheightToPixel.blockheightToPixelWidth(cib.blockData().blockHeight);
-        auto const& blockHeader = cib.blockData();
+    // Draws directly into rgb
+    void draw(uint8_t* rgb, HudBlockInfo const& info) override {
+        writeBlockInfo(info);
 
-        auto column1x = mCfg.imageWidth - 1000;
-        if (legendX + 150 > column1x) {
-            column1x = 20;
+        auto const& blockHeader = info.blockData;
+        auto formattedTime = date::format("%F %T", UnixClockSeconds(std::chrono::seconds(blockHeader.time)));
+        auto x = static_cast<int>(mSatoshiBlockheightToPixel.blockheightToPixelWidth(blockHeader.blockHeight));
+
+        // block lines, and the X axis text when its distance to current line is large enough, so it's not overwritten
+        mOverlay.mask(mBlockLines, 0, 0);
+        for (auto const& label : mAxisLabels) {
+            auto distFromMid = std::abs(x - label.x);
+            if (distFromMid > 70) {
+                mOverlay.mask(label.thousands, 0, 0);
+            }
+            if (distFromMid > 190) {
+                mOverlay.mask(label.date, 0, 0);
+            }
         }
 
-        auto column2x = column1x + 960;
+        // current block marker
+        auto offset = static_cast<int>(mCfg.graphRect.h + mCfg.graphRect.y + 4);
+        mOverlay.mask(mCurrentBlockMarker, x, 0);
+        write(x, offset + 10 + 17, Origin::top_center, fmt::format("{}", blockHeader.blockHeight));
+        write(x, offset + 40 + 17, Origin::top_center, formattedTime);
 
-        auto y = 10;
-        auto lineSpacing = 30;
+        // satoshi lines and the legend
+        for (auto const& mask : mLegend) {
+            mOverlay.mask(mask, x, 0);
+        }
 
-        // see e.g.
-        // https://blockstream.info/block/0000000000000000000419b60c3f5d98fc6f541896b399cb14076220a718bc25?expand
-        // https://www.blockchain.com/btc/block/548847
+        mOverlay.draw(rgb, mCfg.imageWidth, mCfg.imageHeight);
+    }
+
+    [[nodiscard]] auto drawnRects() const -> std::vector<Rect<size_t>> const& override {
+        return mOverlay.drawnRects();
+    }
 
-        write(mMat, column1x, y, Origin::top_left, "Hash");
-        writeMono(mMat, column2x, y, Origin::top_right, util::toHex(blockHeader.hash).c_str());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Height");
-        write(mMat, column2x, y, Origin::top_right, "{}", blockHeader.blockHeight);
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Timestamp");
-        write(mMat,
-              column2x,
-              y,
-              Origin::top_right,
-              date::format("%F %T %Z", UnixClockSeconds(std::chrono::seconds(blockHeader.time))).c_str());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Size");
-        write(mMat, column2x, y, Origin::top_right, "{} B", blockHeader.size);
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Weight Units");
-        write(mMat, column2x, y, Origin::top_right, "{} WU", blockHeader.weight);
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Number of Transactions");
-        write(mMat, column2x, y, Origin::top_right, "{}", blockHeader.nTx);
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Number of UTXO created");
-        write(mMat, column2x, y, Origin::top_right, "{}", cib.numUtxoCreated());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Number of UTXO destroyed");
-        write(mMat, column2x, y, Origin::top_right, "{}", cib.numUtxoDestroyed());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Difficulty");
-        write(mMat, column2x, y, Origin::top_right, "{}", blockHeader.difficulty());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Merkle Root");
-        writeMono(mMat, column2x, y, Origin::top_right, util::toHex(blockHeader.merkleRoot).c_str());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Chainwork");
-        writeMono(mMat, column2x, y, Origin::top_right, util::toHex(blockHeader.chainWork).c_str());
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Version");
-        writeMono(mMat, column2x, y, Origin::top_right, "0x{:x}", blockHeader.version);
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Bits");
-        writeMono(mMat, column2x, y, Origin::top_right, "0x{}", util::toHex(blockHeader.bits));
-        y += lineSpacing;
-
-        write(mMat, column1x, y, Origin::top_left, "Nonce");
-        writeMono(mMat, column2x, y, Origin::top_right, "0x{:x}", blockHeader.nonce);
-        y += lineSpacing;
+private:
+    // the graph, plus the 1 pixel border where highlights can be
+    [[nodiscard]] static auto densityArea(Cfg const& cfg) -> Rect<size_t> {
+        auto x = std::max<size_t>(cfg.graphRect.x, 1) - 1;
+        auto y = std::max<size_t>(cfg.graphRect.y, 1) - 1;
+        return {x, y, cfg.graphRect.x + cfg.graphRect.w + 1 - x, cfg.graphRect.y + cfg.graphRect.h + 1 - y};
     }
 
-    // Copies rgbSource, then draws dat based on the given info.
-    void draw(uint8_t const* rgbSource, ChangesInBlock const& cib) override {
-        std::memcpy(mMat.ptr(), rgbSource, mMat.total() * mMat.elemSize());
+    void buildGlyphAtlas() {
+        auto baseline = int();
+        mTextSize = cv::getTextSize("0", fontFace, fontScale, thickness, &baseline);
 
-#if 0
-        mMat = cv::Scalar(70, 0, 20);
-        cv::rectangle(
-            mMat, cv::Rect(mCfg.graphRect.x, mCfg.graphRect.y, mCfg.graphRect.w, mCfg.graphRect.h), cv::Scalar(0, 155, 20));
-#endif
-        writeBlockInfo(cib);
+        // gets spacing for digit '0' and uses this for the spacing.
+        mMonoCellWidth = mTextSize.width;
 
-        auto const& blockHeader = cib.blockData();
-        auto formattedTime = date::format("%F %T", UnixClockSeconds(std::chrono::seconds(blockHeader.time)));
+        for (char ch = ' '; ch <= '~'; ++ch) {
+            auto text = std::string(1, ch);
+            // the text width includes the thickness once, not for each letter
+            auto advance = cv::getTextSize(text, fontFace, fontScale, thickness, &baseline).width - thickness;
+            mGlyphAtlas.set(ch, rasterizeText(0, 0, Origin::bottom_left, text), advance);
+        }
+    }
 
-        // draw satoshi lines
-        auto x = mSatoshiBlockheightToPixel.blockheightToPixelWidth(blockHeader.blockHeight);
-        auto oneBtc = int64_t(100'000'000);
-        for (int64_t mult = 1; mult <= oneBtc * 10000; mult *= 10) {
-            for (int64_t digit = 1; digit < 10; ++digit) {
-                auto y = mSatoshiBlockheightToPixel.satoshiToPixelHeight(digit * mult);
-                auto offset = 4;
+    void buildAxis(std::map<uint32_t, std::string> const& heightToTimestring) {
+        // block lines
+        auto offset = static_cast<int>(mCfg.graphRect.h + mCfg.graphRect.y + 4);
+        auto area = cv::Rect(0, offset, static_cast<int>(mCfg.imageWidth), 16);
+        mBlockLines = rasterize(area, [&](cv::Mat& mat, cv::Point shift) {
+            for (uint32_t h = 0; h < mNumBlocks; h += 10000) {
+                auto legendX = static_cast<int>(mSatoshiBlockheightToPixel.blockheightToPixelWidth(h));
                 auto len = 5;
-                if (digit == 1) {
+                if (h % 100000 == 0) {
                     len *= 2;
                 }
-                cv::line(mMat, cv::Point(x + offset, y), cv::Point(x + offset + len, y), cv::Scalar(255, 255, 255));
+                cv::line(mat, cv::Point(legendX, offset) + shift, cv::Point(legendX, offset + len) + shift, cv::Scalar(255));
             }
-        }
+        });
 
-        // draw block lines
-        auto offset = mCfg.graphRect.h + mCfg.graphRect.y + 4;
-        for (uint32_t h = 0; h < mNumBlocks; h += 10000) {
-            auto legendX = mSatoshiBlockheightToPixel.blockheightToPixelWidth(h);
-            auto len = 5;
-            if (h % 100000 == 0) {
-                len *= 2;
-            }
-            if (h == mNumBlocks - 1) {
-            }
-            cv::line(mMat, cv::Point(legendX, offset), cv::Point(legendX, offset + len), cv::Scalar(255, 255, 255));
-
-            // only print text when distance to current line is large enough, so it's not overwritten
-        }
-
-        // show X axis text
-        for (auto [blockHeight, formattedTime] : mHeightToTimestring) {
-            auto legendX = mSatoshiBlockheightToPixel.blockheightToPixelWidth(blockHeight);
-            auto distFromMid = std::abs(static_cast<int>(x) - static_cast<int>(legendX));
+        // X axis text
+        for (auto const& [blockHeight, formattedTime] : heightToTimestring) {
+            auto legendX = static_cast<int>(mSatoshiBlockheightToPixel.blockheightToPixelWidth(blockHeight));
             auto align = Origin::top_center;
             if (blockHeight == 0) {
                 align = Origin::top_left;
             }
 
             auto len = 10;
-            if (distFromMid > 70) {
-                write(mMat, legendX, offset + len + 17, align, "{}{}", blockHeight / 1000, blockHeight == 0 ? "" : "k");
-            }
+            auto thousands = fmt::format("{}{}", blockHeight / 1000, blockHeight == 0 ? "" : "k");
+            mAxisLabels.push_back({legendX,
+                                   rasterizeText(legendX, offset + len + 17, align, thousands),
+                                   rasterizeText(legendX, offset + len + 30 + 17, align, formattedTime)});
+        }
 
-            if (distFromMid > 190) {
-                write(mMat, legendX, offset + len + 30 + 17, align, formattedTime.c_str());
+        mCurrentBlockMarker = rasterize(cv::Rect(0, offset, 1, 16), [&](cv::Mat& mat, cv::Point shift) {
+            cv::line(mat, cv::Point(0, offset) + shift, cv::Point(0, offset + 15) + shift, cv::Scalar(255));
+        });
+    }
+
+    // relative to x = 0, the column of the current block
+    void buildLegend() {
+        // satoshi lines
+        auto oneBtc = int64_t(100'000'000);
+        auto area = cv::Rect(0, 0, 20, static_cast<int>(mCfg.imageHeight));
+        mLegend.push_back(rasterize(area, [&](cv::Mat& mat, cv::Point shift) {
+            for (int64_t mult = 1; mult <= oneBtc * 10000; mult *= 10) {
+                for (int64_t digit = 1; digit < 10; ++digit) {
+                    auto y = static_cast<int>(mSatoshiBlockheightToPixel.satoshiToPixelHeight(digit * mult));
+                    auto offset = 4;
+                    auto len = 5;
+                    if (digit == 1) {
+                        len *= 2;
+                    }
+                    cv::line(mat, cv::Point(offset, y) + shift, cv::Point(offset + len, y) + shift, cv::Scalar(255));
+                }
             }
-        }
+        }));
+
+        addAmount(10000 * oneBtc, "10", "kBTC", Origin::top_right, Origin::top_left);
+        addAmount(1000 * oneBtc, "1", "kBTC");
+        addAmount(100 * oneBtc, "100", "BTC");
+        addAmount(10 * oneBtc, "10", "BTC");
+        addAmount(oneBtc, "1", "BTC");
+        addAmount(10000000, "100", "mBTC");
+        addAmount(1000000, "10", "mBTC");
+        addAmount(100000, "1", "mBTC");
+        addAmount(10000, "100", "uBTC");
+        addAmount(1000, "10", "uBTC");
+        addAmount(100, "1", "uBTC");
+        addAmount(10, "10", "sat");
+        addAmount(1, "1", "sat", Origin::bottom_right, Origin::bottom_left);
+    }
 
-        // draw current block marker
-        cv::line(mMat, cv::Point(x, offset), cv::Point(x, offset + 15), cv::Scalar(255, 255, 255));
-        write(mMat, x, offset + 10 + 17, Origin::top_center, "{}", blockHeader.blockHeight);
-        write(mMat, x, offset + 40 + 17, Origin::top_center, "{}", formattedTime);
-
-        // draw the legend
-        writeAmount(x,
-                    mSatoshiBlockheightToPixel.satoshiToPixelHeight(10000 * oneBtc),
-                    "10",
-                    "kBTC",
-                    Origin::top_right,
-                    Origin::top_left);
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(1000 * oneBtc), "1", "kBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(100 * oneBtc), "100", "BTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(10 * oneBtc), "10", "BTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(oneBtc), "1", "BTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(10000000), "100", "mBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(1000000), "10", "mBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(100000), "1", "mBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(10000), "100", "uBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(1000), "10", "uBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(100), "1", "uBTC");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(10), "10", "sat");
-        writeAmount(x, mSatoshiBlockheightToPixel.satoshiToPixelHeight(1), "1", "sat", Origin::bottom_right, Origin::bottom_left);
+    void addAmount(int64_t satoshi,
+                   char const* number,
+                   char const* denom,
+                   Origin originNumber = Origin::center_right,
+                   Origin originDenom = Origin::center_left) {
+        auto y = static_cast<int>(mSatoshiBlockheightToPixel.satoshiToPixelHeight(satoshi));
+        auto mid = 60;
+        auto offset = 3;
+        mLegend.push_back(rasterizeText(mid - offset, y, originNumber, number));
+        mLegend.push_back(rasterizeText(mid, y, originDenom, denom));
     }
 
-    // Returns the drawn RGB data.
-    [[nodiscard]] auto data() const -> uint8_t const* override {
-        return static_cast<uint8_t const*>(mMat.datastart);
+    void write(int x, int y, Origin origin, std::string const& text) {
+        auto pos = alignedPos(x, y, origin, cv::Size(mGlyphAtlas.textWidth(text) + thickness, mTextSize.height));
+        mOverlay.text(pos.x, pos.y, text);
     }
 
-    [[nodiscard]] auto size() const -> size_t override {
-        return mMat.total() * mMat.elemSize();
+    // each letter has the width of '0'
+    void writeMono(int x, int y, Origin origin, std::string const& text) {
+        auto size = cv::Size(mMonoCellWidth * static_cast<int>(text.size()), mTextSize.height);
+        auto pos = alignedPos(x, y, origin, size);
+        mOverlay.textMono(pos.x, pos.y, text, mMonoCellWidth);
+    }
+
+    // prints current block info
+    void writeBlockInfo(HudBlockInfo const& info) {
+        auto legendX = mSatoshiBlockheightToPixel.blockheightToPixelWidth(info.blockData.blockHeight);
+        auto const& blockHeader = info.blockData;
+
+        auto column1x = static_cast<int>(mCfg.imageWidth) - 1000;
+        if (static_cast<int>(legendX) + 150 > column1x) {
+            column1x = 20;
+        }
+        auto column2x = column1x + 960;
+
+        for (auto const& label : mBlockInfoLabels) {
+            mOverlay.mask(label, column1x, 0);
+        }
+
+        // see e.g.
+        // https://blockstream.info/block/0000000000000000000419b60c3f5d98fc6f541896b399cb14076220a718bc25?expand
+        // https://www.blockchain.com/btc/block/548847
+        auto y = blockInfoY;
+        auto writeValue = [&](std::string const& text) {
+            write(column2x, y, Origin::top_right, text);
+            y += blockInfoLineSpacing;
+        };
+        auto writeMonoValue = [&](std::string const& text) {
+            writeMono(column2x, y, Origin::top_right, text);
+            y += blockInfoLineSpacing;
+        };
+
+        writeMonoValue(util::toHex(blockHeader.hash));
+        writeValue(fmt::format("{}", blockHeader.blockHeight));
+        writeValue(date::format("%F %T %Z", UnixClockSeconds(std::chrono::seconds(blockHeader.time))));
+        writeValue(fmt::format("{} B", blockHeader.size));
+        writeValue(fmt::format("{} WU", blockHeader.weight));
+        writeValue(fmt::format("{}", blockHeader.nTx));
+        writeValue(fmt::format("{}", info.numUtxoCreated));
+        writeValue(fmt::format("{}", info.numUtxoDestroyed));
+        writeValue(fmt::format("{}", blockHeader.difficulty()));
+        writeMonoValue(util::toHex(blockHeader.merkleRoot));
+        writeMonoValue(util::toHex(blockHeader.chainWork));
+        writeMonoValue(fmt::format("0x{:x}", blockHeader.version));
+        writeMonoValue(fmt::format("0x{}", util::toHex(blockHeader.bits)));
+        writeMonoValue(fmt::format("0x{:x}", blockHeader.nonce));
     }
 };
 
-auto Hud::create(Cfg const& cfg, uint32_t numBlocks, util::Mmap const& mmappedFile) -> std::unique_ptr<Hud> {
-    return std::make_unique<HudImpl>(cfg, numBlocks, mmappedFile);
+auto Hud::create(Cfg const& cfg, uint32_t numBlocks, std::function<BlockData(uint32_t)> const& blockDataAt)
+    -> std::unique_ptr<Hud> {
+    return std::make_unique<HudImpl>(cfg, numBlocks, blockDataAt);
 }
 
 } // namespace buv
@@ -2,16 +2,30 @@
 
 #include <app/BlockEncoder.h>
 #include <app/Cfg.h>
-#include <util/Mmap.h>
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace buv {
 
+// What the HUD shows of a block. Small, so it can be handed to another thread instead of the whole ChangesInBlock.
+struct HudBlockInfo {
+    BlockData blockData{};
+    size_t numUtxoCreated{};
+    size_t numUtxoDestroyed{};
+
+    [[nodiscard]] static auto of(ChangesInBlock const& cib) -> HudBlockInfo {
+        return {cib.blockData(), cib.numUtxoCreated(), cib.numUtxoDestroyed()};
+    }
+};
+
 // head up display
 class Hud {
 public:
-    static auto create(Cfg const& cfg, uint32_t numBlocks, util::Mmap const& mmappedFile) -> std::unique_ptr<Hud>;
+    // blockDataAt is only used while creating the HUD, for the block times on the axis.
+    static auto create(Cfg const& cfg, uint32_t numBlocks, std::function<BlockData(uint32_t)> const& blockDataAt)
+        -> std::unique_ptr<Hud>;
 
     Hud();
     virtual ~Hud();
@@ -21,14 +35,11 @@ public:
     auto operator=(Hud const&) -> Hud& = delete;
     auto operator=(Hud&&) -> Hud& = delete;
 
-    // Copies rgbSource, then draws dat based on the given info.
-    virtual void draw(uint8_t const* rgbSource, ChangesInBlock const& cib) = 0;
-
-    // Returns the drawn RGB data.
-    [[nodiscard]] virtual auto data() const -> uint8_t const* = 0;
+    // Draws the info directly into the RGB image of cfg.imageWidth x cfg.imageHeight pixels, without copying it.
+    virtual void draw(uint8_t* rgb, HudBlockInfo const& info) = 0;
 
-    // Number of bytes of the RGB data
-    [[nodiscard]] virtual auto size() const -> size_t = 0;
+    // Regions of the image that the last draw() has drawn over, clipped to the image.
+    [[nodiscard]] virtual auto drawnRects() const -> std::vector<Rect<size_t>> const& = 0;
 };
 
 } // namespace buv
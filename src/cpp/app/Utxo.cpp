@@ -5,6 +5,7 @@
 #include <fmt/format.h>
 #include <robin_hood.h>
 
+#include <array>
 #include <fstream>
 #include <map>
 #include <string>
@@ -14,29 +15,44 @@ namespace buv {
 
 namespace {
 
-// first creates a .tmp file, then renames when finished.
+// Format: "UTXO", blockheight, number of transactions. Then for each transaction: txid prefix, blockheight, number of vouts, and
+// all unspent VoutSatoshi sorted by vout.
 auto dump(uint32_t blockHeight, Utxo const& utxo, std::filesystem::path const& filename) -> size_t {
     auto fout = std::ofstream(filename, std::ios::binary);
     if (!fout.is_open()) {
         throw std::runtime_error("could not open file for writing UTXO");
     }
 
-    fout.write("UTXO0", 4);
+    fout.write("UTXO", 4);
     util::writeBinary<4>(blockHeight, fout);
     util::writeBinary<8>(utxo.map().size(), fout);
     auto numVouts = size_t();
+    auto voutSatoshis = std::vector<VoutSatoshi>();
     for (auto const& kv : utxo.map()) {
-        // key
-        util::writeArray<8>(kv.first, fout);
+        voutSatoshis.clear();
+        auto const& utxoPerTx = kv.second;
+        if (utxoPerTx.isSmallUtxo()) {
+            for (uint16_t idx = 0; idx < 2; ++idx) {
+                if (auto vs = utxoPerTx.voutSatoshi(idx); vs.vout() == 1) {
+                    voutSatoshis.emplace_back(idx, vs.satoshi());
+                }
+            }
+        } else {
+            for (auto const* chunk = utxoPerTx.chunk(); chunk != nullptr; chunk = chunk->next()) {
+                voutSatoshis.push_back(chunk->voutSatoshi());
+            }
+        }
 
-        // value
-        auto const* chunk = kv.second.chunk();
-        while (chunk != nullptr) {
-            util::writeBinary<8>(chunk->voutSatoshi().data(), fout);
-            chunk = chunk->next();
-            ++numVouts;
+        util::writeArray<8>(kv.first, fout);
+        util::writeBinary<4>(utxoPerTx.blockHeight(), fout);
+        util::writeBinary<4>(static_cast<uint32_t>(voutSatoshis.size()), fout);
+        for (auto const& vs : voutSatoshis) {
+            util::writeBinary<8>(vs.data(), fout);
         }
-        util::writeBinary<8>(VoutSatoshi().data(), fout);
+        numVouts += voutSatoshis.size();
+    }
+    if (!fout) {
+        throw std::runtime_error(fmt::format("could not write UTXO to '{}'", filename.string()));
     }
 
     return numVouts;
@@ -61,14 +77,32 @@ void serialize(uint32_t blockHeight, Utxo const& utxo, std::filesystem::path con
         throw std::runtime_error("could not open file for reading UTXO");
     }
 
-    auto header = util::readBinary<uint32_t>(fin);
-    if (header != 0x1) {
-        throw std::runtime_error(fmt::format("Got {:x} but expected {:x}", header, 0x1));
+    auto header = std::array<char, 4>();
+    fin.read(header.data(), header.size());
+    if (std::string_view(header.data(), header.size()) != "UTXO") {
+        throw std::runtime_error(fmt::format("'{}' is not a UTXO file", filename.string()));
     }
 
     auto blockHeight = util::readBinary<uint32_t>(fin);
-
-    auto utxo = Utxo();
+    auto numTx = util::readBinary<uint64_t>(fin);
+
+    auto utxo = Utxo(numTx);
+    auto voutSatoshis = std::vector<VoutSatoshi>();
+    for (uint64_t i = 0; i < numTx && fin; ++i) {
+        auto txid = util::readBinary<TxIdPrefix>(fin);
+        auto txBlockHeight = util::readBinary<uint32_t>(fin);
+        auto numVouts = util::readBinary<uint32_t>(fin);
+        voutSatoshis.clear();
+        for (uint32_t v = 0; v < numVouts && fin; ++v) {
+            // same layout as VoutSatoshi::data()
+            auto data = util::readBinary<uint64_t>(fin);
+            voutSatoshis.emplace_back(static_cast<uint16_t>(data), static_cast<int64_t>(data >> 16U));
+        }
+        utxo.insertUnspent(txid, txBlockHeight, voutSatoshis);
+    }
+    if (!fin) {
+        throw std::runtime_error(fmt::format("'{}' is truncated", filename.string()));
+    }
     return std::make_pair(blockHeight, std::move(utxo));
 }
 
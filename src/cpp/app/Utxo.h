@@ -94,6 +94,13 @@ public:
         std::memcpy(mChunkPtrOrVoutSatoshi.data() + sizeof(void*), &ptr, sizeof(void*));
     }
 
+    // Slot idx of a small utxo. vout==1 means place is taken
+    [[nodiscard]] auto voutSatoshi(uint16_t idx) const -> VoutSatoshi {
+        auto vs = VoutSatoshi();
+        std::memcpy(&vs, mChunkPtrOrVoutSatoshi.data() + sizeof(VoutSatoshi) * idx, sizeof(VoutSatoshi));
+        return vs;
+    }
+
     void voutSatoshi(uint16_t idx, int64_t satoshi) {
         // vout==1 means place is taken
         auto vs = VoutSatoshi(1, satoshi);
@@ -150,9 +157,9 @@ class Utxo {
     static_assert(sizeof(Map::value_type) == sizeof(TxIdPrefix) + sizeof(UtxoPerTx));
 
 public:
-    Utxo() {
-        // we certainly have to keep a lot of data around. Reserve because we know we'll need it
-        mTxidToUtxos.reserve(100'000'000);
+    // we certainly have to keep a lot of data around. Reserve because we know we'll need it
+    explicit Utxo(size_t expectedNumTx = 100'000'000) {
+        mTxidToUtxos.reserve(expectedNumTx);
     }
 
     template <typename Op>
@@ -196,6 +203,65 @@ public:
         return utxoPerTx.satoshi(mChunkStore, satoshi);
     }
 
+    // Inserts the vouts that are still unspent, sorted by vout. Used when loading a serialized utxo.
+    void insertUnspent(TxIdPrefix const& txIdPrefix, uint32_t blockHeight, std::vector<VoutSatoshi> const& voutSatoshis) {
+        auto& utxoPerTx = mTxidToUtxos[txIdPrefix];
+        utxoPerTx.blockHeight(blockHeight);
+        if (!voutSatoshis.empty() && voutSatoshis.back().vout() < 2) {
+            for (auto const& vs : voutSatoshis) {
+                utxoPerTx.voutSatoshi(vs.vout(), vs.satoshi());
+            }
+            return;
+        }
+
+        Chunk* root = nullptr;
+        Chunk* ptr = nullptr;
+        for (auto const& vs : voutSatoshis) {
+            ptr = mChunkStore.insert(vs.vout(), vs.satoshi(), ptr);
+            if (root == nullptr) {
+                root = ptr;
+            }
+        }
+        utxoPerTx.chunk(root);
+    }
+
+    // Puts a vout back that was removed with removeAllSorted. This is used to undo a block on a reorg.
+    void restore(TxIdPrefix const& txIdPrefix, uint32_t blockHeight, uint16_t vout, int64_t satoshi) {
+        if (auto it = mTxidToUtxos.find(txIdPrefix); it != mTxidToUtxos.end()) {
+            auto& utxoPerTx = it->second;
+            if (utxoPerTx.isSmallUtxo() && vout < 2) {
+                utxoPerTx.voutSatoshi(vout, satoshi);
+            } else if (utxoPerTx.isSmallUtxo()) {
+                // A loaded utxo stores a transaction as small when only vout 0 and 1 were left, so other vouts need a chunk list.
+                Chunk* root = nullptr;
+                for (uint16_t idx = 0; idx < 2; ++idx) {
+                    if (auto vs = utxoPerTx.voutSatoshi(idx); vs.vout() == 1) {
+                        root = mChunkStore.insertSorted(idx, vs.satoshi(), root);
+                    }
+                }
+                utxoPerTx.chunk(mChunkStore.insertSorted(vout, satoshi, root));
+            } else {
+                utxoPerTx.chunk(mChunkStore.insertSorted(vout, satoshi, utxoPerTx.chunk()));
+            }
+            return;
+        }
+
+        // The transaction was fully spent. We don't know how many vouts it had, so small utxo optimization can't be used here.
+        auto& utxoPerTx = mTxidToUtxos[txIdPrefix];
+        utxoPerTx.blockHeight(blockHeight);
+        utxoPerTx.chunk(mChunkStore.insertSorted(vout, satoshi, nullptr));
+    }
+
+    // Removes the whole transaction, regardless of which vouts are still available. Used to undo a block on a reorg.
+    void erase(TxIdPrefix const& txIdPrefix) {
+        if (auto it = mTxidToUtxos.find(txIdPrefix); it != mTxidToUtxos.end()) {
+            if (!it->second.isSmallUtxo()) {
+                mChunkStore.removeAll(it->second.chunk());
+            }
+            mTxidToUtxos.erase(it);
+        }
+    }
+
     [[nodiscard]] auto map() const -> Map const& {
         return mTxidToUtxos;
     }
@@ -1,9 +1,15 @@
 #include "app/fetchAllBlockHeaders.h"
 #include <app/Cfg.h>
+#include <app/CompressedBlk.h>
 #include <app/Hud.h>
 #include <app/forEachChange.h>
 #include <buv/Density.h>
+#include <buv/QueuedStream.h>
+#include <buv/SharedMemoryRing.h>
 #include <buv/SocketStream.h>
+#include <buv/Yuv420pStream.h>
+#include <util/BackgroundWorker.h>
+#include <util/StageTimes.h>
 #include <util/Throttle.h>
 #include <util/args.h>
 #include <util/kbhit.h>
@@ -14,8 +20,13 @@
 #include <fmt/ranges.h>
 #include <simdjson.h>
 
+#include <chrono>
 #include <cmath>
 #include <fstream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
 
 using namespace std::literals;
 
@@ -26,11 +37,37 @@ void saveImagePPM(size_t width, size_t height, uint8_t const* data, std::string
     fout.write(reinterpret_cast<char const*>(data), width * height * 3U);
 }
 
+// The sink selected by outputSink
+auto createSocketStream(buv::Cfg const& cfg) -> std::unique_ptr<buv::SocketStream> {
+    if (cfg.outputSink == "tcp") {
+        return buv::SocketStream::create(cfg.connectionIpAddr.c_str(), cfg.connectionSocket);
+    }
+    if (cfg.outputSink == "unix") {
+        return buv::SocketStream::createUnix(cfg.outputPath);
+    }
+    if (cfg.outputSink == "fifo") {
+        return buv::SocketStream::createFifo(cfg.outputPath);
+    }
+    if (cfg.outputSink == "shm") {
+        // an RGB frame is the largest write, the yuv420p ones are half the size. A few frames are enough to smooth out hiccups.
+        return std::make_unique<buv::SharedMemoryRingWriter>(cfg.outputPath, cfg.imageWidth * cfg.imageHeight * 3, 4);
+    }
+    if (cfg.outputSink == "null") {
+        return buv::SocketStream::createNull();
+    }
+    throw std::runtime_error(fmt::format("unknown outputSink '{}', use 'tcp', 'unix', 'fifo', 'shm', or 'null'", cfg.outputSink));
+}
+
 // clang-format off
 //
 // 1. Start ffmpeg or ffplay (see below)
 //    * ffplay -f rawvideo -pixel_format rgb24 -video_size 3840x2160 -framerate 60 -i "tcp://127.0.0.1:12987?listen"
 //    * ffmpeg -f rawvideo -pixel_format rgb24 -video_size 3840x2160 -framerate 60 -i "tcp://127.0.0.1:12987?listen" -c:v libx264 -profile:v high -bf 2 -g 30 -preset slower -crf 24 -pix_fmt yuv420p -movflags faststart out.mp4
+//    * with "outputPixelFormat": "yuv420p" size and frame rate are in the stream:
+//      ffmpeg -f yuv4mpegpipe -i "tcp://127.0.0.1:12987?listen" -c:v libx264 -profile:v high -bf 2 -g 30 -preset slower -crf 24 -movflags faststart out.mp4
+//    * local sinks without TCP, see "outputSink" in README.md:
+//      ffmpeg -f rawvideo -pixel_format rgb24 -video_size 3840x2160 -framerate 60 -listen 1 -i unix:/tmp/buv.sock ...
+//      ffmpeg -f rawvideo -pixel_format rgb24 -video_size 3840x2160 -framerate 60 -i /tmp/buv.fifo ...
 //        -crf 23: 23GB
 //    * recommended settings: https://gist.github.com/mikoim/27e4e0dc64e384adbcb91ff10a2d3678
 //
@@ -40,58 +77,180 @@ void saveImagePPM(size_t width, size_t height, uint8_t const* data, std::string
 TEST_CASE("visualizer" * doctest::skip()) {
     auto cfg = buv::parseCfg(util::args::get("-cfg").value());
 
-    LOG("mmapping '{}', this could take a while...", cfg.blkFile);
-    auto file = util::Mmap(cfg.blkFile);
-    auto numBlocks = buv::numBlocks(file);
+    if (cfg.blkReadMode != "populate" && cfg.blkReadMode != "lazy" && cfg.blkReadMode != "stream") {
+        throw std::runtime_error(fmt::format("unknown blkReadMode '{}', use 'populate', 'lazy', or 'stream'", cfg.blkReadMode));
+    }
+    if (cfg.outputPixelFormat != "rgb24" && cfg.outputPixelFormat != "yuv420p") {
+        throw std::runtime_error(fmt::format("unknown outputPixelFormat '{}', use 'rgb24' or 'yuv420p'", cfg.outputPixelFormat));
+    }
+    if (cfg.outputQueuePolicy != "block" && cfg.outputQueuePolicy != "drop") {
+        throw std::runtime_error(fmt::format("unknown outputQueuePolicy '{}', use 'block' or 'drop'", cfg.outputQueuePolicy));
+    }
+    if (cfg.blkReadMode == "populate") {
+        LOG("mmapping '{}', this could take a while...", cfg.blkFile);
+    }
+
+    // the index still needs the mapping, but in lazy and stream mode that doesn't read the file
+    auto file = util::Mmap(cfg.blkFile, cfg.blkReadMode == "populate" ? util::MmapMode::populate : util::MmapMode::lazy);
+
+    // a compressed .blk file has its own group index, and its groups are always decompressed in parallel
+    auto compressedBlk = std::optional<buv::CompressedBlk>();
+    auto index = std::optional<buv::BlkIndex>();
+    if (buv::CompressedBlk::isCompressed(file)) {
+        LOG("'{}' is compressed, ignoring blkReadMode", cfg.blkFile);
+        compressedBlk.emplace(cfg.blkFile);
+    } else {
+        index.emplace(buv::loadOrBuildBlkIndex(cfg.blkFile, file));
+    }
+    auto numBlocks = compressedBlk ? compressedBlk->numBlocks() : buv::numBlocks(*index);
     LOG("{} blocks, overwritting cfg with that setting", numBlocks);
 
     auto density = buv::Density(cfg, numBlocks);
     auto throttler = util::ThrottlePeriodic(1000ms);
 
-    auto hud = buv::Hud::create(cfg, numBlocks, file);
-    auto socketStream = buv::SocketStream::create(cfg.connectionIpAddr.c_str(), cfg.connectionSocket);
+    auto hud = buv::Hud::create(cfg, numBlocks, [&](uint32_t blockHeight) {
+        return compressedBlk ? compressedBlk->blockDataAt(blockHeight) : (*index)[blockHeight].blockData;
+    });
+    auto socketStream = createSocketStream(cfg);
+    if (cfg.outputPixelFormat == "yuv420p") {
+        socketStream = std::make_unique<buv::Yuv420pStream>(
+            std::move(socketStream), cfg.imageWidth, cfg.imageHeight, cfg.outputFrameRate);
+    }
+
+    // outermost, so whole frames are queued or dropped, and the conversion to yuv420p runs on the queue's thread too
+    buv::QueuedStream* queuedStream = nullptr;
+    if (cfg.outputQueueFrames != 0) {
+        auto policy = cfg.outputQueuePolicy == "drop" ? buv::QueuedStream::Policy::drop : buv::QueuedStream::Policy::block;
+        auto stream = std::make_unique<buv::QueuedStream>(std::move(socketStream), cfg.outputQueueFrames, policy);
+        queuedStream = stream.get();
+        socketStream = std::move(stream);
+    }
+    auto logOutput = [&] {
+        if (queuedStream != nullptr) {
+            LOG("output: {}", queuedStream->report());
+        }
+    };
+    auto frameSize = cfg.imageWidth * cfg.imageHeight * 3;
+
+    // Pipeline: blocks are decoded in the background (except in stream mode), density is updated on this thread, and the HUD is
+    // drawn and the frame sent by sinkWorker. So the next block is already decoded and applied to the density while a frame is
+    // sent. Only drawing into the frame has to wait until the sink is done with it.
+    //
+    // The HUD is drawn directly into density's frame, which is then sent as it is. The HUD is removed in the next frame.
+    auto sinkWorker = util::BackgroundWorker();
+    enum : size_t { stageDecode, stageDensity, stageWaitForSink };
+    enum : size_t { stageHud, stageSend };
+    auto times = util::StageTimes({"decode", "density", "wait for sink"});
+    auto sinkTimes = util::StageTimes({"hud", "send"});
+    uint8_t const* lastFrame = nullptr;
+
+    auto waitForSink = [&] {
+        times.measure(stageWaitForSink, [&] {
+            sinkWorker.wait();
+        });
+    };
+
+    // only call when the sink is done with the frame
+    auto showFrame = [&](uint8_t* frame, buv::HudBlockInfo const& info) {
+        lastFrame = frame;
+        sinkWorker.submit([&, frame, info] {
+            sinkTimes.measure(stageHud, [&] {
+                hud->draw(frame, info);
+            });
+            sinkTimes.measure(stageSend, [&] {
+                socketStream->write(frame, frameSize);
+            });
+            sinkTimes.endRound();
 
-    auto lastCib = buv::forEachChange(file, [&](buv::ChangesInBlock const& cib) {
+            // density doesn't touch the frame until this job is done
+            for (auto const& rect : hud->drawnRects()) {
+                density.invalidate(rect);
+            }
+        });
+    };
+
+    auto lastBlockEnd = std::chrono::steady_clock::now();
+    auto onBlock = [&](buv::ChangesInBlock const& cib) {
+        times.add(stageDecode, std::chrono::steady_clock::now() - lastBlockEnd);
         auto blockHeight = cib.blockData().blockHeight;
-        LOGIF(throttler(), "block {}, {} changes", blockHeight, cib.changeAtBlockheights().size());
 
-        density.begin_block(blockHeight);
-        for (auto const& change : cib.changeAtBlockheights()) {
-            density.change(change.blockHeight(), change.satoshi());
+        times.measure(stageDensity, [&] {
+            density.applyBlock(cib);
+        });
+
+        waitForSink();
+        if (throttler()) {
+            LOG("block {}, {} changes", blockHeight, cib.numChanges());
+            LOG("per block: {}. per frame: {}", times.report(), sinkTimes.report());
+            logOutput();
         }
 
-        density.end_block(blockHeight, [&](uint8_t const* data) {
-            hud->draw(data, cib);
-            socketStream->write(hud->data(), hud->size());
+        times.measure(stageDensity, [&] {
+            density.end_block(blockHeight, [&](uint8_t* frame) {
+                showFrame(frame, buv::HudBlockInfo::of(cib));
+            });
         });
 
         if (util::kbhit()) {
             switch (std::getchar()) {
             case 'q':
-                // quit
+                // quit, without waiting for the consumer to take all queued frames
+                if (queuedStream != nullptr) {
+                    queuedStream->abandon();
+                }
                 return false;
 
-            case 's': {
-                auto imgFileName = fmt::format("img_{:07}.ppm", blockHeight);
-                LOG("Writing image '{}'", imgFileName);
-                saveImagePPM(cfg.imageWidth, cfg.imageHeight, hud->data(), imgFileName);
-            }
+            case 's':
+                waitForSink();
+                if (lastFrame != nullptr) {
+                    auto imgFileName = fmt::format("img_{:07}.ppm", blockHeight);
+                    LOG("Writing image '{}'", imgFileName);
+                    saveImagePPM(cfg.imageWidth, cfg.imageHeight, lastFrame, imgFileName);
+                }
             }
         }
 
+        times.endRound();
+        lastBlockEnd = std::chrono::steady_clock::now();
         return true;
-    });
+    };
+
+    auto lastCib = buv::ChangesInBlock();
+    if (compressedBlk) {
+        lastCib = buv::forEachChange(*compressedBlk, 0, onBlock);
+    } else if (cfg.blkReadMode == "stream") {
+        auto stream = util::PreadStream(cfg.blkFile);
+        lastCib = buv::forEachChange(stream, onBlock);
+    } else {
+        // Decoders run up to numResources blocks ahead of onBlock, so the prefetch window has to start at the furthest block they
+        // can have claimed. Pages are only dropped behind onBlock's block, all decoders are past that.
+        auto numWorkers = size_t(std::thread::hardware_concurrency());
+        auto numResources = numWorkers * 2;
+        auto frames = buv::framePointers(file, *index);
+        lastCib = buv::parallelForEachChange(
+            frames, util::ResourceId{numResources}, util::ConcurrentWorkers{numWorkers}, [&](buv::ChangesInBlock const& cib) {
+                auto blockHeight = cib.blockData().blockHeight;
+                file.readahead(frames[blockHeight], frames[std::min(blockHeight + numResources, frames.size() - 1)]);
+                return onBlock(cib);
+            });
+    }
 
     // fade out & keep last image for 1 minute
+    auto lastInfo = buv::HudBlockInfo::of(lastCib);
     for (uint32_t i = 0; i < cfg.repeatLastBlockTimes; ++i) {
-        density.fadeOut(lastCib.blockData().blockHeight + i + 1, [&](uint8_t const* data) {
-            hud->draw(data, lastCib);
-            socketStream->write(hud->data(), hud->size());
-
-            if (i == cfg.repeatLastBlockTimes - 1) {
-                auto imgFileName = fmt::format("img_{:07}.ppm", lastCib.blockData().blockHeight);
-                saveImagePPM(cfg.imageWidth, cfg.imageHeight, hud->data(), imgFileName);
-            }
+        waitForSink();
+        density.fadeOut(lastCib.blockData().blockHeight + i + 1, [&](uint8_t* frame) {
+            showFrame(frame, lastInfo);
         });
     }
+    waitForSink();
+    if (cfg.repeatLastBlockTimes != 0) {
+        auto imgFileName = fmt::format("img_{:07}.ppm", lastCib.blockData().blockHeight);
+        saveImagePPM(cfg.imageWidth, cfg.imageHeight, lastFrame, imgFileName);
+    }
+    LOG("per block: {}. per frame: {}", times.report(), sinkTimes.report());
+
+    // the last frame could still be in a background thread, which would lose its errors when destroyed
+    socketStream->flush();
+    logOutput();
 }
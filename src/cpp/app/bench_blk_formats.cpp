@@ -0,0 +1,56 @@
+#include <app/BlkIndex.h>
+#include <app/Cfg.h>
+#include <app/forEachChange.h>
+#include <util/args.h>
+#include <util/log.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+// Compares size and decoding speed of all frame formats, on real data from cfg.blkFile. E.g.
+//
+//   ./buv -ns -tc=bench_blk_formats -cfg=../../buv.json -from=600000 -count=2000
+TEST_CASE("bench_blk_formats" * doctest::skip()) {
+    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+    auto from = static_cast<uint32_t>(std::stoul(util::args::get("-from").value_or("600000")));
+    auto count = std::stoul(util::args::get("-count").value_or("2000"));
+
+    auto blkFile = util::Mmap(cfg.blkFile);
+    auto index = buv::loadOrBuildBlkIndex(cfg.blkFile, blkFile);
+
+    auto cibs = std::vector<buv::ChangesInBlock>();
+    auto numChanges = size_t();
+    buv::forEachChange(blkFile, index, from, [&](buv::ChangesInBlock const& cib) {
+        cibs.push_back(cib);
+        numChanges += cib.numUtxoCreated() + cib.numUtxoDestroyed();
+        return cibs.size() < count;
+    });
+    LOG("{} blocks from {}, {} changes", cibs.size(), from, numChanges);
+
+    static constexpr auto formats = std::array{std::pair{buv::BlkFormat::varint, "varint"},
+                                               std::pair{buv::BlkFormat::streamVByte, "streamvbyte"},
+                                               std::pair{buv::BlkFormat::golombRice, "golombrice"},
+                                               std::pair{buv::BlkFormat::varintRle, "varintrle"}};
+
+    auto bench = ankerl::nanobench::Bench().batch(numChanges).unit("change").minEpochIterations(3);
+    for (auto const& [format, name] : formats) {
+        auto data = std::string();
+        for (auto const& cib : cibs) {
+            data += cib.encode(format);
+        }
+        LOG("{:>12}: {:12} bytes, {:6.3f} bytes/change", name, data.size(), static_cast<double>(data.size()) / numChanges);
+
+        bench.run(name, [&] {
+            auto cib = buv::ChangesInBlock();
+            auto const* ptr = data.data();
+            while (ptr != data.data() + data.size()) {
+                std::tie(cib, ptr) = buv::ChangesInBlock::decode(std::move(cib), ptr);
+            }
+            ankerl::nanobench::doNotOptimizeAway(cib);
+        });
+    }
+}
@@ -0,0 +1,103 @@
+#include <app/BlockEncoder.h>
+#include <util/args.h>
+#include <util/radixSort.h>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Changes like in a block at currentHeight: created amounts are often round or dust, spent outputs are mostly recent.
+auto generateBlockChanges(ankerl::nanobench::Rng& rng, uint32_t currentHeight, size_t numChanges)
+    -> std::vector<buv::ChangeAtBlockheight> {
+    auto changes = std::vector<buv::ChangeAtBlockheight>();
+    for (size_t i = 0; i < numChanges; ++i) {
+        auto satoshi = int64_t();
+        switch (rng.bounded(4)) {
+        case 0:
+            // round amounts, e.g. 0.01 BTC
+            satoshi = static_cast<int64_t>(rng.bounded(1000) + 1) * 100'000;
+            break;
+        case 1:
+            // dust
+            satoshi = static_cast<int64_t>(546 + rng.bounded(10'000));
+            break;
+        default:
+            // log-uniform between 1000 sat and 1000 BTC
+            satoshi = std::llround(std::pow(10.0, 3.0 + rng.uniform01() * 8.0));
+            break;
+        }
+
+        // a bit more spent than created, spent heights skewed towards recent blocks
+        if (rng.bounded(100) < 55) {
+            auto age = static_cast<uint32_t>(std::pow(rng.uniform01(), 4.0) * currentHeight);
+            changes.emplace_back(-satoshi, currentHeight - age);
+        } else {
+            changes.emplace_back(satoshi, currentHeight);
+        }
+    }
+    return changes;
+}
+
+} // namespace
+
+// Compares buv::sortChanges (radix sort) with std::sort on generated blocks, and the vout sorting. E.g.
+//
+//   ./buv -ns -tc=bench_sort -height=700000
+TEST_CASE("bench_sort" * doctest::skip()) {
+    auto height = static_cast<uint32_t>(std::stoul(util::args::get("-height").value_or("700000")));
+    auto rng = ankerl::nanobench::Rng(42);
+
+    for (size_t numChanges : {500, 5'000, 20'000}) {
+        auto unsorted = generateBlockChanges(rng, height, numChanges);
+        auto changes = unsorted;
+        auto bench = ankerl::nanobench::Bench().batch(numChanges).unit("change").relative(true).minEpochIterations(20);
+        bench.title(fmt::format("{} changes", numChanges));
+
+        bench.run("std::sort", [&] {
+            changes = unsorted;
+            std::sort(changes.begin(), changes.end());
+            ankerl::nanobench::doNotOptimizeAway(changes);
+        });
+        bench.run("buv::sortChanges", [&] {
+            changes = unsorted;
+            buv::sortChanges(changes);
+            ankerl::nanobench::doNotOptimizeAway(changes);
+        });
+    }
+
+    // vouts spent from the same transaction, most of the time only a few
+    auto vouts = std::vector<std::vector<uint16_t>>(10'000);
+    auto numVouts = size_t();
+    for (auto& v : vouts) {
+        auto size = rng.bounded(20) == 0 ? rng.bounded(200) + 1 : rng.bounded(4) + 1;
+        for (size_t i = 0; i < size; ++i) {
+            v.push_back(static_cast<uint16_t>(rng.bounded(size * 2)));
+        }
+        numVouts += size;
+    }
+    auto sorted = vouts;
+    auto scratch = std::vector<uint16_t>();
+    auto bench = ankerl::nanobench::Bench().batch(numVouts).unit("vout").relative(true).minEpochIterations(20);
+    bench.title("vouts");
+    bench.run("std::sort", [&] {
+        for (size_t i = 0; i < vouts.size(); ++i) {
+            sorted[i] = vouts[i];
+            std::sort(sorted[i].begin(), sorted[i].end());
+        }
+        ankerl::nanobench::doNotOptimizeAway(sorted);
+    });
+    bench.run("util::radixSort", [&] {
+        for (size_t i = 0; i < vouts.size(); ++i) {
+            sorted[i] = vouts[i];
+            util::radixSort(sorted[i], scratch);
+        }
+        ankerl::nanobench::doNotOptimizeAway(sorted);
+    });
+}
@@ -0,0 +1,23 @@
+#include <app/BlkIndex.h>
+#include <app/Cfg.h>
+#include <util/Mmap.h>
+#include <util/args.h>
+#include <util/log.h>
+
+#include <doctest.h>
+
+// Rebuilds the index of an existing .blk file, e.g. one that was created before indices existed.
+TEST_CASE("build_blk_index" * doctest::skip()) {
+    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+
+    auto blkFile = util::Mmap(cfg.blkFile);
+    if (!blkFile.is_open()) {
+        throw std::runtime_error("could not open");
+    }
+
+    auto indexFilename = buv::blkIndexFilename(cfg.blkFile);
+    buv::buildBlkIndex(blkFile, indexFilename);
+
+    auto index = buv::BlkIndex(indexFilename);
+    LOG("wrote {} entries into '{}'", index.size(), indexFilename.string());
+}
@@ -0,0 +1,67 @@
+#include <app/BlkIndex.h>
+#include <app/Cfg.h>
+#include <app/CompressedBlk.h>
+#include <util/Throttle.h>
+#include <util/args.h>
+#include <util/log.h>
+#include <util/parallelToSequential.h>
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+// Writes a compressed copy of cfg.blkFile. Groups are compressed in parallel. E.g.
+//
+//   ./buv -ns -tc=compress_blk -cfg=../../buv.json -out=changes.blkz -blocksPerGroup=256 -level=19
+TEST_CASE("compress_blk" * doctest::skip()) {
+    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+    auto outFilename = util::args::get("-out").value();
+    auto blocksPerGroup = static_cast<uint32_t>(std::stoul(util::args::get("-blocksPerGroup").value_or("256")));
+    auto level = std::stoi(util::args::get("-level").value_or("19"));
+
+    auto blkFile = util::Mmap(cfg.blkFile);
+    auto index = buv::loadOrBuildBlkIndex(cfg.blkFile, blkFile);
+    auto numBlocks = static_cast<uint32_t>(index.size());
+    auto numGroups = (numBlocks + blocksPerGroup - 1) / blocksPerGroup;
+
+    // the frames of each group are already contiguous in the .blk file
+    auto groupFrames = [&](size_t groupIdx) {
+        auto firstBlockHeight = static_cast<uint32_t>(groupIdx * blocksPerGroup);
+        auto endBlockHeight = std::min(firstBlockHeight + blocksPerGroup, numBlocks);
+        auto const* begin = index.frame(blkFile, firstBlockHeight);
+        auto const* end = endBlockHeight == numBlocks ? blkFile.end() : index.frame(blkFile, endBlockHeight);
+        return std::string_view(begin, static_cast<size_t>(end - begin));
+    };
+
+    auto numWorkers = size_t(std::thread::hardware_concurrency());
+    auto compressed = std::vector<std::string>(numWorkers * 2);
+    auto writer = buv::CompressedBlkWriter(outFilename, blocksPerGroup);
+    auto throttler = util::ThrottlePeriodic(1000ms);
+    auto compressedBytes = size_t();
+
+    util::parallelToSequential(
+        util::SequenceId{numGroups},
+        util::ResourceId{compressed.size()},
+        util::ConcurrentWorkers{numWorkers},
+        [&](util::ResourceId resourceId, util::SequenceId sequenceId) {
+            compressed[resourceId.count()] = buv::compressGroup(groupFrames(sequenceId.count()), level);
+        },
+        [&](util::ResourceId resourceId, util::SequenceId sequenceId) {
+            auto firstBlockHeight = static_cast<uint32_t>(sequenceId.count() * blocksPerGroup);
+            auto frames = groupFrames(sequenceId.count());
+            writer.append(firstBlockHeight,
+                          std::min(blocksPerGroup, numBlocks - firstBlockHeight),
+                          static_cast<uint32_t>(frames.size()),
+                          compressed[resourceId.count()]);
+            compressedBytes += compressed[resourceId.count()].size();
+            LOGIF(throttler(), "block {}, {} bytes compressed", firstBlockHeight, compressedBytes);
+        });
+    writer.finish();
+
+    LOG("compressed {} blocks in {} groups: {} bytes -> {} bytes", numBlocks, numGroups, blkFile.size(), compressedBytes);
+}
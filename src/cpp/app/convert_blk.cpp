@@ -0,0 +1,35 @@
+#include <app/BlkWriter.h>
+#include <app/Cfg.h>
+#include <app/forEachChange.h>
+#include <util/Throttle.h>
+#include <util/args.h>
+#include <util/log.h>
+
+#include <doctest.h>
+
+using namespace std::literals;
+
+// Rewrites cfg.blkFile into a new file with another frame format, together with its index. E.g.
+//
+//   ./buv -ns -tc=convert_blk -cfg=../../buv.json -out=changes.blk3 -format=streamvbyte
+//
+// When -format is not given, cfg.blkFormat is used.
+TEST_CASE("convert_blk" * doctest::skip()) {
+    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+    auto outFilename = util::args::get("-out").value();
+    auto format = buv::parseBlkFormat(util::args::get("-format").value_or(cfg.blkFormat));
+
+    auto blkFile = util::Mmap(cfg.blkFile);
+    auto index = buv::loadOrBuildBlkIndex(cfg.blkFile, blkFile);
+    auto writer = buv::BlkWriter(outFilename, format);
+
+    auto throttler = util::ThrottlePeriodic(1000ms);
+    buv::parallelForEachChange(buv::framePointers(blkFile, index), [&](buv::ChangesInBlock const& cib) {
+        LOGIF(throttler(), "block {}, {} bytes written", cib.blockData().blockHeight, writer.fileOffset());
+        writer.write(cib);
+        return true;
+    });
+    writer.flush();
+
+    LOG("converted {} blocks: {} bytes -> {} bytes", index.size(), blkFile.size(), writer.fileOffset());
+}
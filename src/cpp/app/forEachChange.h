@@ -1,33 +1,241 @@
 #pragma once
 
+#include <app/BlkIndex.h>
 #include <app/BlockEncoder.h>
+#include <app/CompressedBlk.h>
 #include <util/Mmap.h>
+#include <util/PreadStream.h>
+#include <util/parallelToSequential.h>
 
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace buv {
 
+// decodes all blocks from ptr to end, and calls op for each of them until op returns false.
+template <typename Op>
+auto forEachChange(char const* ptr, char const* end, Op op) -> buv::ChangesInBlock {
+    auto cib = buv::ChangesInBlock();
+    while (ptr != end) {
+        std::tie(cib, ptr) = buv::ChangesInBlock::decode(std::move(cib), ptr);
+        // NOLINTNEXTLINE(bugprone-use-after-move,hicpp-invalid-access-moved)
+        if (!op(cib)) {
+            return cib;
+        }
+    }
+
+    return cib;
+}
+
 template <typename Op>
 auto forEachChange(util::Mmap const& mmappedFile, Op op) -> buv::ChangesInBlock {
     if (!mmappedFile.is_open()) {
         throw std::runtime_error("file not open");
     }
+    return forEachChange(mmappedFile.begin(), mmappedFile.end(), std::move(op));
+}
 
-    auto const* ptr = mmappedFile.begin();
-    auto const* end = mmappedFile.end();
+// Same as above, but uses the index to directly start at startBlockHeight.
+template <typename Op>
+auto forEachChange(util::Mmap const& mmappedFile, BlkIndex const& index, uint32_t startBlockHeight, Op op)
+    -> buv::ChangesInBlock {
+    if (!mmappedFile.is_open()) {
+        throw std::runtime_error("file not open");
+    }
+    if (startBlockHeight >= index.size()) {
+        return buv::ChangesInBlock();
+    }
+    return forEachChange(index.frame(mmappedFile, startBlockHeight), mmappedFile.end(), std::move(op));
+}
+
+// Same as above, but reads the frames with pread instead of a mapping, for .blk files that are larger than RAM.
+template <typename Op>
+auto forEachChange(util::PreadStream& stream, Op op) -> buv::ChangesInBlock {
+    // "BLKx" + blockheight + payloadSize
+    static constexpr auto headerSize = size_t(4 + 4 + 4);
 
     auto cib = buv::ChangesInBlock();
-    while (ptr != end) {
-        std::tie(cib, ptr) = buv::ChangesInBlock::decode(std::move(cib), ptr);
+    while (auto const* header = stream.peek(headerSize)) {
+        auto frameSize = static_cast<size_t>(buv::ChangesInBlock::skip(header).second - header);
+        auto const* frame = stream.peek(frameSize);
+        if (frame == nullptr) {
+            throw std::runtime_error(fmt::format("truncated frame at file offset {}", stream.fileOffset()));
+        }
+        cib = buv::ChangesInBlock::decode(std::move(cib), frame).first;
+        stream.consume(frameSize);
         // NOLINTNEXTLINE(bugprone-use-after-move,hicpp-invalid-access-moved)
         if (!op(cib)) {
             return cib;
         }
     }
-
     return cib;
 }
 
+// Pointer to each block's frame, found by skipping over the frames via num_bytes.
+[[nodiscard]] inline auto framePointers(util::Mmap const& mmappedFile) -> std::vector<char const*> {
+    if (!mmappedFile.is_open()) {
+        throw std::runtime_error("file not open");
+    }
+
+    auto frames = std::vector<char const*>();
+    auto const* ptr = mmappedFile.begin();
+    while (ptr != mmappedFile.end()) {
+        frames.push_back(ptr);
+        ptr = buv::ChangesInBlock::skip(ptr).second;
+    }
+    return frames;
+}
+
+// Pointer to each block's frame, directly from the index.
+[[nodiscard]] inline auto framePointers(util::Mmap const& mmappedFile, BlkIndex const& index) -> std::vector<char const*> {
+    if (!mmappedFile.is_open()) {
+        throw std::runtime_error("file not open");
+    }
+
+    auto frames = std::vector<char const*>(index.size());
+    for (size_t blockHeight = 0; blockHeight < frames.size(); ++blockHeight) {
+        frames[blockHeight] = index.frame(mmappedFile, blockHeight);
+    }
+    return frames;
+}
+
+// Same as forEachChange, but blocks are decoded by numWorkers threads, at most numResources blocks ahead of op. op is still
+// called in strict block order on the caller's thread, until it returns false.
+//
+// The ChangesInBlock buffers are reused for later blocks, so op must not keep references to it.
+template <typename Op>
+auto parallelForEachChange(std::vector<char const*> const& frames,
+                           util::ResourceId numResources,
+                           util::ConcurrentWorkers numWorkers,
+                           Op op) -> buv::ChangesInBlock {
+    auto resources = std::vector<buv::ChangesInBlock>(numResources.count());
+    auto isStopped = std::atomic<bool>(false);
+    auto lastResourceId = std::optional<util::ResourceId>();
+
+    util::parallelToSequential(
+        util::SequenceId{frames.size()},
+        numResources,
+        numWorkers,
+        [&](util::ResourceId resourceId, util::SequenceId sequenceId) {
+            // nothing to do any more, just let the remaining sequence run through
+            if (isStopped) {
+                return;
+            }
+            auto& cib = resources[resourceId.count()];
+            cib = buv::ChangesInBlock::decode(std::move(cib), frames[sequenceId.count()]).first;
+        },
+        [&](util::ResourceId resourceId, util::SequenceId /*sequenceId*/) {
+            if (isStopped) {
+                return;
+            }
+            lastResourceId = resourceId;
+            if (!op(resources[resourceId.count()])) {
+                isStopped = true;
+            }
+        });
+
+    if (!lastResourceId) {
+        return buv::ChangesInBlock();
+    }
+    return std::move(resources[lastResourceId->count()]);
+}
+
+// Decodes with all cores, up to 2 blocks per core ahead.
+template <typename Op>
+auto parallelForEachChange(std::vector<char const*> const& frames, Op op) -> buv::ChangesInBlock {
+    auto numWorkers = size_t(std::thread::hardware_concurrency());
+    return parallelForEachChange(frames, util::ResourceId{numWorkers * 2}, util::ConcurrentWorkers{numWorkers}, std::move(op));
+}
+
+// Same as forEachChange, but for a compressed .blk file. Groups are decompressed by numWorkers threads, at most numResources
+// groups ahead of op. op is called in strict block order on the caller's thread, starting at startBlockHeight, until it returns
+// false.
+template <typename Op>
+auto forEachChange(CompressedBlk const& compressedBlk,
+                   uint32_t startBlockHeight,
+                   util::ResourceId numResources,
+                   util::ConcurrentWorkers numWorkers,
+                   Op op) -> buv::ChangesInBlock {
+    if (startBlockHeight >= compressedBlk.numBlocks()) {
+        return buv::ChangesInBlock();
+    }
+
+    auto firstGroup = compressedBlk.groupOf(startBlockHeight);
+    auto resources = std::vector<std::string>(numResources.count());
+    auto isStopped = std::atomic<bool>(false);
+    auto lastCib = buv::ChangesInBlock();
+
+    util::parallelToSequential(
+        util::SequenceId{compressedBlk.groups().size() - firstGroup},
+        numResources,
+        numWorkers,
+        [&](util::ResourceId resourceId, util::SequenceId sequenceId) {
+            if (isStopped) {
+                return;
+            }
+            compressedBlk.decompress(firstGroup + sequenceId.count(), resources[resourceId.count()]);
+        },
+        [&](util::ResourceId resourceId, util::SequenceId sequenceId) {
+            if (isStopped) {
+                return;
+            }
+            auto const& frames = resources[resourceId.count()];
+            auto const* ptr = frames.data();
+
+            // the first group can start before startBlockHeight
+            if (sequenceId.count() == 0) {
+                for (auto h = compressedBlk.groups()[firstGroup].firstBlockHeight; h < startBlockHeight; ++h) {
+                    ptr = buv::ChangesInBlock::skip(ptr).second;
+                }
+            }
+
+            lastCib = forEachChange(ptr, frames.data() + frames.size(), [&](buv::ChangesInBlock const& cib) {
+                if (!op(cib)) {
+                    isStopped = true;
+                }
+                return !isStopped;
+            });
+        });
+
+    return lastCib;
+}
+
+// Decodes with all cores, up to 2 groups per core ahead.
+template <typename Op>
+auto forEachChange(CompressedBlk const& compressedBlk, uint32_t startBlockHeight, Op op) -> buv::ChangesInBlock {
+    auto numWorkers = size_t(std::thread::hardware_concurrency());
+    return forEachChange(
+        compressedBlk, startBlockHeight, util::ResourceId{numWorkers * 2}, util::ConcurrentWorkers{numWorkers}, std::move(op));
+}
+
+// Opens a .blk file, plain or compressed, and calls op for each block from startBlockHeight on. Decodes with all cores, op is
+// called in strict block order on the caller's thread until it returns false.
+template <typename Op>
+auto forEachChangeInFile(std::filesystem::path const& blkFilename, uint32_t startBlockHeight, Op op) -> buv::ChangesInBlock {
+    auto file = util::Mmap(blkFilename);
+    if (CompressedBlk::isCompressed(file)) {
+        return forEachChange(CompressedBlk(blkFilename), startBlockHeight, std::move(op));
+    }
+
+    auto index = loadOrBuildBlkIndex(blkFilename, file);
+    auto frames = framePointers(file, index);
+    frames.erase(frames.begin(), frames.begin() + std::min<size_t>(startBlockHeight, frames.size()));
+    return parallelForEachChange(frames, std::move(op));
+}
+
+// O(1) with the index
+[[nodiscard]] inline auto numBlocks(BlkIndex const& index) -> size_t {
+    return index.size();
+}
+
+// Walks through all frame headers. Prefer the index.
 [[nodiscard]] inline auto numBlocks(util::Mmap const& mmappedFile) -> size_t {
     if (!mmappedFile.is_open()) {
         throw std::runtime_error("file not open");
@@ -0,0 +1,23 @@
+#include <buv/SharedMemoryRing.h>
+#include <buv/SocketStream.h>
+#include <util/args.h>
+#include <util/log.h>
+
+#include <doctest.h>
+
+// Reads what the visualizer writes with "outputSink": "shm", and writes it into a fifo for ffmpeg (see Visualizer.cpp). stdout
+// can't be used, the log is written there.
+//
+// ./buv -ns -tc=shm_reader -shm=/buv -out=/tmp/buv.fifo
+TEST_CASE("shm_reader" * doctest::skip()) {
+    auto reader = buv::SharedMemoryRingReader(util::args::get("-shm").value_or("/buv"));
+    auto out = buv::SocketStream::createFifo(util::args::get("-out").value_or("/tmp/buv.fifo"));
+
+    auto numBytes = size_t();
+    while (reader.read([&](uint8_t const* data, size_t size) {
+        out->write(data, size);
+        numBytes += size;
+    })) {
+    }
+    LOG("writer is gone, {} bytes read", numBytes);
+}
@@ -1,4 +1,6 @@
+#include <app/BlkIndex.h>
 #include <app/BlockEncoder.h>
+#include <app/CompressedBlk.h>
 #include <util/Mmap.h>
 #include <util/log.h>
 
@@ -10,25 +12,26 @@
 TEST_CASE("show_block_changes" * doctest::skip()) {
     auto targetBlockHeight = uint32_t(489849);
 
-    auto mmapedFile = util::Mmap("../../out/blocks/changes.blk1");
+    auto blkFile = std::filesystem::path("../../out/blocks/changes.blk1");
+    auto mmapedFile = util::Mmap(blkFile);
     if (!mmapedFile.is_open()) {
         throw std::runtime_error("could not open");
     }
 
-    // skip forward
-    auto currentBlockHeight = uint32_t(0);
-    auto const* ptr = mmapedFile.begin();
-    while (currentBlockHeight != targetBlockHeight) {
-        std::tie(currentBlockHeight, ptr) = buv::ChangesInBlock::skip(ptr);
+    // jump directly to the block, with the group index for a compressed file
+    auto cib = buv::ChangesInBlock();
+    if (buv::CompressedBlk::isCompressed(mmapedFile)) {
+        cib = buv::CompressedBlk(blkFile).changesAt(targetBlockHeight);
+    } else {
+        auto index = buv::loadOrBuildBlkIndex(blkFile, mmapedFile);
+        cib = buv::ChangesInBlock::decode(index.frame(mmapedFile, targetBlockHeight)).first;
     }
 
-    auto [cib, nextPtr] = buv::ChangesInBlock::decode(ptr);
-
     auto sum = int64_t(0);
     LOG("block {}:", cib.blockData().blockHeight);
     for (auto const& change : cib.changeAtBlockheights()) {
-        sum += std::abs(change.satoshi());
-        LOG("\t{:15.8f} BTC from {}", change.satoshi() / 100'000'000.0, change.blockHeight());
+        sum += std::abs(change.satoshi()) * change.count();
+        LOG("\t{:15.8f} BTC from {} x{}", change.satoshi() / 100'000'000.0, change.blockHeight(), change.count());
     }
     LOG("\t{:15.8f} BTC total changed", sum / 100'000'000.0);
 }
@@ -1,5 +1,8 @@
+#include <app/BlkIndex.h>
+#include <app/BlkWriter.h>
 #include <app/BlockEncoder.h>
 #include <app/Cfg.h>
+#include <app/CompactUtxo.h>
 #include <app/Utxo.h>
 #include <app/fetchAllBlockHeaders.h>
 #include <util/BlockHeightProgressBar.h>
@@ -10,17 +13,22 @@
 #include <util/kbhit.h>
 #include <util/log.h>
 #include <util/parallelToSequential.h>
+#include <util/radixSort.h>
 #include <util/reserve.h>
+#include <util/writeBinary.h>
 #include <util/rss.h>
 
 #include <doctest.h>
 #include <fmt/format.h>
 #include <simdjson.h>
 
+#include <array>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <limits>
 #include <string_view>
+#include <thread>
 
 using namespace std::literals;
 
@@ -93,8 +101,9 @@ struct PreprocessedBlockData {
     }
 
     // make sure all removals vout's are sorted
+    thread_local auto voutScratch = std::vector<uint16_t>();
     for (auto& vouts : pbd.voutsToRemove) {
-        std::sort(vouts.second.begin(), vouts.second.end());
+        util::radixSort(vouts.second, voutScratch);
     }
 
     // this sort is not necessary, but a bit of a performance benefit
@@ -109,11 +118,133 @@ struct ResourceData {
     PreprocessedBlockData preprocessedBlockData{};
 };
 
-} // namespace
+struct SpentVout {
+    buv::TxIdPrefix txIdPrefix{};
+    uint16_t vout{};
+    uint32_t blockHeight{};
+    int64_t satoshi{};
+};
 
-TEST_CASE("utxo_to_change" * doctest::skip()) {
-    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+// Everything that is needed to roll back a block: the utxo changes, and where the block's frame starts in the .blk file.
+struct BlockUndo {
+    uint64_t fileOffset{};
+    std::vector<buv::TxIdPrefix> addedTxids{};
+    std::vector<SpentVout> spentVouts{};
+};
+
+// Integrates the block into the utxo, and adds all removals to the block's changes. When undo is given, everything needed to roll
+// the block back is recorded there.
+template <typename UtxoEngine>
+void applyBlock(UtxoEngine& utxo, PreprocessedBlockData& pbd, BlockUndo* undo) {
+    auto& cib = pbd.cib;
+
+    // all adds (has to be done before the removals!)
+    for (auto const& voutToAdd : pbd.voutsToAdd) {
+        utxo.insert(voutToAdd.txIdPrefix, cib.blockData().blockHeight, voutToAdd.satoshi);
+        if (undo != nullptr) {
+            undo->addedTxids.push_back(voutToAdd.txIdPrefix);
+        }
+    }
+
+    // all removes
+    for (auto const& [txid, vouts] : pbd.voutsToRemove) {
+        auto voutIt = vouts.begin();
+        utxo.removeAllSorted(txid, vouts, [&](int64_t satoshi, uint32_t blockHeight) {
+            if (undo != nullptr) {
+                undo->spentVouts.push_back(SpentVout{txid, *voutIt++, blockHeight, satoshi});
+            }
+            cib.addChange(-satoshi, blockHeight);
+        });
+    }
+    cib.finalizeBlock();
+}
 
+[[nodiscard]] auto undoFilename(std::filesystem::path const& checkpointFile) -> std::filesystem::path {
+    auto filename = checkpointFile;
+    filename += ".undo";
+    return filename;
+}
+
+// Format: "UNDO", blockheight of the last undo, number of undos. Then for each undo: fileOffset, added txids, spent vouts.
+void writeUndos(std::filesystem::path const& filename, uint32_t blockHeight, std::deque<BlockUndo> const& undos) {
+    auto tmpFilename = filename;
+    tmpFilename += ".tmp";
+    {
+        auto fout = std::ofstream(tmpFilename, std::ios::binary);
+        fout.write("UNDO", 4);
+        util::writeBinary<4>(blockHeight, fout);
+        util::writeBinary<8>(undos.size(), fout);
+        for (auto const& undo : undos) {
+            util::writeBinary<8>(undo.fileOffset, fout);
+            util::writeBinary<8>(undo.addedTxids.size(), fout);
+            for (auto const& txid : undo.addedTxids) {
+                util::writeArray<8>(txid, fout);
+            }
+            util::writeBinary<8>(undo.spentVouts.size(), fout);
+            for (auto const& sv : undo.spentVouts) {
+                util::writeArray<8>(sv.txIdPrefix, fout);
+                util::writeBinary<2>(sv.vout, fout);
+                util::writeBinary<4>(sv.blockHeight, fout);
+                util::writeBinary<8>(sv.satoshi, fout);
+            }
+        }
+        if (!fout) {
+            throw std::runtime_error(fmt::format("could not write '{}'", tmpFilename.string()));
+        }
+    }
+    std::filesystem::rename(tmpFilename, filename);
+}
+
+// Returns no undos when the file is missing or doesn't belong to the given blockheight, e.g. when the process was killed between
+// writing the undos and the utxo.
+[[nodiscard]] auto loadUndos(std::filesystem::path const& filename, uint32_t blockHeight) -> std::deque<BlockUndo> {
+    auto undos = std::deque<BlockUndo>();
+    auto fin = std::ifstream(filename, std::ios::binary);
+    auto header = std::array<char, 4>();
+    fin.read(header.data(), header.size());
+    if (!fin || std::string_view(header.data(), header.size()) != "UNDO" || util::readBinary<uint32_t>(fin) != blockHeight) {
+        LOG("'{}' missing or not for block {}, can't roll back blocks before the checkpoint", filename.string(), blockHeight);
+        return undos;
+    }
+
+    auto numUndos = util::readBinary<uint64_t>(fin);
+    for (uint64_t i = 0; i < numUndos && fin; ++i) {
+        auto& undo = undos.emplace_back();
+        undo.fileOffset = util::readBinary<uint64_t>(fin);
+        undo.addedTxids.resize(util::readBinary<uint64_t>(fin));
+        for (auto& txid : undo.addedTxids) {
+            txid = util::readBinary<buv::TxIdPrefix>(fin);
+        }
+        undo.spentVouts.resize(util::readBinary<uint64_t>(fin));
+        for (auto& sv : undo.spentVouts) {
+            sv.txIdPrefix = util::readBinary<buv::TxIdPrefix>(fin);
+            sv.vout = util::readBinary<uint16_t>(fin);
+            sv.blockHeight = util::readBinary<uint32_t>(fin);
+            sv.satoshi = util::readBinary<int64_t>(fin);
+        }
+    }
+    if (!fin) {
+        throw std::runtime_error(fmt::format("'{}' is truncated", filename.string()));
+    }
+    return undos;
+}
+
+// Writes utxo and undos, so utxo_to_change_follow can continue from here. Everything up to blockHeight has to be flushed to the
+// .blk file already.
+void writeCheckpoint(buv::Cfg const& cfg, buv::Utxo const& utxo, std::deque<BlockUndo> const& undos, uint32_t blockHeight) {
+    if (cfg.utxoCheckpointFile.empty()) {
+        return;
+    }
+    writeUndos(undoFilename(cfg.utxoCheckpointFile), blockHeight, undos);
+    buv::serialize(blockHeight, utxo, cfg.utxoCheckpointFile);
+}
+
+// Fetches all blocks, integrates them into the utxo, and writes all changes into blkOut. When undos is given, the undo data of
+// the last cfg.followTipUndoDepth blocks is recorded there, so followTip can roll them back.
+// @return All block headers that were processed
+template <typename UtxoEngine>
+auto utxoToChange(buv::Cfg const& cfg, UtxoEngine& utxo, buv::BlkWriter& blkOut, std::deque<BlockUndo>* undos = nullptr)
+    -> std::vector<buv::BlockHeader> {
     auto cli = util::HttpClient::create(cfg.bitcoinRpcUrl.c_str());
     auto jsonParser = simdjson::dom::parser();
 
@@ -122,9 +253,6 @@ TEST_CASE("utxo_to_change" * doctest::skip()) {
     auto throttler = util::ThrottlePeriodic(200ms);
     // auto utxoDumpThrottler = util::LogThrottler(20s);
 
-    auto fout = std::ofstream(cfg.blkFile, std::ios::binary | std::ios::out);
-    auto utxo = std::make_unique<buv::Utxo>();
-
     auto resources = std::vector<ResourceData>(cfg.utxoToChangeNumResources);
     for (auto& resource : resources) {
         resource.cli = util::HttpClient::create(cfg.bitcoinRpcUrl.c_str());
@@ -164,27 +292,24 @@ TEST_CASE("utxo_to_change" * doctest::skip()) {
             res.preprocessedBlockData = preprocessBlockData(blockData);
             --numActiveWorkers;
         },
-        [&](util::ResourceId resourceId, util::SequenceId /*sequenceId*/) {
+        [&](util::ResourceId resourceId, util::SequenceId sequenceId) {
             // done serially, try to do as little as possible here
             auto& res = resources[resourceId.count()];
             auto& cib = res.preprocessedBlockData.cib;
 
-            // integrate block data: all adds (has to be done before the removals!)
             for (auto const& voutToAdd : res.preprocessedBlockData.voutsToAdd) {
-                auto isSmallUtxoOptimizationUsed =
-                    utxo->insert(voutToAdd.txIdPrefix, cib.blockData().blockHeight, voutToAdd.satoshi);
-
-                ++numSallUtxoOptUsed[isSmallUtxoOptimizationUsed ? 1U : 0U];
+                // same criteria as buv::Utxo's small utxo optimization
+                ++numSallUtxoOptUsed[voutToAdd.satoshi.size() <= 2 ? 1U : 0U];
             }
 
-            // integrate block data: all removes
-            for (auto const& voutToRemove : res.preprocessedBlockData.voutsToRemove) {
-                utxo->removeAllSorted(voutToRemove.first, voutToRemove.second, [&cib](int64_t satoshi, uint32_t blockHeight) {
-                    cib.addChange(-satoshi, blockHeight);
-                });
+            // only the last blocks can be rolled back
+            BlockUndo* undo = nullptr;
+            if (undos != nullptr && sequenceId.count() + cfg.followTipUndoDepth >= allBlockHeaders.size()) {
+                undo = &undos->emplace_back();
+                undo->fileOffset = blkOut.fileOffset();
             }
-            cib.finalizeBlock();
-            fout << cib.encode();
+            applyBlock(utxo, res.preprocessedBlockData, undo);
+            blkOut.write(cib);
 
             numTxProcessed += cib.blockData().nTx;
 
@@ -209,5 +334,165 @@ TEST_CASE("utxo_to_change" * doctest::skip()) {
         });
     pbs = {};
 
+    // checkpoint: everything is on disk before following the tip
+    blkOut.flush();
     LOG("Done!");
+    return allBlockHeaders;
+}
+
+// Keeps the utxo and the .blk file at the tip of the chain. Polls bitcoind for new blocks, and appends each block's changes as
+// soon as it is available. On a reorg, blocks are rolled back with the undo records until the chains match again.
+void followTip(buv::Cfg const& cfg,
+               buv::Utxo& utxo,
+               buv::BlkWriter& blkOut,
+               std::vector<buv::BlockHeader> blockHeaders,
+               std::deque<BlockUndo> undos) {
+    auto cli = util::HttpClient::create(cfg.bitcoinRpcUrl.c_str());
+    auto jsonParser = simdjson::dom::parser();
+
+    // a new checkpoint about once a day
+    static constexpr auto checkpointIntervalBlocks = size_t(144);
+    auto numBlocksSinceCheckpoint = size_t();
+
+    auto hashAtHeight = [&](size_t height) {
+        auto json = cli->get("/rest/blockhashbyheight/{}.json", height);
+        return util::fromHex<32>(jsonParser.parse(json)["blockhash"].get_c_str());
+    };
+
+    auto rollback = [&]() {
+        auto& undo = undos.back();
+
+        // restore in reverse order. Spent vouts first, because they might belong to a transaction added in this block.
+        for (auto it = undo.spentVouts.rbegin(); it != undo.spentVouts.rend(); ++it) {
+            utxo.restore(it->txIdPrefix, it->blockHeight, it->vout, it->satoshi);
+        }
+        for (auto const& txid : undo.addedTxids) {
+            utxo.erase(txid);
+        }
+
+        // cut off the block's frame
+        blkOut.truncate(blockHeaders.size() - 1, undo.fileOffset);
+
+        LOG("rolled back block {} {}", blockHeaders.size() - 1, util::toHex(blockHeaders.back().hash));
+        blockHeaders.pop_back();
+        undos.pop_back();
+    };
+
+    LOG("following tip at block {}, press 'q' to quit", blockHeaders.size() - 1);
+    while (true) {
+        if (util::kbhit() && std::getchar() == 'q') {
+            writeCheckpoint(cfg, utxo, undos, static_cast<uint32_t>(blockHeaders.size() - 1));
+            return;
+        }
+
+        auto chainInfoJson = cli->get("/rest/chaininfo.json");
+        auto chainInfo = jsonParser.parse(chainInfoJson);
+        auto bestHeight = chainInfo["blocks"].get_uint64().value();
+        auto bestHash = util::fromHex<32>(chainInfo["bestblockhash"].get_c_str());
+        if (bestHash == blockHeaders.back().hash) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.followTipPollIntervalMs));
+            continue;
+        }
+
+        // our tip is not part of the best chain any more. Find the fork point, so we know how deep the reorg is.
+        auto tipHeight = blockHeaders.size() - 1;
+        auto forkHeight = std::min<size_t>(tipHeight, bestHeight);
+        while (forkHeight > 0 && hashAtHeight(forkHeight) != blockHeaders[forkHeight].hash) {
+            --forkHeight;
+        }
+        if (forkHeight < tipHeight) {
+            auto depth = tipHeight - forkHeight;
+            if (depth > undos.size()) {
+                throw std::runtime_error(fmt::format("reorg of {} blocks, but only {} can be rolled back", depth, undos.size()));
+            }
+            for (size_t i = 0; i < depth; ++i) {
+                rollback();
+            }
+            continue;
+        }
+
+        auto hash = hashAtHeight(tipHeight + 1);
+        auto jsonData = cli->get("/rest/block/{}.json", util::toHex(hash));
+        simdjson::dom::element blockData = jsonParser.parse(jsonData);
+        if (util::fromHex<32>(blockData["previousblockhash"].get_c_str()) != blockHeaders.back().hash) {
+            // chain changed in the meantime, try again
+            continue;
+        }
+
+        auto pbd = preprocessBlockData(blockData);
+        auto& cib = pbd.cib;
+        auto& undo = undos.emplace_back();
+        undo.fileOffset = blkOut.fileOffset();
+        applyBlock(utxo, pbd, &undo);
+        blkOut.write(cib);
+        blkOut.flush();
+
+        blockHeaders.push_back(buv::BlockHeader{hash, cib.blockData().nTx});
+        if (undos.size() > cfg.followTipUndoDepth) {
+            undos.pop_front();
+        }
+        LOG("block {} {}: {} changes", cib.blockData().blockHeight, util::toHex(hash), cib.numChanges());
+
+        if (++numBlocksSinceCheckpoint == checkpointIntervalBlocks) {
+            writeCheckpoint(cfg, utxo, undos, cib.blockData().blockHeight);
+            numBlocksSinceCheckpoint = 0;
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("utxo_to_change" * doctest::skip()) {
+    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+
+    auto blkOut = buv::BlkWriter(cfg.blkFile, buv::parseBlkFormat(cfg.blkFormat));
+    if (cfg.utxoEngine == "columnar") {
+        auto utxo = std::make_unique<buv::CompactUtxo>(cfg.utxoColumnsDir);
+        utxoToChange(cfg, *utxo, blkOut);
+    } else if (cfg.utxoEngine == "chunked") {
+        auto utxo = std::make_unique<buv::Utxo>();
+        utxoToChange(cfg, *utxo, blkOut);
+    } else {
+        throw std::runtime_error(fmt::format("unknown utxoEngine '{}', use 'chunked' or 'columnar'", cfg.utxoEngine));
+    }
+}
+
+// Same as utxo_to_change, but afterwards keeps running and appends new blocks as they arrive. When utxoCheckpointFile exists, the
+// history pass is skipped: utxo and .blk file continue from the checkpoint, and followTip catches up from there.
+TEST_CASE("utxo_to_change_follow" * doctest::skip()) {
+    auto cfg = buv::parseCfg(util::args::get("-cfg").value());
+    if (cfg.utxoEngine != "chunked") {
+        throw std::runtime_error("following the tip needs undo support, which only the 'chunked' utxoEngine has");
+    }
+
+    if (!cfg.utxoCheckpointFile.empty() && std::filesystem::exists(cfg.utxoCheckpointFile)) {
+        LOG("continuing from checkpoint '{}'", cfg.utxoCheckpointFile);
+        auto [blockHeight, loadedUtxo] = buv::load(cfg.utxoCheckpointFile);
+        auto utxo = std::make_unique<buv::Utxo>(std::move(loadedUtxo));
+        auto undos = loadUndos(undoFilename(cfg.utxoCheckpointFile), blockHeight);
+
+        // read the headers before the writer cuts off everything after the checkpoint
+        auto blockHeaders = std::vector<buv::BlockHeader>();
+        {
+            auto index = buv::BlkIndex(buv::blkIndexFilename(cfg.blkFile));
+            if (index.size() <= blockHeight) {
+                throw std::runtime_error(
+                    fmt::format("'{}' has {} blocks, but the checkpoint is at block {}", cfg.blkFile, index.size(), blockHeight));
+            }
+            for (size_t h = 0; h <= blockHeight; ++h) {
+                auto blockData = index[h].blockData;
+                blockHeaders.push_back(buv::BlockHeader{blockData.hash, blockData.nTx});
+            }
+        }
+        auto blkOut = buv::BlkWriter(cfg.blkFile, buv::parseBlkFormat(cfg.blkFormat), blockHeaders.size());
+        followTip(cfg, *utxo, blkOut, std::move(blockHeaders), std::move(undos));
+        return;
+    }
+
+    auto blkOut = buv::BlkWriter(cfg.blkFile, buv::parseBlkFormat(cfg.blkFormat));
+    auto utxo = std::make_unique<buv::Utxo>();
+    auto undos = std::deque<BlockUndo>();
+    auto blockHeaders = utxoToChange(cfg, *utxo, blkOut, &undos);
+    writeCheckpoint(cfg, *utxo, undos, static_cast<uint32_t>(blockHeaders.size() - 1));
+    followTip(cfg, *utxo, blkOut, std::move(blockHeaders), std::move(undos));
 }
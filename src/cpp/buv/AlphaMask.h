@@ -0,0 +1,123 @@
+#pragma once
+
+#include <app/Cfg.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace buv {
+
+// RGB image to draw into, and the regions that were drawn over
+struct RgbCanvas {
+    uint8_t* rgb = nullptr;
+    size_t width{};
+    size_t height{};
+    std::vector<Rect<size_t>> drawnRects{};
+};
+
+// Coverage of white text or lines. Rasterized once, and then blended into many frames, which is much faster than rasterizing
+// again for each frame.
+//
+// The coverage is stored for each color channel, so blending is a plain loop over bytes that the compiler vectorizes.
+class AlphaMask {
+    // position of the top left pixel, relative to where the mask is drawn
+    int mOffsetX = 0;
+    int mOffsetY = 0;
+    size_t mWidth = 0;
+    size_t mHeight = 0;
+    std::vector<uint8_t> mAlpha{};
+
+public:
+    AlphaMask() = default;
+
+    // Takes width x height coverage values, row by row, where the top left one is at (offsetX, offsetY). Cropped to the pixels
+    // that are covered.
+    AlphaMask(uint8_t const* coverage, size_t width, size_t height, int offsetX, int offsetY) {
+        auto colBegin = width;
+        auto colEnd = size_t();
+        auto rowBegin = height;
+        auto rowEnd = size_t();
+        for (size_t row = 0; row < height; ++row) {
+            for (size_t col = 0; col < width; ++col) {
+                if (coverage[row * width + col] != 0) {
+                    colBegin = std::min(colBegin, col);
+                    colEnd = std::max(colEnd, col + 1);
+                    rowBegin = std::min(rowBegin, row);
+                    rowEnd = row + 1;
+                }
+            }
+        }
+        if (colBegin >= colEnd) {
+            // nothing covered
+            return;
+        }
+
+        mOffsetX = offsetX + static_cast<int>(colBegin);
+        mOffsetY = offsetY + static_cast<int>(rowBegin);
+        mWidth = colEnd - colBegin;
+        mHeight = rowEnd - rowBegin;
+        mAlpha.reserve(mWidth * mHeight * 3);
+        for (auto row = rowBegin; row < rowEnd; ++row) {
+            for (auto col = colBegin; col < colEnd; ++col) {
+                mAlpha.insert(mAlpha.end(), 3, coverage[row * width + col]);
+            }
+        }
+    }
+
+    [[nodiscard]] auto empty() const -> bool {
+        return mAlpha.empty();
+    }
+
+    // Bounding box of the covered pixels, relative to where the mask is drawn
+    [[nodiscard]] auto offsetX() const -> int {
+        return mOffsetX;
+    }
+
+    [[nodiscard]] auto offsetY() const -> int {
+        return mOffsetY;
+    }
+
+    [[nodiscard]] auto width() const -> size_t {
+        return mWidth;
+    }
+
+    [[nodiscard]] auto height() const -> size_t {
+        return mHeight;
+    }
+
+    // Blends white into the canvas at (x, y), clipped to the canvas. Adds the region it has drawn over to canvas.drawnRects.
+    void blendInto(RgbCanvas& canvas, int x, int y) const {
+        auto left = int64_t(x) + mOffsetX;
+        auto top = int64_t(y) + mOffsetY;
+        auto colBegin = std::max<int64_t>(0, -left);
+        auto colEnd = std::min<int64_t>(static_cast<int64_t>(mWidth), static_cast<int64_t>(canvas.width) - left);
+        auto rowBegin = std::max<int64_t>(0, -top);
+        auto rowEnd = std::min<int64_t>(static_cast<int64_t>(mHeight), static_cast<int64_t>(canvas.height) - top);
+        if (colBegin >= colEnd || rowBegin >= rowEnd) {
+            return;
+        }
+
+        auto numBytes = static_cast<size_t>(colEnd - colBegin) * 3;
+        for (auto row = rowBegin; row < rowEnd; ++row) {
+            auto const* alpha = mAlpha.data() + (static_cast<size_t>(row) * mWidth + static_cast<size_t>(colBegin)) * 3;
+            auto* dst = canvas.rgb + (static_cast<size_t>(top + row) * canvas.width + static_cast<size_t>(left + colBegin)) * 3;
+            for (size_t i = 0; i < numBytes; ++i) {
+                dst[i] = blendWhite(dst[i], alpha[i]);
+            }
+        }
+        canvas.drawnRects.push_back({static_cast<size_t>(left + colBegin),
+                                     static_cast<size_t>(top + rowBegin),
+                                     static_cast<size_t>(colEnd - colBegin),
+                                     static_cast<size_t>(rowEnd - rowBegin)});
+    }
+
+    // dst + (255 - dst) * alpha / 255, rounded. The division is exact for all 8 bit values.
+    [[nodiscard]] static auto blendWhite(uint8_t dst, uint8_t alpha) -> uint8_t {
+        auto x = static_cast<uint16_t>((255U - dst) * alpha + 128U);
+        return static_cast<uint8_t>(dst + ((x + (x >> 8U)) >> 8U));
+    }
+};
+
+} // namespace buv
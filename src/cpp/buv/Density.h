@@ -1,5 +1,6 @@
 #pragma once
 
+#include <app/BlockEncoder.h>
 #include <app/Cfg.h>
 #include <buv/ColorMap.h>
 #include <buv/DensityToImage.h>
@@ -7,50 +8,92 @@
 #include <buv/PixelSetWithHistory.h>
 #include <buv/SatoshiBlockheightToPixel.h>
 #include <buv/truncate.h>
+#include <util/ForkJoin.h>
 #include <util/log.h>
+#include <util/radixSort.h>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <thread>
 #include <vector>
 
 namespace buv {
 
 // Integrates change data into an density image.
+//
+// The image is split into horizontal stripes, each processed by its own worker (cfg.densityNumThreads). A stripe owns the
+// density, image, and highlight data of its rows, so the workers never write the same memory. Only the highlight around a
+// changed pixel crosses stripe borders, so each stripe also looks at the changed pixels in the rows directly above and below it.
+//
+// The highlighted pixels are blended into a separate frame, which is what end_block() and fadeOut() show. The frame is kept
+// up to date incrementally: changed and expired pixels are copied from the density image, highlighted pixels are blended with a
+// precomputed table.
+//
+// op() gets the frame itself, so overlays can be drawn directly into it and it can be handed to the output without a copy. The
+// regions that were drawn over must be passed to invalidate(), they are restored from the density image in the next frame.
 class Density {
+    // highlighted pixels fade out within that many blocks
+    static constexpr auto maxHighlightAge = size_t(50);
+
 public:
     explicit Density(Cfg const& cfg, uint32_t numBlocks)
         : mCfg(cfg)
         , mSatoshiBlockheightToPixel(cfg, numBlocks)
         , m_data(cfg.imageWidth * cfg.imageHeight, 0)
         , m_last_data(nullptr)
-        , m_pixel_set_with_history(cfg.imageWidth * cfg.imageHeight, 50)
-        , m_current_block_pixels(cfg.imageWidth * cfg.imageHeight)
         , m_density_to_image(
               cfg.imageWidth, cfg.imageHeight, cfg.colorUpperValueLimit, ColorMap::create(cfg.colorMap), cfg.colorBackgroundRGB)
         , m_current_block_height(0)
         , m_prev_block_height(-1)
-        , m_prev_amount(-1) {
-        LOG("Image {}x{}", cfg.imageWidth, cfg.imageHeight);
+        , m_prev_amount(-1)
+        , mForkJoin(numStripes(cfg))
+        , mStripeRows(stripeRows(cfg)) {
+        LOG("Image {}x{}, {} stripes", cfg.imageWidth, cfg.imageHeight, mForkJoin.numWorkers());
+
+        // exactly one stripe per worker
+        mStripes.reserve(mForkJoin.numWorkers());
+        for (size_t rowBegin = 0; rowBegin < cfg.imageHeight; rowBegin += mStripeRows) {
+            mStripes.emplace_back(rowBegin, std::min(rowBegin + mStripeRows, cfg.imageHeight), cfg.imageWidth);
+        }
+
+        mFrame.assign(m_density_to_image.data(), m_density_to_image.data() + m_density_to_image.size());
+
+        // linear interpolate between colorHighlightRGB (0 age), and original color (maxHighlightAge)
+        mHighlightColors.resize((maxHighlightAge + 1) * 3 * 256);
+        auto const maxAge = static_cast<int>(maxHighlightAge);
+        for (int age = 0; age <= maxAge; ++age) {
+            for (int channel = 0; channel < 3; ++channel) {
+                for (int value = 0; value < 256; ++value) {
+                    auto blended = (value * age + cfg.colorHighlightRGB[channel] * (maxAge - age)) / maxAge;
+                    mHighlightColors[(age * 3 + channel) * 256 + value] = static_cast<uint8_t>(blended);
+                }
+            }
+        }
     }
 
     void begin_block(uint32_t block_height) {
         m_current_block_height = block_height;
     }
 
-    // adds/removes 1 at the correct density. Insert that pixel into m_current_block_pixels for quick processing in end_block.
-    void change(uint32_t block_height, int64_t amount) {
+    // adds/removes count at the correct density. Insert that pixel into the stripe's currentBlockPixels for quick processing in
+    // end_block.
+    void change(uint32_t block_height, int64_t amount, uint32_t count = 1) {
         if (amount == 0) {
             return;
         }
+        // size_t wraps around, so adding the negative count removes it
+        auto delta = static_cast<size_t>(amount >= 0 ? int64_t(count) : -int64_t(count));
         if (amount == m_prev_amount) {
             if (block_height == m_prev_block_height) {
-                *m_last_data += amount >= 0 ? 1 : -1;
+                *m_last_data += delta;
                 return;
             }
         } else {
-            // relatively slow due to std::log
+            // table lookup, see SatoshiBlockheightToPixel
             mPixelY = mSatoshiBlockheightToPixel.satoshiToPixelHeight(amount);
         }
         mPixelX = mSatoshiBlockheightToPixel.blockheightToPixelWidth(block_height);
@@ -61,16 +104,60 @@ public:
             max_pixel_idx = pixel_idx;
         }
         m_last_data = &m_data[pixel_idx];
-        *m_last_data += amount >= 0 ? 1 : -1;
+        *m_last_data += delta;
 
         // integrate density into image
         // m_density_image.update(pixel_idx, pixel);
-        m_current_block_pixels.insert(pixel_idx);
+        stripe(pixel_idx).currentBlockPixels.insert(pixel_idx);
 
         m_prev_amount = amount;
         m_prev_block_height = block_height;
     }
 
+    // Same as begin_block() and change() for each change of the block, but faster for large blocks: all changes are mapped to
+    // pixels in one pass and bucketed by stripe. Then each stripe sorts its changes by pixel, so that the density updates are
+    // close together in memory and each pixel is only updated once.
+    void applyBlock(ChangesInBlock const& cib) {
+        begin_block(cib.blockData().blockHeight);
+
+        for (auto& stripe : mStripes) {
+            stripe.pixelChanges.clear();
+        }
+        cib.changes().forEach([&](int64_t satoshi, uint32_t blockHeight, uint32_t c) {
+            if (satoshi == 0) {
+                // ignored, like in change()
+                return;
+            }
+            auto pixelY = mSatoshiBlockheightToPixel.satoshiToPixelHeight(satoshi);
+            auto pixelX = mSatoshiBlockheightToPixel.blockheightToPixelWidth(blockHeight);
+            auto count = static_cast<int32_t>(c);
+            auto pixelIdx = pixelY * mCfg.imageWidth + pixelX;
+            stripe(pixelIdx).pixelChanges.push_back({static_cast<uint32_t>(pixelIdx), satoshi > 0 ? count : -count});
+        });
+
+        mForkJoin.run([&](size_t stripeIdx) {
+            auto& stripe = mStripes[stripeIdx];
+            auto pixelBegin = static_cast<uint32_t>(stripe.rowBegin * mCfg.imageWidth);
+            auto numKeyBits = util::radixKeyBits((stripe.rowEnd - stripe.rowBegin) * mCfg.imageWidth - 1);
+            util::radixSort(stripe.pixelChanges, stripe.pixelChangesScratch, numKeyBits, [pixelBegin](PixelChange const& pc) {
+                return pc.pixelIdx - pixelBegin;
+            });
+
+            auto const& pixelChanges = stripe.pixelChanges;
+            for (size_t i = 0; i < pixelChanges.size();) {
+                auto pixelIdx = pixelChanges[i].pixelIdx;
+                auto delta = int64_t();
+                for (; i < pixelChanges.size() && pixelChanges[i].pixelIdx == pixelIdx; ++i) {
+                    delta += pixelChanges[i].delta;
+                }
+
+                // size_t wraps around, so adding the negative delta removes it
+                m_data[pixelIdx] += static_cast<size_t>(delta);
+                stripe.currentBlockPixels.insert(pixelIdx);
+            }
+        });
+    }
+
     template <typename Op>
     void end_block(uint32_t block_height, Op op) {
         if (block_height < mCfg.startShowAtBlockHeight) {
@@ -81,56 +168,22 @@ public:
             return;
         }
 
-        // update only the colors of the pixels that actually need updating
-        for (auto const pixel_idx : m_current_block_pixels) {
-            m_density_to_image.update(pixel_idx, m_data[pixel_idx]);
-        }
-
-        for (auto const pixel_idx : m_current_block_pixels) {
-            size_t const y = pixel_idx / mCfg.imageWidth;
-            size_t const x = pixel_idx - y * mCfg.imageWidth;
-
-            if (m_current_block_height >= 15) {
-                // upper row
-                if (x > 0) {
-                    if (y > 0) {
-                        m_pixel_set_with_history.insert(m_current_block_height - 15, (y - 1) * mCfg.imageWidth + (x - 1));
-                    }
-                    m_pixel_set_with_history.insert(m_current_block_height - 7, (y + 0) * mCfg.imageWidth + (x - 1));
-                    if (y + 1 < mCfg.imageHeight) {
-                        m_pixel_set_with_history.insert(m_current_block_height - 15, (y + 1) * mCfg.imageWidth + (x - 1));
-                    }
-                }
+        mForkJoin.run([&](size_t stripeIdx) {
+            updateStripe(stripeIdx);
+        });
 
-                // middle row
-                if (y > 0) {
-                    m_pixel_set_with_history.insert(m_current_block_height - 7, (y - 1) * mCfg.imageWidth + (x + 0));
-                }
-                m_pixel_set_with_history.insert(m_current_block_height, pixel_idx);
-                if (y + 1 < mCfg.imageHeight) {
-                    m_pixel_set_with_history.insert(m_current_block_height - 7, (y + 1) * mCfg.imageWidth + (x + 0));
-                }
+        fadeOut(block_height, op, true);
+    }
 
-                // lower row
-                if (x + 1 < mCfg.imageWidth) {
-                    if (y > 0) {
-                        m_pixel_set_with_history.insert(m_current_block_height - 15, (y - 1) * mCfg.imageWidth + (x + 1));
-                    }
-                    m_pixel_set_with_history.insert(m_current_block_height - 7, (y + 0) * mCfg.imageWidth + (x + 1));
-                    if (y + 1 < mCfg.imageHeight) {
-                        m_pixel_set_with_history.insert(m_current_block_height - 15, (y + 1) * mCfg.imageWidth + (x + 1));
-                    }
-                }
-            }
+    // The region of the frame was drawn over, it is restored in the next frame. Rows and columns outside the image are ignored.
+    void invalidate(Rect<size_t> const& rect) {
+        auto x = std::min(rect.x, mCfg.imageWidth);
+        auto y = std::min(rect.y, mCfg.imageHeight);
+        auto w = std::min(rect.w, mCfg.imageWidth - x);
+        auto h = std::min(rect.h, mCfg.imageHeight - y);
+        if (w != 0 && h != 0) {
+            mInvalidRects.push_back({x, y, w, h});
         }
-
-        fadeOut(block_height, op);
-
-        // save_image_ppm(toi, fname);
-        // m_pixel_set.clear();
-        //}
-
-        m_current_block_pixels.clear();
     }
 
     // saves current status of the image as a PPM file
@@ -142,43 +195,16 @@ public:
 
     template <typename Op>
     void fadeOut(uint32_t block_height, Op op) {
-        // remove all pixels older than max age
-        m_pixel_set_with_history.age(block_height);
-
-        // temporarily set all updated pixels to white
-        std::vector<uint8_t> previous_rgb_values(3 * m_pixel_set_with_history.size());
-        auto* rgb_data = previous_rgb_values.data();
-
-        for (auto const& blockheight_pixelidx : m_pixel_set_with_history) {
-            auto* rgb = m_density_to_image.rgb(blockheight_pixelidx.pixel_idx);
-
-            rgb_data[0] = rgb[0];
-            rgb_data[1] = rgb[1];
-            rgb_data[2] = rgb[2];
-            rgb_data += 3;
-            int const age = block_height - blockheight_pixelidx.block_height;
-
-            int const max_hist = static_cast<int>(m_pixel_set_with_history.max_history());
-
-            // linear interpolate between colorHighlightRGB (0 age), and original color (max_hist age)
-            rgb[0] = (rgb[0] * age + mCfg.colorHighlightRGB[0] * (max_hist - age)) / max_hist;
-            rgb[1] = (rgb[1] * age + mCfg.colorHighlightRGB[1] * (max_hist - age)) / max_hist;
-            rgb[2] = (rgb[2] * age + mCfg.colorHighlightRGB[2] * (max_hist - age)) / max_hist;
-        }
-        op(m_density_to_image.data());
-
-        // now re-update all the updated pixels that have changed since the last update
-        rgb_data = previous_rgb_values.data();
-        for (auto const& blockheight_pixelidx : m_pixel_set_with_history) {
-            m_density_to_image.rgb(blockheight_pixelidx.pixel_idx, rgb_data);
-            rgb_data += 3;
-        }
+        fadeOut(block_height, op, false);
     }
 
     ~Density() {
         // sort & print pixel densities
         m_data.erase(std::remove(m_data.begin(), m_data.end(), 0), m_data.end());
         std::sort(m_data.begin(), m_data.end());
+        if (m_data.empty()) {
+            return;
+        }
 
         // print 100 values
         LOG("100 density values, starting from 0 (min) to max", m_data.size());
@@ -189,19 +215,164 @@ public:
     }
 
 private:
+    struct PixelChange {
+        uint32_t pixelIdx{};
+        int32_t delta{};
+    };
+
+    // the rows [rowBegin, rowEnd) of the image
+    struct Stripe {
+        size_t rowBegin{};
+        size_t rowEnd{};
+        PixelSet currentBlockPixels;
+        PixelSetWithHistory pixelSetWithHistory;
+
+        // reused across blocks
+        std::vector<PixelChange> pixelChanges{};
+        std::vector<PixelChange> pixelChangesScratch{};
+
+        Stripe(size_t rowBegin_, size_t rowEnd_, size_t width)
+            : rowBegin(rowBegin_)
+            , rowEnd(rowEnd_)
+            , currentBlockPixels((rowEnd_ - rowBegin_) * width, rowBegin_ * width)
+            , pixelSetWithHistory((rowEnd_ - rowBegin_) * width, maxHighlightAge, rowBegin_ * width) {}
+    };
+
+    // rows per stripe, so that there is one stripe per thread. At least one row per stripe.
+    [[nodiscard]] static auto stripeRows(Cfg const& cfg) -> size_t {
+        auto numThreads = cfg.densityNumThreads == 0 ? size_t(std::thread::hardware_concurrency()) : cfg.densityNumThreads;
+        numThreads = std::max<size_t>(numThreads, 1);
+        return std::max<size_t>((cfg.imageHeight + numThreads - 1) / numThreads, 1);
+    }
+
+    [[nodiscard]] static auto numStripes(Cfg const& cfg) -> size_t {
+        return (cfg.imageHeight + stripeRows(cfg) - 1) / stripeRows(cfg);
+    }
+
+    [[nodiscard]] auto stripe(size_t pixel_idx) -> Stripe& {
+        return mStripes[pixel_idx / (mStripeRows * mCfg.imageWidth)];
+    }
+
+    // Updates the colors of the stripe's changed pixels, and highlights the neighbourhood of all changed pixels that are in the
+    // stripe or directly above or below it.
+    void updateStripe(size_t stripeIdx) {
+        auto& stripe = mStripes[stripeIdx];
+        for (auto const pixel_idx : stripe.currentBlockPixels) {
+            m_density_to_image.update(pixel_idx, m_data[pixel_idx]);
+            copyToFrame(pixel_idx);
+        }
+
+        if (m_current_block_height < 15) {
+            return;
+        }
+        for (auto const pixel_idx : stripe.currentBlockPixels) {
+            highlightNeighbourhood(stripe, pixel_idx);
+        }
+
+        // only reads the other stripe's changed pixels, which don't change in this phase
+        auto highlightFromRow = [&](Stripe const& other, size_t y) {
+            for (size_t x = 0; x < mCfg.imageWidth; ++x) {
+                if (other.currentBlockPixels.contains(y * mCfg.imageWidth + x)) {
+                    highlightNeighbourhood(stripe, y * mCfg.imageWidth + x);
+                }
+            }
+        };
+        if (stripeIdx > 0) {
+            highlightFromRow(mStripes[stripeIdx - 1], stripe.rowBegin - 1);
+        }
+        if (stripeIdx + 1 < mStripes.size()) {
+            highlightFromRow(mStripes[stripeIdx + 1], stripe.rowEnd);
+        }
+    }
+
+    // Highlights the 3x3 pixels around pixel_idx, but only those that are in the stripe. Diagonal neighbours fade out first.
+    void highlightNeighbourhood(Stripe& stripe, size_t pixel_idx) {
+        static constexpr auto ages = std::array<std::array<uint32_t, 3>, 3>{{{15, 7, 15}, {7, 0, 7}, {15, 7, 15}}};
+
+        size_t const y = pixel_idx / mCfg.imageWidth;
+        size_t const x = pixel_idx - y * mCfg.imageWidth;
+        for (size_t ny = std::max(y, stripe.rowBegin + 1) - 1; ny <= y + 1 && ny < stripe.rowEnd; ++ny) {
+            for (size_t nx = std::max<size_t>(x, 1) - 1; nx <= x + 1 && nx < mCfg.imageWidth; ++nx) {
+                auto age = ages[ny + 1 - y][nx + 1 - x];
+                stripe.pixelSetWithHistory.insert(m_current_block_height - age, ny * mCfg.imageWidth + nx);
+            }
+        }
+    }
+
+    void copyToFrame(size_t pixel_idx) {
+        auto const* rgb = m_density_to_image.rgb(pixel_idx);
+        auto* frame = mFrame.data() + pixel_idx * 3;
+        frame[0] = rgb[0];
+        frame[1] = rgb[1];
+        frame[2] = rgb[2];
+    }
+
+    // Copies the stripe's part of the invalidated regions from the density image. Highlighted pixels are blended again after
+    // that, as always.
+    void restoreInvalidRects(Stripe const& stripe) {
+        for (auto const& rect : mInvalidRects) {
+            auto rowBegin = std::max(rect.y, stripe.rowBegin);
+            auto rowEnd = std::min(rect.y + rect.h, stripe.rowEnd);
+            for (auto y = rowBegin; y < rowEnd; ++y) {
+                auto offset = (y * mCfg.imageWidth + rect.x) * 3;
+                std::copy_n(m_density_to_image.data() + offset, rect.w * 3, mFrame.data() + offset);
+            }
+        }
+    }
+
+    // the currently changed pixels are cleared after they were shown
+    template <typename Op>
+    void fadeOut(uint32_t block_height, Op op, bool clearCurrentBlockPixels) {
+        mForkJoin.run([&](size_t stripeIdx) {
+            auto& stripe = mStripes[stripeIdx];
+            restoreInvalidRects(stripe);
+
+            // remove all pixels older than max age, they get their original color back
+            stripe.pixelSetWithHistory.age(block_height, [&](size_t pixel_idx) {
+                copyToFrame(pixel_idx);
+            });
+
+            stripe.pixelSetWithHistory.forEach([&](uint32_t pixel_block_height, size_t pixel_idx) {
+                auto const* colors = mHighlightColors.data() + (block_height - pixel_block_height) * 3 * 256;
+                auto const* rgb = m_density_to_image.rgb(pixel_idx);
+                auto* frame = mFrame.data() + pixel_idx * 3;
+                frame[0] = colors[rgb[0]];
+                frame[1] = colors[256 + rgb[1]];
+                frame[2] = colors[512 + rgb[2]];
+            });
+            if (clearCurrentBlockPixels) {
+                stripe.currentBlockPixels.clear();
+            }
+        });
+        mInvalidRects.clear();
+
+        op(mFrame.data());
+    }
+
     Cfg const mCfg;
     SatoshiBlockheightToPixel mSatoshiBlockheightToPixel;
     std::vector<size_t> m_data;
     size_t* m_last_data;
     size_t mPixelX{};
     size_t mPixelY{};
-    PixelSetWithHistory m_pixel_set_with_history;
-    PixelSet m_current_block_pixels;
     DensityToImage m_density_to_image;
     uint32_t m_current_block_height;
 
     uint32_t m_prev_block_height;
     int64_t m_prev_amount;
+
+    util::ForkJoin mForkJoin;
+    size_t mStripeRows{};
+    std::vector<Stripe> mStripes{};
+
+    // the density image with the highlights
+    std::vector<uint8_t> mFrame{};
+
+    // regions of mFrame that were drawn over since the last frame, see invalidate()
+    std::vector<Rect<size_t>> mInvalidRects{};
+
+    // mHighlightColors[(age * 3 + channel) * 256 + value] is the highlighted color value
+    std::vector<uint8_t> mHighlightColors{};
 };
 
 } // namespace buv
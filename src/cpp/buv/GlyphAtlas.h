@@ -0,0 +1,80 @@
+#pragma once
+
+#include <buv/AlphaMask.h>
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <utility>
+
+namespace buv {
+
+// Alpha masks of the printable ASCII characters, so text that changes each frame can be drawn by blending the characters instead
+// of rasterizing the font. Characters without a glyph are skipped.
+class GlyphAtlas {
+    std::array<AlphaMask, 128> mGlyphs{};
+    std::array<int, 128> mAdvances{};
+
+public:
+    // mask is relative to the glyph's origin, the left end of the baseline. advance is the distance to the next glyph's origin.
+    void set(char ch, AlphaMask mask, int advance) {
+        auto idx = static_cast<unsigned char>(ch) & 127U;
+        mGlyphs[idx] = std::move(mask);
+        mAdvances[idx] = advance;
+    }
+
+    [[nodiscard]] auto advance(char ch) const -> int {
+        return mAdvances[static_cast<unsigned char>(ch) & 127U];
+    }
+
+    [[nodiscard]] auto textWidth(std::string_view text) const -> int {
+        auto width = 0;
+        for (auto ch : text) {
+            width += advance(ch);
+        }
+        return width;
+    }
+
+    // Draws text with its baseline starting at (x, y). Adds one region for the whole text to canvas.drawnRects.
+    void draw(RgbCanvas& canvas, int x, int y, std::string_view text) const {
+        auto numRects = canvas.drawnRects.size();
+        for (auto ch : text) {
+            mGlyphs[static_cast<unsigned char>(ch) & 127U].blendInto(canvas, x, y);
+            x += advance(ch);
+        }
+        mergeRects(canvas, numRects);
+    }
+
+    // Same as draw(), but each character is centered in a cell of cellWidth pixels
+    void drawMono(RgbCanvas& canvas, int x, int y, std::string_view text, int cellWidth) const {
+        auto numRects = canvas.drawnRects.size();
+        for (auto ch : text) {
+            mGlyphs[static_cast<unsigned char>(ch) & 127U].blendInto(canvas, x + (cellWidth - advance(ch)) / 2, y);
+            x += cellWidth;
+        }
+        mergeRects(canvas, numRects);
+    }
+
+private:
+    // replaces the rects starting at numRects with their bounding box
+    static void mergeRects(RgbCanvas& canvas, size_t numRects) {
+        auto& rects = canvas.drawnRects;
+        if (rects.size() <= numRects + 1) {
+            return;
+        }
+        auto x0 = rects[numRects].x;
+        auto y0 = rects[numRects].y;
+        auto x1 = rects[numRects].x + rects[numRects].w;
+        auto y1 = rects[numRects].y + rects[numRects].h;
+        for (auto i = numRects + 1; i < rects.size(); ++i) {
+            x0 = std::min(x0, rects[i].x);
+            y0 = std::min(y0, rects[i].y);
+            x1 = std::max(x1, rects[i].x + rects[i].w);
+            y1 = std::max(y1, rects[i].y + rects[i].h);
+        }
+        rects.resize(numRects);
+        rects.push_back({x0, y0, x1 - x0, y1 - y0});
+    }
+};
+
+} // namespace buv
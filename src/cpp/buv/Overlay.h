@@ -0,0 +1,179 @@
+#pragma once
+
+#include <app/Cfg.h>
+#include <buv/AlphaMask.h>
+#include <buv/GlyphAtlas.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace buv {
+
+// Draws masks and text into frames, e.g. for the HUD. All items are added for each frame, then draw() draws them.
+//
+// Only the frame's changingArea is updated between frames, everything else stays background. So items that are completely
+// outside of it stay in the frame as long as they are added the same way again: they are neither restored nor drawn again. When
+// they change or go away, the overlay fills their region with the background itself. Items that touch the changingArea are drawn
+// in each frame, and drawnRects() tells the caller which regions to restore before the next frame.
+class Overlay {
+    struct Item {
+        AlphaMask const* mask = nullptr;
+        std::string text{};
+        int cellWidth = 0; // 0 for proportional text
+        int x{};
+        int y{};
+
+        // set by draw()
+        Rect<size_t> rect{};
+        bool isKept = false;
+
+        [[nodiscard]] auto isSame(Item const& other) const -> bool {
+            return mask == other.mask && x == other.x && y == other.y && cellWidth == other.cellWidth && text == other.text;
+        }
+    };
+
+    GlyphAtlas const& mGlyphAtlas;
+    Rect<size_t> mChangingArea{};
+    std::array<uint8_t, 3> mBackground{};
+    RgbCanvas mCanvas{};
+
+    std::vector<Item> mItems{};
+
+    // items of the last frame that are still in the frame
+    std::vector<Item> mRetainedItems{};
+    std::vector<bool> mIsRetainedItemUsed{};
+
+public:
+    Overlay(GlyphAtlas const& glyphAtlas, Rect<size_t> changingArea, std::array<uint8_t, 3> background)
+        : mGlyphAtlas(glyphAtlas)
+        , mChangingArea(changingArea)
+        , mBackground(background) {}
+
+    // The mask must live as long as the overlay
+    void mask(AlphaMask const& mask, int x, int y) {
+        mItems.push_back(Item{&mask, {}, 0, x, y, {}, false});
+    }
+
+    // text with its baseline starting at (x, y), see GlyphAtlas::draw()
+    void text(int x, int y, std::string_view text) {
+        mItems.push_back(Item{nullptr, std::string(text), 0, x, y, {}, false});
+    }
+
+    // see GlyphAtlas::drawMono()
+    void textMono(int x, int y, std::string_view text, int cellWidth) {
+        mItems.push_back(Item{nullptr, std::string(text), cellWidth, x, y, {}, false});
+    }
+
+    // Draws all items added since the last draw() into the width x height RGB image. The regions of drawnRects() of the last
+    // frame have to be restored before.
+    void draw(uint8_t* rgb, size_t width, size_t height) {
+        mCanvas.rgb = rgb;
+        mCanvas.width = width;
+        mCanvas.height = height;
+
+        // restored by the caller, which can overwrite retained items too
+        auto erasedRects = std::move(mCanvas.drawnRects);
+        mCanvas.drawnRects.clear();
+
+        mIsRetainedItemUsed.assign(mRetainedItems.size(), false);
+        for (auto& item : mItems) {
+            for (size_t i = 0; i < mRetainedItems.size(); ++i) {
+                if (!mIsRetainedItemUsed[i] && item.isSame(mRetainedItems[i])) {
+                    mIsRetainedItemUsed[i] = true;
+                    item.rect = mRetainedItems[i].rect;
+                    item.isKept = true;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < mRetainedItems.size(); ++i) {
+            if (!mIsRetainedItemUsed[i]) {
+                erase(mRetainedItems[i].rect, erasedRects);
+            }
+        }
+
+        // kept items that were partly erased have to be drawn again, so they are erased completely. Which can hit more items.
+        auto isErasing = true;
+        while (isErasing) {
+            isErasing = false;
+            for (auto& item : mItems) {
+                if (item.isKept && intersectsAny(item.rect, erasedRects)) {
+                    item.isKept = false;
+                    erase(item.rect, erasedRects);
+                    isErasing = true;
+                }
+            }
+        }
+
+        mRetainedItems.clear();
+        for (auto& item : mItems) {
+            if (!item.isKept) {
+                drawItem(item);
+            }
+            if (item.isKept || !intersects(item.rect, mChangingArea)) {
+                mRetainedItems.push_back(std::move(item));
+            }
+        }
+        mItems.clear();
+    }
+
+    // Regions of the changing area that the last draw() has drawn over, clipped to the image.
+    [[nodiscard]] auto drawnRects() const -> std::vector<Rect<size_t>> const& {
+        return mCanvas.drawnRects;
+    }
+
+private:
+    // Sets item.rect. Only reports it in drawnRects when it touches the changing area.
+    void drawItem(Item& item) {
+        auto numRects = mCanvas.drawnRects.size();
+        if (item.mask != nullptr) {
+            item.mask->blendInto(mCanvas, item.x, item.y);
+        } else if (item.cellWidth == 0) {
+            mGlyphAtlas.draw(mCanvas, item.x, item.y, item.text);
+        } else {
+            mGlyphAtlas.drawMono(mCanvas, item.x, item.y, item.text, item.cellWidth);
+        }
+
+        // at most one rect per item
+        item.rect = {};
+        if (mCanvas.drawnRects.size() > numRects) {
+            item.rect = mCanvas.drawnRects.back();
+            if (!intersects(item.rect, mChangingArea)) {
+                mCanvas.drawnRects.pop_back();
+            }
+        }
+    }
+
+    // Fills the rect with background. Only used outside of the changing area.
+    void erase(Rect<size_t> const& rect, std::vector<Rect<size_t>>& erasedRects) {
+        for (auto y = rect.y; y < rect.y + rect.h; ++y) {
+            auto* dst = mCanvas.rgb + (y * mCanvas.width + rect.x) * 3;
+            for (size_t x = 0; x < rect.w; ++x) {
+                dst[x * 3] = mBackground[0];
+                dst[x * 3 + 1] = mBackground[1];
+                dst[x * 3 + 2] = mBackground[2];
+            }
+        }
+        erasedRects.push_back(rect);
+    }
+
+    [[nodiscard]] static auto intersects(Rect<size_t> const& a, Rect<size_t> const& b) -> bool {
+        return a.w != 0 && a.h != 0 && b.w != 0 && b.h != 0 && a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+               b.y < a.y + a.h;
+    }
+
+    [[nodiscard]] static auto intersectsAny(Rect<size_t> const& rect, std::vector<Rect<size_t>> const& rects) -> bool {
+        for (auto const& other : rects) {
+            if (intersects(rect, other)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace buv
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <vector>
 
 namespace buv {
@@ -9,36 +11,57 @@ namespace buv {
 //
 // Quick O(1) to set a pixel
 // Quick O(n) to iterate all set n pixel.
-// Quick O(n) to clear all set pixels.
+// Quick O(1) to clear all set pixels: each pixel is stamped with the epoch it was inserted in, and clear() starts a new
+// epoch. Only when the 8 bit epoch wraps around, all stamps are reset.
+//
+// Can be restricted to the pixels [offset, offset + size), e.g. for a stripe of the image.
 class PixelSet {
-    std::vector<uint8_t> mPixel{};
-    std::vector<size_t> mPixelidx{};
+    std::vector<uint8_t> mEpochs{};
+    std::vector<uint32_t> mPixelidx{};
+    size_t mOffset{};
+    uint8_t mEpoch = 1;
 
 public:
-    explicit PixelSet(size_t size)
-        : mPixel(size, 0) {}
+    explicit PixelSet(size_t size, size_t offset = 0)
+        : mEpochs(size, 0)
+        , mOffset(offset) {}
 
-    // Assumes that idx < size. O(1) operation.
+    // Assumes that offset <= idx < offset + size. O(1) operation.
     void insert(size_t pixel_idx) {
-        if (mPixel[pixel_idx] != 0U) {
+        auto& epoch = mEpochs[pixel_idx - mOffset];
+        if (epoch == mEpoch) {
             return;
         }
-        mPixel[pixel_idx] = 1;
-        mPixelidx.push_back(pixel_idx);
+        epoch = mEpoch;
+        mPixelidx.push_back(static_cast<uint32_t>(pixel_idx));
+    }
+
+    // Assumes that offset <= idx < offset + size. O(1) operation.
+    [[nodiscard]] auto contains(size_t pixel_idx) const -> bool {
+        return mEpochs[pixel_idx - mOffset] == mEpoch;
     }
 
-    [[nodiscard]] auto begin() const -> std::vector<size_t>::const_iterator {
+    [[nodiscard]] auto begin() const -> std::vector<uint32_t>::const_iterator {
         return mPixelidx.begin();
     }
 
-    [[nodiscard]] auto end() const -> std::vector<size_t>::const_iterator {
+    [[nodiscard]] auto end() const -> std::vector<uint32_t>::const_iterator {
         return mPixelidx.end();
     }
 
+    [[nodiscard]] auto size() const -> size_t {
+        return mPixelidx.size();
+    }
+
     void clear() {
-        std::fill(mPixel.begin(), mPixel.end(), 0);
         mPixelidx.clear();
+        if (mEpoch == std::numeric_limits<uint8_t>::max()) {
+            // 0 is never used as an epoch, so no pixel is in the set after the reset
+            std::fill(mEpochs.begin(), mEpochs.end(), 0);
+            mEpoch = 0;
+        }
+        ++mEpoch;
     }
 };
 
-} // namespace buv
\ No newline at end of file
+} // namespace buv
@@ -1,78 +1,133 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <limits>
 #include <vector>
 
 namespace buv {
 
-// Basically a set for pixels. Fast if the number of changed pixels is small.
+// Basically a set for pixels, where each pixel has the blockheight at which it was last inserted. Fast if the number of changed
+// pixels is small.
 //
 // Quick O(1) to set a pixel
 // Quick O(n) to iterate all set n pixel.
-// Quick O(n) to clear all set pixels.
+// age() only touches the pixels that expire: the entries are kept in a ring of buckets by blockheight, so age() only needs to
+// look at the buckets of the expired blockheights. When a pixel is inserted again with a newer blockheight, it gets a new entry
+// and the old one stays in its bucket until that expires.
+//
+// Can be restricted to the pixels [offset, offset + size), e.g. for a stripe of the image.
 class PixelSetWithHistory {
-public:
-    struct BlockheightPixelidx {
+    static constexpr auto absent = std::numeric_limits<uint32_t>::max();
+
+    struct Entry {
+        uint32_t pixel_idx{};
         uint32_t block_height{};
-        size_t pixel_idx{};
     };
-    using BlockheightPixelCollection = std::vector<BlockheightPixelidx>;
 
-    PixelSetWithHistory(size_t size, size_t max_history)
+    struct Bucket {
+        std::vector<Entry> entries{};
+
+        // smallest blockheight in entries. Usually all have the same blockheight, unless the ring wrapped around.
+        uint32_t min_block_height = absent;
+    };
+
+public:
+    PixelSetWithHistory(size_t size, size_t max_history, size_t offset = 0)
         : m_max_history(max_history)
-        , m_pixel(size, sentinel) {}
+        , m_block_height(size, absent)
+        , mOffset(offset) {
+        // enough buckets so that all blockheights that are alive at once (plus the highlight offsets) get their own bucket
+        auto numBuckets = size_t(1);
+        while (numBuckets < max_history + 32) {
+            numBuckets *= 2;
+        }
+        mBuckets.resize(numBuckets);
+    }
 
-    // Assumes that idx < size. O(1) operation.
+    // Assumes that offset <= idx < offset + size. O(1) operation.
     void insert(uint32_t block_height, size_t pixel_idx) {
-        if (sentinel == m_pixel[pixel_idx]) {
-            // not set: create entry
-            m_pixel[pixel_idx] = m_blockheight_pixelidx.size();
-            m_blockheight_pixelidx.emplace_back(BlockheightPixelidx{block_height, pixel_idx});
-        } else {
-            // pixel already set: update it with the max
-            auto& pos = m_blockheight_pixelidx[m_pixel[pixel_idx]];
-            if (block_height > pos.block_height) {
-                pos.block_height = block_height;
+        auto& stored = m_block_height[pixel_idx - mOffset];
+        if (stored != absent) {
+            if (block_height <= stored) {
+                // pixel already set: keep the max
+                return;
             }
+        } else {
+            ++mSize;
         }
+        stored = block_height;
+
+        auto& bucket = mBuckets[block_height & (mBuckets.size() - 1)];
+        bucket.entries.push_back(Entry{static_cast<uint32_t>(pixel_idx), block_height});
+        bucket.min_block_height = std::min(bucket.min_block_height, block_height);
     }
 
     // remove all pixels older than max age
     void age(uint32_t const current_block_height) {
-        size_t idx = m_blockheight_pixelidx.size();
-        while (0U != idx--) {
-            auto& pos_at_idx = m_blockheight_pixelidx[idx];
-            if (pos_at_idx.block_height + m_max_history < current_block_height) {
-                // clear that pixel
-                m_pixel[pos_at_idx.pixel_idx] = sentinel;
-
-                // move last entry to the now vacant position (if we are not at the end)
-                if (idx != m_blockheight_pixelidx.size() - 1) {
-                    pos_at_idx = m_blockheight_pixelidx.back();
-                    m_pixel[pos_at_idx.pixel_idx] = idx;
-                }
+        age(current_block_height, [](size_t /*pixel_idx*/) {});
+    }
+
+    // remove all pixels older than max age, and call onExpired(pixel_idx) for each of them
+    template <typename Op>
+    void age(uint32_t const current_block_height, Op onExpired) {
+        if (current_block_height <= m_max_history) {
+            return;
+        }
 
-                // get rid of moved entry
-                m_blockheight_pixelidx.pop_back();
+        // same as block_height + m_max_history < current_block_height
+        auto const min_alive = static_cast<uint32_t>(current_block_height - m_max_history);
+        for (auto& bucket : mBuckets) {
+            if (bucket.min_block_height >= min_alive) {
+                continue;
+            }
+            auto newMin = absent;
+            auto numKept = size_t();
+            for (auto const& entry : bucket.entries) {
+                auto& stored = m_block_height[entry.pixel_idx - mOffset];
+                if (stored != entry.block_height) {
+                    // outdated entry, the pixel has a newer one in another bucket
+                    continue;
+                }
+                if (entry.block_height < min_alive) {
+                    stored = absent;
+                    --mSize;
+                    onExpired(entry.pixel_idx);
+                    continue;
+                }
+                bucket.entries[numKept++] = entry;
+                newMin = std::min(newMin, entry.block_height);
             }
+            bucket.entries.resize(numKept);
+            bucket.min_block_height = newMin;
         }
     }
 
-    [[nodiscard]] auto begin() const -> BlockheightPixelCollection::const_iterator {
-        return m_blockheight_pixelidx.begin();
-    }
-    [[nodiscard]] auto end() const -> BlockheightPixelCollection::const_iterator {
-        return m_blockheight_pixelidx.end();
+    // calls op(block_height, pixel_idx) for each pixel in the set
+    template <typename Op>
+    void forEach(Op op) const {
+        for (auto const& bucket : mBuckets) {
+            for (auto const& entry : bucket.entries) {
+                if (m_block_height[entry.pixel_idx - mOffset] == entry.block_height) {
+                    op(entry.block_height, entry.pixel_idx);
+                }
+            }
+        }
     }
 
     [[nodiscard]] auto size() const -> size_t {
-        return m_blockheight_pixelidx.size();
+        return mSize;
     }
 
     void clear() {
-        std::fill(m_pixel.begin(), m_pixel.end(), sentinel);
-        m_blockheight_pixelidx.clear();
+        for (auto& bucket : mBuckets) {
+            for (auto const& entry : bucket.entries) {
+                m_block_height[entry.pixel_idx - mOffset] = absent;
+            }
+            bucket.entries.clear();
+            bucket.min_block_height = absent;
+        }
+        mSize = 0;
     }
 
     [[nodiscard]] auto max_history() const -> size_t {
@@ -80,11 +135,13 @@ public:
     }
 
 private:
-    static constexpr size_t sentinel = std::numeric_limits<size_t>::max();
     size_t const m_max_history;
 
-    std::vector<size_t> m_pixel;
-    BlockheightPixelCollection m_blockheight_pixelidx;
+    // blockheight of each pixel, or absent
+    std::vector<uint32_t> m_block_height;
+    size_t mOffset{};
+    std::vector<Bucket> mBuckets{};
+    size_t mSize{};
 };
 
 } // namespace buv
@@ -0,0 +1,162 @@
+#include "QueuedStream.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace buv {
+
+QueuedStream::QueuedStream(std::unique_ptr<SocketStream> out, size_t maxFrames, Policy policy)
+    : mOut(std::move(out))
+    , mPolicy(policy)
+    , mFrames(std::max<size_t>(maxFrames, 1))
+    , mReportBegin(std::chrono::steady_clock::now()) {
+    mThread = std::thread([this] {
+        senderLoop();
+    });
+}
+
+QueuedStream::~QueuedStream() {
+    {
+        auto lock = std::lock_guard(mMutex);
+        if (std::uncaught_exceptions() != 0) {
+            dropQueued();
+        }
+        mIsStopped = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+void QueuedStream::write(uint8_t const* data, size_t size) {
+    auto lock = std::unique_lock(mMutex);
+    if (auto error = std::exchange(mError, nullptr)) {
+        std::rethrow_exception(error);
+    }
+    if (mIsAbandoned) {
+        ++mNumDropped;
+        return;
+    }
+    if (mNumQueued == mFrames.size()) {
+        if (mPolicy == Policy::drop) {
+            ++mNumDropped;
+            return;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        mCondition.wait(lock, [this] {
+            return mNumQueued < mFrames.size();
+        });
+        mStallDuration += std::chrono::steady_clock::now() - begin;
+        if (auto error = std::exchange(mError, nullptr)) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // the sender doesn't touch frames that are not queued, and only this thread adds to the queue
+    auto& frame = mFrames[(mHead + mNumQueued) % mFrames.size()];
+    lock.unlock();
+    frame.assign(data, data + size);
+    lock.lock();
+
+    ++mNumQueued;
+    mMaxQueued = std::max(mMaxQueued, mNumQueued);
+    mCondition.notify_all();
+}
+
+void QueuedStream::flush() {
+    auto lock = std::unique_lock(mMutex);
+    mCondition.wait(lock, [this] {
+        return mNumQueued == 0;
+    });
+    if (auto error = std::exchange(mError, nullptr)) {
+        std::rethrow_exception(error);
+    }
+
+    // the sender is idle until the next write(), which is on this thread
+    lock.unlock();
+    mOut->flush();
+}
+
+void QueuedStream::abandon() {
+    {
+        auto lock = std::lock_guard(mMutex);
+        mIsAbandoned = true;
+        dropQueued();
+    }
+    mCondition.notify_all();
+}
+
+void QueuedStream::dropQueued() {
+    // the sender keeps the frame it sends at mHead
+    auto numKept = size_t(mIsSending ? 1 : 0);
+    mNumDropped += mNumQueued - numKept;
+    mNumQueued = numKept;
+}
+
+auto QueuedStream::report() -> std::string {
+    auto lock = std::lock_guard(mMutex);
+    auto now = std::chrono::steady_clock::now();
+    auto sec = std::chrono::duration<double>(now - mReportBegin).count();
+    auto str = fmt::format("queue {}/{} (max {}), {} sent, {} dropped, {:.2f} GB/s, stalled {:.1f}ms, sending {:.1f}ms",
+                           mNumQueued,
+                           mFrames.size(),
+                           mMaxQueued,
+                           mNumSent,
+                           mNumDropped,
+                           sec == 0.0 ? 0.0 : static_cast<double>(mNumBytesSent) / (sec * 1e9),
+                           std::chrono::duration<double, std::milli>(mStallDuration).count(),
+                           std::chrono::duration<double, std::milli>(mSendDuration).count());
+
+    mReportBegin = now;
+    mMaxQueued = mNumQueued;
+    mNumSent = 0;
+    mNumDropped = 0;
+    mNumBytesSent = 0;
+    mStallDuration = {};
+    mSendDuration = {};
+    return str;
+}
+
+void QueuedStream::senderLoop() {
+    auto lock = std::unique_lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] {
+            return mNumQueued != 0 || mIsStopped;
+        });
+        if (mNumQueued == 0) {
+            // stopped, and everything is sent
+            return;
+        }
+
+        auto const& frame = mFrames[mHead];
+        mIsSending = true;
+        lock.unlock();
+        auto begin = std::chrono::steady_clock::now();
+        auto error = std::exception_ptr();
+        try {
+            mOut->write(frame.data(), frame.size());
+        } catch (...) {
+            error = std::current_exception();
+        }
+        auto duration = std::chrono::steady_clock::now() - begin;
+        lock.lock();
+
+        mIsSending = false;
+        mSendDuration += duration;
+        if (error) {
+            // the queued frames would go after the missing one, so they are lost too
+            mError = error;
+            mNumQueued = 0;
+        } else {
+            ++mNumSent;
+            mNumBytesSent += frame.size();
+            mHead = (mHead + 1) % mFrames.size();
+            --mNumQueued;
+        }
+        mCondition.notify_all();
+    }
+}
+
+} // namespace buv
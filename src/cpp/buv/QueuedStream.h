@@ -0,0 +1,91 @@
+#pragma once
+
+#include <buv/SocketStream.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace buv {
+
+// Copies each write() into a bounded queue of frames, which its own thread sends to out. So the renderer only waits for a slow
+// consumer when the queue is full, and with Policy::drop it doesn't wait at all but drops the frame instead, e.g. for a preview.
+// The copy costs memory bandwidth for each frame, so it only pays off when the consumer's speed varies.
+//
+// report() tells who is the bottleneck: When the queue is mostly full and write() stalls, the consumer (e.g. the encoder) is too
+// slow. When the queue is mostly empty, the renderer is. write() must always be called from the same thread.
+class QueuedStream final : public SocketStream {
+public:
+    enum class Policy { block, drop };
+
+private:
+    std::unique_ptr<SocketStream> mOut;
+    Policy mPolicy;
+
+    std::mutex mMutex{};
+    std::condition_variable mCondition{};
+
+    // ring of frames, mNumQueued starting at mHead. The sender keeps its frame queued until it is sent.
+    std::vector<std::vector<uint8_t>> mFrames{};
+    size_t mHead = 0;
+    size_t mNumQueued = 0;
+    bool mIsSending = false;
+    bool mIsStopped = false;
+    bool mIsAbandoned = false;
+    std::exception_ptr mError{};
+
+    // since the last report()
+    std::chrono::steady_clock::time_point mReportBegin{};
+    size_t mMaxQueued = 0;
+    size_t mNumSent = 0;
+    size_t mNumDropped = 0;
+    size_t mNumBytesSent = 0;
+    std::chrono::nanoseconds mStallDuration{};
+    std::chrono::nanoseconds mSendDuration{};
+
+    // last, so it is started after everything else is initialized
+    std::thread mThread{};
+
+public:
+    // Queues up to maxFrames frames, at least 1
+    QueuedStream(std::unique_ptr<SocketStream> out, size_t maxFrames, Policy policy);
+
+    // Sends everything that is still queued. Errors are lost. When destroyed due to an exception, or after abandon(), only waits
+    // for the frame that is currently sent.
+    ~QueuedStream() override;
+
+    QueuedStream(QueuedStream const&) = delete;
+    QueuedStream(QueuedStream&&) = delete;
+    auto operator=(QueuedStream const&) -> QueuedStream& = delete;
+    auto operator=(QueuedStream&&) -> QueuedStream& = delete;
+
+    // Copies data into the queue. When the queue is full it waits, or drops data with Policy::drop. Rethrows errors of the
+    // sending thread, the frames that were queued then are lost.
+    void write(uint8_t const* data, size_t size) override;
+
+    // Waits until everything is sent, then flushes out. Rethrows errors of the sending thread.
+    void flush() override;
+
+    // Drops all queued frames except the one that is currently sent, and all frames written afterwards. E.g. on quit, so
+    // shutdown doesn't wait for a stalled consumer to take the whole queue.
+    void abandon();
+
+    // Queue depth, throughput and how long write() waited, like
+    // "queue 1/3 (max 3), 58 sent, 2 dropped, 1.40 GB/s, stalled 120.5ms, sending 950.2ms". Starts over.
+    [[nodiscard]] auto report() -> std::string;
+
+private:
+    // only with mMutex locked
+    void dropQueued();
+
+    void senderLoop();
+};
+
+} // namespace buv
@@ -0,0 +1,152 @@
+#include "RgbToYuv420p.h"
+
+#ifdef __AVX2__
+#    include <immintrin.h>
+#endif
+
+namespace {
+
+[[nodiscard]] auto lumaOf(int r, int g, int b) -> uint8_t {
+    return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+// r, g, b are the averages of a 2x2 block
+[[nodiscard]] auto chromaUOf(int r, int g, int b) -> uint8_t {
+    return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+[[nodiscard]] auto chromaVOf(int r, int g, int b) -> uint8_t {
+    return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// Converts the 2x2 blocks of the rows y and y + 1, starting at column x
+void convertRowPairScalar(uint8_t const* rgb, size_t width, size_t height, size_t y, size_t x, uint8_t* yuv) {
+    auto const* row0 = rgb + y * width * 3;
+    auto const* row1 = row0 + width * 3;
+    auto* y0 = yuv + y * width;
+    auto* y1 = y0 + width;
+    auto* u = yuv + width * height + (y / 2) * (width / 2);
+    auto* v = u + (width / 2) * (height / 2);
+
+    for (; x < width; x += 2) {
+        auto const* p00 = row0 + x * 3;
+        auto const* p10 = row1 + x * 3;
+        y0[x] = lumaOf(p00[0], p00[1], p00[2]);
+        y0[x + 1] = lumaOf(p00[3], p00[4], p00[5]);
+        y1[x] = lumaOf(p10[0], p10[1], p10[2]);
+        y1[x + 1] = lumaOf(p10[3], p10[4], p10[5]);
+
+        auto r = (p00[0] + p00[3] + p10[0] + p10[3] + 2) >> 2;
+        auto g = (p00[1] + p00[4] + p10[1] + p10[4] + 2) >> 2;
+        auto b = (p00[2] + p00[5] + p10[2] + p10[5] + 2) >> 2;
+        u[x / 2] = chromaUOf(r, g, b);
+        v[x / 2] = chromaVOf(r, g, b);
+    }
+}
+
+#ifdef __AVX2__
+
+struct Planes {
+    __m256i r;
+    __m256i g;
+    __m256i b;
+};
+
+// Loads 16 RGB pixels and deinterleaves them into 16 bit values
+[[nodiscard]] auto load16Pixels(uint8_t const* rgb) -> Planes {
+    auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rgb));
+    auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rgb + 16));
+    auto c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rgb + 32));
+
+    // -1 sets the byte to zero
+    auto r = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    auto g = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    auto bl = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+    return {_mm256_cvtepu8_epi16(r), _mm256_cvtepu8_epi16(g), _mm256_cvtepu8_epi16(bl)};
+}
+
+// Luma of 16 pixels. The sum is at most 56228, so it fits unsigned 16 bit.
+void storeLuma(Planes const& p, uint8_t* out) {
+    auto sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(p.r, _mm256_set1_epi16(66)),
+                                                 _mm256_mullo_epi16(p.g, _mm256_set1_epi16(129))),
+                                _mm256_add_epi16(_mm256_mullo_epi16(p.b, _mm256_set1_epi16(25)), _mm256_set1_epi16(128)));
+    auto luma = _mm256_add_epi16(_mm256_srli_epi16(sum, 8), _mm256_set1_epi16(16));
+
+    // packing works within the 128 bit lanes, so the lower 64 bits of both lanes have to be put together
+    auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(luma, luma), 0xd8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+}
+
+// Average of each horizontal pair of the sums of two rows, as 8 32 bit values
+[[nodiscard]] auto average2x2(__m256i row0, __m256i row1) -> __m256i {
+    auto sums = _mm256_madd_epi16(_mm256_add_epi16(row0, row1), _mm256_set1_epi16(1));
+    return _mm256_srli_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(2)), 2);
+}
+
+// (cr * r + cg * g + cb * b + 128) >> 8 + 128 of 8 32 bit values, stored as 8 bytes
+void storeChroma(__m256i r, __m256i g, __m256i b, int cr, int cg, int cb, uint8_t* out) {
+    auto sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(cr)),
+                                                 _mm256_mullo_epi32(g, _mm256_set1_epi32(cg))),
+                                _mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(cb)), _mm256_set1_epi32(128)));
+    auto chroma = _mm256_add_epi32(_mm256_srai_epi32(sum, 8), _mm256_set1_epi32(128));
+
+    // the first 4 bytes of each 128 bit lane are the result
+    auto packed = _mm256_packus_epi16(_mm256_packs_epi32(chroma, chroma), _mm256_setzero_si256());
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+}
+
+#endif
+
+} // namespace
+
+namespace buv {
+
+void rgbToYuv420p(uint8_t const* rgb, size_t width, size_t height, uint8_t* yuv) {
+#ifdef __AVX2__
+    auto* uPlane = yuv + width * height;
+    auto* vPlane = uPlane + (width / 2) * (height / 2);
+    for (size_t y = 0; y < height; y += 2) {
+        auto const* row0 = rgb + y * width * 3;
+        auto const* row1 = row0 + width * 3;
+        auto* y0 = yuv + y * width;
+        auto* y1 = y0 + width;
+        auto* u = uPlane + (y / 2) * (width / 2);
+        auto* v = vPlane + (y / 2) * (width / 2);
+
+        auto x = size_t();
+        for (; x + 16 <= width; x += 16) {
+            auto p0 = load16Pixels(row0 + x * 3);
+            auto p1 = load16Pixels(row1 + x * 3);
+            storeLuma(p0, y0 + x);
+            storeLuma(p1, y1 + x);
+
+            auto r = average2x2(p0.r, p1.r);
+            auto g = average2x2(p0.g, p1.g);
+            auto b = average2x2(p0.b, p1.b);
+            storeChroma(r, g, b, -38, -74, 112, u + x / 2);
+            storeChroma(r, g, b, 112, -94, -18, v + x / 2);
+        }
+        convertRowPairScalar(rgb, width, height, y, x, yuv);
+    }
+#else
+    rgbToYuv420pScalar(rgb, width, height, yuv);
+#endif
+}
+
+void rgbToYuv420pScalar(uint8_t const* rgb, size_t width, size_t height, uint8_t* yuv) {
+    for (size_t y = 0; y < height; y += 2) {
+        convertRowPairScalar(rgb, width, height, y, 0, yuv);
+    }
+}
+
+} // namespace buv
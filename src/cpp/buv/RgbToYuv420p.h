@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// RGB24 to planar YUV 4:2:0 (yuv420p) with BT.601 limited range coefficients, which is what ffmpeg assumes for yuv420p without
+// further information. The chroma of each 2x2 pixel block is computed from the block's average color.
+namespace buv {
+
+// Number of bytes of a yuv420p image: the full size Y plane, then the U and V planes with half the width and height.
+[[nodiscard]] constexpr auto yuv420pSize(size_t width, size_t height) -> size_t {
+    return width * height + 2 * (width / 2) * (height / 2);
+}
+
+// Converts width x height RGB pixels into yuv420p. Width and height have to be even. Uses AVX2 when compiled for it.
+void rgbToYuv420p(uint8_t const* rgb, size_t width, size_t height, uint8_t* yuv);
+
+// Same as rgbToYuv420p(), without SIMD. Gives exactly the same result.
+void rgbToYuv420pScalar(uint8_t const* rgb, size_t width, size_t height, uint8_t* yuv);
+
+} // namespace buv
@@ -5,15 +5,39 @@
 #include <buv/truncate.h>
 #include <util/log.h>
 
+#include <fmt/format.h>
+
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
 
 namespace buv {
 
+// Maps amounts to pixel rows (logarithmic) and blockheights to pixel columns (linear).
+//
+// Both mappings are precomputed from the floating point math, so that no std::log is needed per change. Amounts are put into
+// buckets by their bit length and the few bits after the leading one, fine enough that each bucket spans at most two rows. The
+// bucket's row is then corrected with one branchless compare against the row's amount threshold, so the result is exactly the
+// same as with the floating point math.
 class SatoshiBlockheightToPixel {
     LinearFunction mFnSatoshi;
     LinearFunction mFnBlock;
     Rect<size_t> mRect{};
 
+    // mSatoshiThresholds[y] is the smallest amount that is drawn at row y - 1 or above. Never reached for y == 0.
+    std::vector<uint64_t> mSatoshiThresholds{};
+
+    // see satoshiBucket()
+    unsigned mBucketMantissaBits = 6;
+
+    // row of the smallest amount of each bucket, see satoshiBucket()
+    std::vector<uint16_t> mBucketPixelHeight{};
+
+    // column for each blockheight < numBlocks, all later blocks are in the last column
+    std::vector<uint16_t> mBlockheightPixelWidth{};
+
 public:
     inline explicit SatoshiBlockheightToPixel(Cfg const& cfg, uint32_t numBlocks)
         : mFnSatoshi(std::log(static_cast<double>(cfg.maxSatoshi)),
@@ -24,20 +48,113 @@ public:
         , mRect(cfg.graphRect) {
         LOG("Satoshi from {}-{} -> {}-{}", cfg.maxSatoshi, cfg.minSatoshi, 0.0, static_cast<double>(cfg.graphRect.h));
         LOG("Height from {}-{} -> {}-{}", 0, numBlocks - 1, 0, static_cast<double>(cfg.graphRect.w));
+        if (mRect.w == 0 || mRect.h == 0 || mRect.w > 65536 || mRect.h > 65536) {
+            throw std::runtime_error(fmt::format("graphRect {}x{} not supported", mRect.w, mRect.h));
+        }
+
+        // the rows are nonincreasing with the amount, so the thresholds can be found with a binary search
+        mSatoshiThresholds.resize(mRect.h);
+        mSatoshiThresholds[0] = std::numeric_limits<uint64_t>::max();
+        for (size_t y = 0; y + 1 < mSatoshiThresholds.size(); ++y) {
+            auto lo = uint64_t(0);
+            auto hi = uint64_t(1) << 63U;
+            while (lo < hi) {
+                auto mid = lo + (hi - lo) / 2;
+                if (amountToPixelHeightByLog(mid) <= y) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            mSatoshiThresholds[y + 1] = lo;
+        }
+
+        // more buckets until the correction in satoshiToPixelHeight() is enough
+        while (!buildBuckets()) {
+            if (++mBucketMantissaBits > 16) {
+                throw std::runtime_error("could not build satoshi to pixel table, rows too dense");
+            }
+        }
+        LOG("Satoshi lookup table with {} buckets", mBucketPixelHeight.size());
+
+        mBlockheightPixelWidth.resize(numBlocks);
+        for (uint32_t blockHeight = 0; blockHeight < numBlocks; ++blockHeight) {
+            mBlockheightPixelWidth[blockHeight] = static_cast<uint16_t>(blockheightToPixelWidthByFma(blockHeight) - mRect.x);
+        }
     }
 
     [[nodiscard]] inline auto satoshiToPixelHeight(int64_t satoshi) const -> size_t {
-        auto const famount = satoshi >= 0 ? satoshi : -satoshi;
-        return mRect.y + truncate<size_t>(0, static_cast<size_t>(mFnSatoshi(std::log(famount))), mRect.h - 1);
+        auto const amount = satoshi >= 0 ? static_cast<uint64_t>(satoshi) : uint64_t(0) - static_cast<uint64_t>(satoshi);
+        auto pixelY = size_t(mBucketPixelHeight[satoshiBucket(amount)]);
+        pixelY -= static_cast<size_t>(amount >= mSatoshiThresholds[pixelY]);
+        return mRect.y + pixelY;
     }
 
     [[nodiscard]] inline auto blockheightToPixelWidth(uint32_t blockHeight) const -> size_t {
+        if (blockHeight >= mBlockheightPixelWidth.size()) {
+            return mRect.x + mRect.w - 1;
+        }
+        return mRect.x + mBlockheightPixelWidth[blockHeight];
+    }
+
+    // The exact mapping the table is built from. Relatively slow due to std::log.
+    [[nodiscard]] inline auto satoshiToPixelHeightByLog(int64_t satoshi) const -> size_t {
+        auto const amount = satoshi >= 0 ? static_cast<uint64_t>(satoshi) : uint64_t(0) - static_cast<uint64_t>(satoshi);
+        return mRect.y + amountToPixelHeightByLog(amount);
+    }
+
+    // The exact mapping the table is built from
+    [[nodiscard]] inline auto blockheightToPixelWidthByFma(uint32_t blockHeight) const -> size_t {
         auto pixel_x = static_cast<size_t>(mFnBlock(blockHeight));
         if (pixel_x > mRect.w - 1) {
             pixel_x = mRect.w - 1;
         }
         return mRect.x + pixel_x;
     }
+
+private:
+    // Truncates in double, so that amounts above maxSatoshi end up in the top row
+    [[nodiscard]] inline auto amountToPixelHeightByLog(uint64_t amount) const -> size_t {
+        if (amount == 0) {
+            // log(0) is -inf, same row as the smallest amounts
+            return mRect.h - 1;
+        }
+        auto pixelY = mFnSatoshi(std::log(static_cast<double>(amount)));
+        return static_cast<size_t>(truncate<double>(0, pixelY, static_cast<double>(mRect.h - 1)));
+    }
+
+    // Bucket of the amount, like a float with mBucketMantissaBits mantissa bits. Monotonic, small amounts get their own bucket.
+    [[nodiscard]] inline auto satoshiBucket(uint64_t amount) const -> size_t {
+        if (amount < (uint64_t(1) << mBucketMantissaBits)) {
+            return amount;
+        }
+        auto exponent = static_cast<unsigned>(63 - __builtin_clzll(amount)) - mBucketMantissaBits;
+        return ((size_t(exponent) + 1) << mBucketMantissaBits) + ((amount >> exponent) - (uint64_t(1) << mBucketMantissaBits));
+    }
+
+    // smallest amount in the bucket
+    [[nodiscard]] inline auto bucketBegin(size_t bucket) const -> uint64_t {
+        if (bucket < (size_t(1) << mBucketMantissaBits)) {
+            return bucket;
+        }
+        auto exponent = (bucket >> mBucketMantissaBits) - 1;
+        auto mantissa = bucket & ((size_t(1) << mBucketMantissaBits) - 1);
+        return ((uint64_t(1) << mBucketMantissaBits) + mantissa) << exponent;
+    }
+
+    // Rows of the smallest amount in each bucket. False when a bucket spans more than two rows.
+    [[nodiscard]] inline auto buildBuckets() -> bool {
+        // up to amount 2^63, which is -INT64_MIN
+        auto numBuckets = (size_t(64 - mBucketMantissaBits) << mBucketMantissaBits) + 1;
+        mBucketPixelHeight.resize(numBuckets);
+        for (size_t bucket = 0; bucket < numBuckets; ++bucket) {
+            mBucketPixelHeight[bucket] = static_cast<uint16_t>(amountToPixelHeightByLog(bucketBegin(bucket)));
+            if (bucket > 0 && mBucketPixelHeight[bucket - 1] > amountToPixelHeightByLog(bucketBegin(bucket) - 1) + 1) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
 } // namespace buv
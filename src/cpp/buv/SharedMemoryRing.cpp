@@ -0,0 +1,248 @@
+#include "SharedMemoryRing.h"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <signal.h> // kill
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std::literals;
+
+namespace {
+
+constexpr auto ringMagic = uint64_t(0x676e6972'5f767562); // "buv_ring"
+constexpr auto pageSize = size_t(4096);
+constexpr auto maxSlots = size_t(256);
+
+// First page of the shared memory, followed by the page aligned slots. The counters only grow, slot of write i is i % numSlots.
+// The pids tell whether the other side is still alive, so neither waits forever for a crashed process.
+struct RingHeader {
+    std::atomic<uint64_t> magic; // set last by the writer
+    uint64_t slotSize;
+    uint64_t numSlots;
+    std::atomic<uint64_t> numWritten;
+    std::atomic<uint64_t> numRead;
+    std::atomic<bool> isClosed;
+    std::atomic<pid_t> writerPid;
+    std::atomic<pid_t> readerPid; // 0 until a reader attaches
+    std::atomic<bool> isReaderClosed;
+    std::array<uint64_t, maxSlots> sizes;
+};
+static_assert(sizeof(RingHeader) <= pageSize);
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "atomics have to work across processes");
+static_assert(std::atomic<pid_t>::is_always_lock_free, "atomics have to work across processes");
+
+[[nodiscard]] auto slotStride(size_t slotSize) -> size_t {
+    return (slotSize + pageSize - 1) / pageSize * pageSize;
+}
+
+[[nodiscard]] auto ringSize(size_t slotSize, size_t numSlots) -> size_t {
+    return pageSize + slotStride(slotSize) * numSlots;
+}
+
+[[nodiscard]] auto header(uint8_t* memory) -> RingHeader& {
+    return *std::launder(reinterpret_cast<RingHeader*>(memory));
+}
+
+[[nodiscard]] auto slot(uint8_t* memory, uint64_t idx) -> uint8_t* {
+    auto const& h = header(memory);
+    return memory + pageSize + (idx % h.numSlots) * slotStride(h.slotSize);
+}
+
+[[nodiscard]] auto mapShared(int fd, size_t size) -> uint8_t* {
+    auto* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error(fmt::format("SharedMemoryRing: could not map {} bytes: {}", size, std::strerror(errno)));
+    }
+    return static_cast<uint8_t*>(memory);
+}
+
+// the other process is in a different frame, so there is no need to react within microseconds
+void waitForOtherProcess() {
+    std::this_thread::sleep_for(100us);
+}
+
+// the ring only works on one machine, so the other side can be asked directly. EPERM means it exists, but belongs to another
+// user.
+[[nodiscard]] auto isAlive(pid_t pid) -> bool {
+    return 0 == kill(pid, 0) || errno == EPERM;
+}
+
+} // namespace
+
+namespace buv {
+
+SharedMemoryRingWriter::SharedMemoryRingWriter(std::string name,
+                                               size_t slotSize,
+                                               size_t numSlots,
+                                               std::chrono::milliseconds attachTimeout)
+    : mName(std::move(name))
+    , mMemorySize(ringSize(slotSize, numSlots))
+    , mAttachTimeout(attachTimeout) {
+    if (numSlots == 0 || numSlots > maxSlots) {
+        throw std::runtime_error(fmt::format("SharedMemoryRing: {} slots not supported, use 1 to {}", numSlots, maxSlots));
+    }
+
+    // remove the ring of a previous run, a reader that still has it open keeps it
+    shm_unlink(mName.c_str());
+    auto fd = shm_open(mName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(fmt::format("SharedMemoryRing: could not create '{}': {}", mName, std::strerror(errno)));
+    }
+    if (0 != ftruncate(fd, static_cast<off_t>(mMemorySize))) {
+        close(fd);
+        shm_unlink(mName.c_str());
+        throw std::runtime_error(fmt::format("SharedMemoryRing: could not resize to {} bytes", mMemorySize));
+    }
+    try {
+        mMemory = mapShared(fd, mMemorySize);
+    } catch (...) {
+        close(fd);
+        shm_unlink(mName.c_str());
+        throw;
+    }
+    close(fd);
+
+    auto* h = new (mMemory) RingHeader();
+    h->slotSize = slotSize;
+    h->numSlots = numSlots;
+    h->writerPid.store(getpid(), std::memory_order_relaxed);
+    h->magic.store(ringMagic, std::memory_order_release);
+}
+
+SharedMemoryRingWriter::~SharedMemoryRingWriter() {
+    header(mMemory).isClosed.store(true, std::memory_order_release);
+    munmap(mMemory, mMemorySize);
+    shm_unlink(mName.c_str());
+}
+
+void SharedMemoryRingWriter::write(uint8_t const* data, size_t size) {
+    auto& h = header(mMemory);
+    if (size > h.slotSize) {
+        throw std::runtime_error(fmt::format("SharedMemoryRing: {} bytes don't fit into a slot of {} bytes", size, h.slotSize));
+    }
+
+    // only this process changes numWritten
+    auto idx = h.numWritten.load(std::memory_order_relaxed);
+    auto waitBegin = std::chrono::steady_clock::now();
+    while (idx - h.numRead.load(std::memory_order_acquire) >= h.numSlots) {
+        auto readerPid = h.readerPid.load(std::memory_order_acquire);
+        if (h.isReaderClosed.load(std::memory_order_acquire) || (readerPid != 0 && !isAlive(readerPid))) {
+            throw std::runtime_error(fmt::format("SharedMemoryRing: the reader of '{}' is gone", mName));
+        }
+        if (readerPid == 0 && std::chrono::steady_clock::now() - waitBegin > mAttachTimeout) {
+            throw std::runtime_error(
+                fmt::format("SharedMemoryRing: no reader attached to '{}' within {}ms", mName, mAttachTimeout.count()));
+        }
+        waitForOtherProcess();
+    }
+    std::memcpy(slot(mMemory, idx), data, size);
+    h.sizes[idx % h.numSlots] = size;
+    h.numWritten.store(idx + 1, std::memory_order_release);
+}
+
+SharedMemoryRingReader::SharedMemoryRingReader(std::string const& name)
+    : mName(name) {
+    // A crashed writer leaves its ring behind. The next writer replaces it, so wait for that instead of attaching to the old one.
+    while (!tryAttach()) {
+        std::this_thread::sleep_for(100ms);
+    }
+}
+
+auto SharedMemoryRingReader::tryAttach() -> bool {
+    auto fd = shm_open(mName.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            throw std::runtime_error(fmt::format("SharedMemoryRing: could not open '{}': {}", mName, std::strerror(errno)));
+        }
+        return false;
+    }
+
+    // the writer resizes it before setting the magic
+    struct stat st {};
+    while (true) {
+        if (0 != fstat(fd, &st)) {
+            auto error = errno;
+            close(fd);
+            throw std::runtime_error(fmt::format("SharedMemoryRing: could not stat '{}': {}", mName, std::strerror(error)));
+        }
+        if (static_cast<size_t>(st.st_size) >= pageSize) {
+            break;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+
+    auto* headerPage = static_cast<uint8_t*>(nullptr);
+    try {
+        headerPage = mapShared(fd, pageSize);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    auto& h = header(headerPage);
+    while (h.magic.load(std::memory_order_acquire) != ringMagic) {
+        // writerPid is set right before the magic. While it is still 0, kill() checks our own process group, which is alive.
+        if (!isAlive(h.writerPid.load(std::memory_order_relaxed)) && h.magic.load(std::memory_order_acquire) != ringMagic) {
+            break;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    if (h.magic.load(std::memory_order_acquire) != ringMagic || !isAlive(h.writerPid.load(std::memory_order_relaxed))) {
+        munmap(headerPage, pageSize);
+        close(fd);
+        return false;
+    }
+    mMemorySize = ringSize(h.slotSize, h.numSlots);
+    munmap(headerPage, pageSize);
+
+    try {
+        mMemory = mapShared(fd, mMemorySize);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    header(mMemory).readerPid.store(getpid(), std::memory_order_release);
+    return true;
+}
+
+SharedMemoryRingReader::~SharedMemoryRingReader() {
+    header(mMemory).isReaderClosed.store(true, std::memory_order_release);
+    munmap(mMemory, mMemorySize);
+}
+
+auto SharedMemoryRingReader::read(std::function<void(uint8_t const* data, size_t size)> const& fn) -> bool {
+    auto& h = header(mMemory);
+
+    // only this process changes numRead
+    auto idx = h.numRead.load(std::memory_order_relaxed);
+    while (h.numWritten.load(std::memory_order_acquire) == idx) {
+        // The writer sets isClosed after its last write. Liveness is checked first, so a writer that closes and exits in
+        // between isn't taken for a crashed one.
+        auto isWriterAlive = isAlive(h.writerPid.load(std::memory_order_relaxed));
+        if (h.isClosed.load(std::memory_order_acquire) && h.numWritten.load(std::memory_order_acquire) == idx) {
+            return false;
+        }
+        if (!isWriterAlive && h.numWritten.load(std::memory_order_acquire) == idx) {
+            throw std::runtime_error(fmt::format("SharedMemoryRing: the writer of '{}' is gone", mName));
+        }
+        waitForOtherProcess();
+    }
+    fn(slot(mMemory, idx), h.sizes[idx % h.numSlots]);
+    h.numRead.store(idx + 1, std::memory_order_release);
+    return true;
+}
+
+} // namespace buv
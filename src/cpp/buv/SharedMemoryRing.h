@@ -0,0 +1,68 @@
+#pragma once
+
+#include <buv/SocketStream.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace buv {
+
+// Writes into a ring of slots in POSIX shared memory, for a consumer on the same machine. Each write() is copied into the next
+// slot, which is the only copy until the consumer gets the data. Only waits when all slots are still unread.
+//
+// A SharedMemoryRingReader in another process reads the slots in the same order, e.g. the shm_reader tool. The ring is removed
+// when the writer is destroyed, a reader still gets everything that was written. Both sides throw instead of waiting forever when
+// the other one has exited or crashed.
+class SharedMemoryRingWriter final : public SocketStream {
+    std::string mName;
+    uint8_t* mMemory = nullptr;
+    size_t mMemorySize = 0;
+    std::chrono::milliseconds mAttachTimeout;
+
+public:
+    // name is a shm_open() name like "/buv". Each write() can be up to slotSize bytes. When all slots are full and no reader has
+    // attached within attachTimeout, write() throws.
+    SharedMemoryRingWriter(std::string name,
+                           size_t slotSize,
+                           size_t numSlots,
+                           std::chrono::milliseconds attachTimeout = std::chrono::seconds(30));
+    ~SharedMemoryRingWriter() override;
+
+    SharedMemoryRingWriter(SharedMemoryRingWriter const&) = delete;
+    SharedMemoryRingWriter(SharedMemoryRingWriter&&) = delete;
+    auto operator=(SharedMemoryRingWriter const&) -> SharedMemoryRingWriter& = delete;
+    auto operator=(SharedMemoryRingWriter&&) -> SharedMemoryRingWriter& = delete;
+
+    // Waits while all slots are full. Throws when the reader is gone, or none has attached in time.
+    void write(uint8_t const* data, size_t size) override;
+};
+
+// Only one reader per ring is supported.
+class SharedMemoryRingReader {
+    std::string mName;
+    uint8_t* mMemory = nullptr;
+    size_t mMemorySize = 0;
+
+public:
+    // Waits until a live writer has created the ring. A ring left behind by a crashed writer is skipped.
+    explicit SharedMemoryRingReader(std::string const& name);
+    ~SharedMemoryRingReader();
+
+    SharedMemoryRingReader(SharedMemoryRingReader const&) = delete;
+    SharedMemoryRingReader(SharedMemoryRingReader&&) = delete;
+    auto operator=(SharedMemoryRingReader const&) -> SharedMemoryRingReader& = delete;
+    auto operator=(SharedMemoryRingReader&&) -> SharedMemoryRingReader& = delete;
+
+    // Waits for the next write() and calls fn with its data, before the slot is given back to the writer. Returns false instead
+    // when the writer is gone and everything was read. Throws when the writer has crashed.
+    auto read(std::function<void(uint8_t const* data, size_t size)> const& fn) -> bool;
+
+private:
+    // maps the ring if it exists and its writer is alive
+    auto tryAttach() -> bool;
+};
+
+} // namespace buv
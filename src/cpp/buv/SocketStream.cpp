@@ -2,6 +2,8 @@
 
 #ifdef _WIN32
 
+#    include <stdexcept>
+
 #    include <winsock2.h>
 
 namespace buv {
@@ -38,15 +40,43 @@ private:
 
 #else
 
+#    include <util/writeToPipe.h>
+
+#    include <fmt/format.h>
+
+#    include <cerrno>
+#    include <cstring>
 #    include <stdexcept>
 
 #    include <arpa/inet.h> // inet_addr
+#    include <fcntl.h> // open
 #    include <netinet/in.h> // scockaddr_in
 #    include <sys/socket.h> // socket
+#    include <sys/stat.h> // mkfifo
+#    include <sys/un.h> // sockaddr_un
 #    include <unistd.h> // close
 
 namespace buv {
 
+namespace {
+
+// loop until we've sent everything
+void sendAll(int socket, uint8_t const* data, size_t size) {
+    while (size != 0) {
+        auto sentBytes = send(socket, reinterpret_cast<char const*>(data), size, 0);
+        if (sentBytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("send failed!");
+        }
+        size -= static_cast<size_t>(sentBytes);
+        data += sentBytes;
+    }
+}
+
+} // namespace
+
 class SocketStreamImpl final : public SocketStream {
     int mSocket = -1;
     sockaddr_in mServAddr{};
@@ -79,16 +109,75 @@ public:
     auto operator=(SocketStreamImpl&&) -> SocketStreamImpl& = delete;
 
     void write(uint8_t const* data, size_t size) override {
-        // loop until we've sent everything
-        while (size != 0) {
-            auto sentBytes = send(mSocket, reinterpret_cast<char const*>(data), static_cast<int>(size), 0);
-            if (sentBytes == -1) {
-                throw std::runtime_error("send failed!");
-            }
-            size -= sentBytes;
-            data += sentBytes;
+        sendAll(mSocket, data, size);
+    }
+};
+
+class UnixSocketStreamImpl final : public SocketStream {
+    int mSocket = -1;
+
+public:
+    explicit UnixSocketStreamImpl(std::string const& path) {
+        auto addr = sockaddr_un();
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error(fmt::format("unix socket path '{}' is too long", path));
+        }
+        mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (mSocket < 0) {
+            throw std::runtime_error("could not create socket");
+        }
+
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        if (0 != connect(mSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+            close(mSocket);
+            throw std::runtime_error(fmt::format("could not connect() to '{}': {}", path, std::strerror(errno)));
         }
     }
+
+    ~UnixSocketStreamImpl() override {
+        close(mSocket);
+    }
+
+    UnixSocketStreamImpl(UnixSocketStreamImpl const&) = delete;
+    UnixSocketStreamImpl(UnixSocketStreamImpl&&) = delete;
+    auto operator=(UnixSocketStreamImpl const&) -> UnixSocketStreamImpl& = delete;
+    auto operator=(UnixSocketStreamImpl&&) -> UnixSocketStreamImpl& = delete;
+
+    void write(uint8_t const* data, size_t size) override {
+        sendAll(mSocket, data, size);
+    }
+};
+
+class FifoStreamImpl final : public SocketStream {
+    int mFd = -1;
+
+public:
+    explicit FifoStreamImpl(std::string const& path) {
+        if (0 != mkfifo(path.c_str(), 0644) && errno != EEXIST) {
+            throw std::runtime_error(fmt::format("could not create fifo '{}': {}", path, std::strerror(errno)));
+        }
+
+        // blocks until the reader has opened it too
+        mFd = open(path.c_str(), O_WRONLY);
+        if (mFd < 0) {
+            throw std::runtime_error(fmt::format("could not open '{}': {}", path, std::strerror(errno)));
+        }
+        util::growPipe(mFd);
+    }
+
+    ~FifoStreamImpl() override {
+        close(mFd);
+    }
+
+    FifoStreamImpl(FifoStreamImpl const&) = delete;
+    FifoStreamImpl(FifoStreamImpl&&) = delete;
+    auto operator=(FifoStreamImpl const&) -> FifoStreamImpl& = delete;
+    auto operator=(FifoStreamImpl&&) -> FifoStreamImpl& = delete;
+
+    void write(uint8_t const* data, size_t size) override {
+        util::writeToPipe(mFd, data, size);
+    }
 };
 
 } // namespace buv
@@ -97,8 +186,39 @@ public:
 
 namespace buv {
 
+class NullStreamImpl final : public SocketStream {
+public:
+    void write(uint8_t const* /*data*/, size_t /*size*/) override {}
+};
+
 auto SocketStream::create(const char* ip_addr, uint16_t socket) -> std::unique_ptr<SocketStream> {
     return std::make_unique<SocketStreamImpl>(ip_addr, socket);
 }
 
+#ifdef _WIN32
+
+auto SocketStream::createUnix(std::string const& /*path*/) -> std::unique_ptr<SocketStream> {
+    throw std::runtime_error("unix sockets are not supported on Windows");
+}
+
+auto SocketStream::createFifo(std::string const& /*path*/) -> std::unique_ptr<SocketStream> {
+    throw std::runtime_error("fifos are not supported on Windows");
+}
+
+#else
+
+auto SocketStream::createUnix(std::string const& path) -> std::unique_ptr<SocketStream> {
+    return std::make_unique<UnixSocketStreamImpl>(path);
+}
+
+auto SocketStream::createFifo(std::string const& path) -> std::unique_ptr<SocketStream> {
+    return std::make_unique<FifoStreamImpl>(path);
+}
+
+#endif
+
+auto SocketStream::createNull() -> std::unique_ptr<SocketStream> {
+    return std::make_unique<NullStreamImpl>();
+}
+
 } // namespace buv
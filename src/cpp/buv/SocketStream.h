@@ -2,15 +2,20 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 
 namespace buv {
 
 // abstract class so we can hide all the nasty OS specific stuff in the .cpp file.
-// Connects to a server and writes data to that socket.
+// Connects to a consumer, e.g. ffmpeg, and writes data to it. When write() returns, data can be changed.
 class SocketStream {
 public:
     SocketStream() = default;
     virtual void write(uint8_t const* data, size_t size) = 0;
+
+    // Waits until everything written is handed to the consumer, and throws if that failed. Streams that send in the background
+    // have to be flushed before they are destroyed, otherwise errors of the last frames are lost.
+    virtual void flush() {}
     virtual ~SocketStream() = default;
 
     SocketStream(SocketStream const&) = delete;
@@ -18,8 +23,20 @@ public:
     auto operator=(SocketStream const&) -> SocketStream& = delete;
     auto operator=(SocketStream&&) -> SocketStream& = delete;
 
-    // factory
+    // factories
+
+    // TCP connection to a server
     static auto create(const char* ip_addr, uint16_t socket) -> std::unique_ptr<SocketStream>;
+
+    // Unix domain socket, e.g. ffmpeg's "-listen 1 -i unix:/tmp/buv.sock". No TCP/IP stack overhead.
+    static auto createUnix(std::string const& path) -> std::unique_ptr<SocketStream>;
+
+    // Named pipe, created when it doesn't exist. Blocks until a reader opens it. Data is handed to the pipe with vmsplice(), see
+    // util::writeToPipe(). When path is a regular file, it is just written.
+    static auto createFifo(std::string const& path) -> std::unique_ptr<SocketStream>;
+
+    // Discards everything, to measure without a consumer
+    static auto createNull() -> std::unique_ptr<SocketStream>;
 };
 
 } // namespace buv
@@ -0,0 +1,64 @@
+#include "Yuv420pStream.h"
+
+#include <buv/RgbToYuv420p.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+constexpr auto frameHeader = std::string_view("FRAME\n");
+
+} // namespace
+
+namespace buv {
+
+Yuv420pStream::Yuv420pStream(std::unique_ptr<SocketStream> out, size_t width, size_t height, uint32_t frameRate)
+    : mOut(std::move(out))
+    , mWidth(width)
+    , mHeight(height) {
+    if (mWidth % 2 != 0 || mHeight % 2 != 0) {
+        throw std::runtime_error(fmt::format("yuv420p needs an even image size, got {}x{}", mWidth, mHeight));
+    }
+
+    // see https://wiki.multimedia.cx/index.php/YUV4MPEG2. C420jpeg is ffmpeg's yuv420p.
+    auto header = fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", mWidth, mHeight, frameRate);
+    mHeader.assign(header.begin(), header.end());
+
+    for (auto& frame : mFrames) {
+        frame.resize(frameHeader.size() + yuv420pSize(mWidth, mHeight));
+        std::copy(frameHeader.begin(), frameHeader.end(), frame.begin());
+    }
+}
+
+Yuv420pStream::~Yuv420pStream() = default;
+
+void Yuv420pStream::write(uint8_t const* data, size_t size) {
+    if (size != mWidth * mHeight * 3) {
+        throw std::runtime_error(fmt::format("expected {}x{} RGB image, got {} bytes", mWidth, mHeight, size));
+    }
+
+    // the sender only uses the other frame
+    auto& frame = mFrames[mFrameIdx];
+    mFrameIdx ^= 1U;
+    rgbToYuv420p(data, mWidth, mHeight, frame.data() + frameHeader.size());
+
+    mSender.submit([this, &frame] {
+        if (!mHeader.empty()) {
+            mOut->write(mHeader.data(), mHeader.size());
+            mHeader.clear();
+        }
+        mOut->write(frame.data(), frame.size());
+    });
+}
+
+void Yuv420pStream::flush() {
+    mSender.wait();
+    mOut->flush();
+}
+
+} // namespace buv
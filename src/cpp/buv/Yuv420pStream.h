@@ -0,0 +1,48 @@
+#pragma once
+
+#include <buv/SocketStream.h>
+#include <util/BackgroundWorker.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace buv {
+
+// Converts RGB frames to yuv420p, and writes them into out as a YUV4MPEG2 (Y4M) stream. That's half the bytes of rgb24, and
+// ffmpeg gets size and frame rate from the stream's header, so it can be started with just "-f yuv4mpegpipe -i ...".
+//
+// While a frame is sent on a background thread, the next one can already be converted.
+class Yuv420pStream final : public SocketStream {
+    std::unique_ptr<SocketStream> mOut;
+    size_t mWidth;
+    size_t mHeight;
+    std::vector<uint8_t> mHeader{};
+
+    // "FRAME\n" and the converted image. One is converted while the other one is sent.
+    std::array<std::vector<uint8_t>, 2> mFrames{};
+    size_t mFrameIdx = 0;
+
+    // last, so it is stopped before everything else is destroyed
+    util::BackgroundWorker mSender{};
+
+public:
+    // width and height have to be even
+    Yuv420pStream(std::unique_ptr<SocketStream> out, size_t width, size_t height, uint32_t frameRate);
+    ~Yuv420pStream() override;
+
+    Yuv420pStream(Yuv420pStream const&) = delete;
+    Yuv420pStream(Yuv420pStream&&) = delete;
+    auto operator=(Yuv420pStream const&) -> Yuv420pStream& = delete;
+    auto operator=(Yuv420pStream&&) -> Yuv420pStream& = delete;
+
+    // data is a width x height RGB image. It is converted before write() returns, so it can be changed afterwards.
+    void write(uint8_t const* data, size_t size) override;
+
+    // waits until everything is sent, then flushes out. Rethrows errors of the background thread.
+    void flush() override;
+};
+
+} // namespace buv
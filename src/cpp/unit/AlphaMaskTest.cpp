@@ -0,0 +1,93 @@
+#include <buv/AlphaMask.h>
+#include <buv/GlyphAtlas.h>
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+TEST_CASE("alpha_mask_blend_white") {
+    for (int dst = 0; dst < 256; ++dst) {
+        for (int alpha = 0; alpha < 256; ++alpha) {
+            auto expected = std::lround(dst + (255 - dst) * alpha / 255.0);
+            REQUIRE(buv::AlphaMask::blendWhite(static_cast<uint8_t>(dst), static_cast<uint8_t>(alpha)) == expected);
+        }
+    }
+}
+
+TEST_CASE("alpha_mask") {
+    // 4x3 coverage, cropped to the middle 2x2
+    auto coverage = std::vector<uint8_t>{
+        0, 0,   0,   0, //
+        0, 255, 128, 0, //
+        0, 0,   64,  0, //
+    };
+    auto mask = buv::AlphaMask(coverage.data(), 4, 3, -10, -20);
+    REQUIRE(mask.offsetX() == -9);
+    REQUIRE(mask.offsetY() == -19);
+    REQUIRE(mask.width() == 2);
+    REQUIRE(mask.height() == 2);
+    REQUIRE(buv::AlphaMask(coverage.data(), 4, 1, 0, 0).empty());
+
+    // 3x2 gray canvas
+    auto rgb = std::vector<uint8_t>(3 * 2 * 3, 100);
+    auto canvas = buv::RgbCanvas{rgb.data(), 3, 2, {}};
+
+    // the top left of the mask is clipped
+    mask.blendInto(canvas, 8, 18);
+    REQUIRE(canvas.drawnRects.size() == 1);
+    REQUIRE(canvas.drawnRects[0].x == 0);
+    REQUIRE(canvas.drawnRects[0].y == 0);
+    REQUIRE(canvas.drawnRects[0].w == 1);
+    REQUIRE(canvas.drawnRects[0].h == 1);
+    auto blended = buv::AlphaMask::blendWhite(100, 64);
+    REQUIRE(rgb == std::vector<uint8_t>{blended, blended, blended, 100, 100, 100, 100, 100, 100, //
+                                        100, 100, 100, 100, 100, 100, 100, 100, 100});
+
+    // completely outside
+    mask.blendInto(canvas, 100, 0);
+    mask.blendInto(canvas, 0, -100);
+    REQUIRE(canvas.drawnRects.size() == 1);
+}
+
+TEST_CASE("glyph_atlas") {
+    // 'i' is a 1x2 bar, 'o' is a 2x1 bar on the baseline
+    auto i = std::vector<uint8_t>{255, 255};
+    auto o = std::vector<uint8_t>{255, 255};
+    auto atlas = buv::GlyphAtlas();
+    atlas.set('i', buv::AlphaMask(i.data(), 1, 2, 0, -1), 2);
+    atlas.set('o', buv::AlphaMask(o.data(), 2, 1, 0, 0), 3);
+    REQUIRE(atlas.textWidth("oio") == 8);
+    REQUIRE(atlas.textWidth("?") == 0);
+
+    auto rgb = std::vector<uint8_t>(10 * 3 * 3, 0);
+    auto canvas = buv::RgbCanvas{rgb.data(), 10, 3, {}};
+    atlas.draw(canvas, 1, 1, "oi?o");
+
+    // one rect for the whole text
+    REQUIRE(canvas.drawnRects.size() == 1);
+    REQUIRE(canvas.drawnRects[0].x == 1);
+    REQUIRE(canvas.drawnRects[0].y == 0);
+    REQUIRE(canvas.drawnRects[0].w == 7);
+    REQUIRE(canvas.drawnRects[0].h == 2);
+
+    auto covered = std::string();
+    for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 10; ++x) {
+            covered += rgb[(y * 10 + x) * 3] == 255 ? '#' : '.';
+        }
+        covered += '\n';
+    }
+    REQUIRE(covered == "....#.....\n.##.#.##..\n..........\n");
+
+    // centered in cells of 4 pixels
+    canvas.drawnRects.clear();
+    std::fill(rgb.begin(), rgb.end(), uint8_t(0));
+    atlas.drawMono(canvas, 0, 1, "io", 4);
+    REQUIRE(canvas.drawnRects.size() == 1);
+    REQUIRE(canvas.drawnRects[0].x == 1);
+    REQUIRE(canvas.drawnRects[0].w == 5);
+}
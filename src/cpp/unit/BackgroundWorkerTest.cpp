@@ -0,0 +1,44 @@
+#include <util/BackgroundWorker.h>
+
+#include <doctest.h>
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("background_worker") {
+    auto worker = util::BackgroundWorker();
+
+    // jobs run one after another, in order, and not on the caller's thread
+    auto results = std::vector<size_t>();
+    auto workerThreadId = std::thread::id();
+    for (size_t i = 0; i < 1000; ++i) {
+        worker.submit([&, i] {
+            results.push_back(i);
+            workerThreadId = std::this_thread::get_id();
+        });
+    }
+    worker.wait();
+    REQUIRE(results.size() == 1000);
+    for (size_t i = 0; i < results.size(); ++i) {
+        REQUIRE(results[i] == i);
+    }
+    REQUIRE(workerThreadId != std::this_thread::get_id());
+
+    // the exception is rethrown once, then the worker can be used again
+    worker.submit([] {
+        throw std::runtime_error("fail");
+    });
+    REQUIRE_THROWS_AS(worker.wait(), std::runtime_error);
+    worker.wait();
+
+    worker.submit([] {
+        throw std::runtime_error("fail");
+    });
+    REQUIRE_THROWS_AS(worker.submit([] {}), std::runtime_error);
+    worker.submit([&] {
+        results.clear();
+    });
+    worker.wait();
+    REQUIRE(results.empty());
+}
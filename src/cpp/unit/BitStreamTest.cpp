@@ -0,0 +1,83 @@
+#include <util/BitStream.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <string>
+#include <vector>
+
+TEST_CASE("bit_stream_rice") {
+    auto rng = ankerl::nanobench::Rng(1234);
+
+    for (uint64_t k = 0; k <= 32; k += 4) {
+        // mostly values around 2^k, and a few huge outliers that need the escape
+        auto values = std::vector<uint64_t>();
+        for (int i = 0; i < 1000; ++i) {
+            if (rng.bounded(50) == 0) {
+                values.push_back(rng());
+            } else {
+                values.push_back(rng() >> (63 - k));
+            }
+        }
+
+        auto data = std::string();
+        auto writer = util::BitWriter(data);
+        auto numBits = uint64_t();
+        for (auto val : values) {
+            writer.writeRice(val, k);
+            numBits += util::riceNumBits(val, k);
+        }
+        writer.write(0b101, 3);
+        writer.finish();
+        REQUIRE(data.size() == (numBits + 3 + 7) / 8);
+
+        auto reader = util::BitReader(data.data(), data.data() + data.size());
+        for (auto val : values) {
+            REQUIRE(reader.readRice(k) == val);
+        }
+        REQUIRE(reader.read(3) == 0b101);
+    }
+}
+
+TEST_CASE("bit_stream_optimal_k") {
+    auto values = std::vector<uint64_t>(1000, 1000);
+    auto k = util::optimalRiceK(values.data(), values.size());
+    auto numBits = [&](uint64_t k) {
+        auto n = uint64_t();
+        for (auto val : values) {
+            n += util::riceNumBits(val, k);
+        }
+        return n;
+    };
+    for (uint64_t otherK = 0; otherK <= 32; ++otherK) {
+        REQUIRE(numBits(k) <= numBits(otherK));
+    }
+    REQUIRE(util::optimalRiceK(values.data(), 0) == 0);
+}
+
+TEST_CASE("bit_stream_truncated") {
+    auto data = std::string();
+    auto writer = util::BitWriter(data);
+    writer.writeRice(1000, 4);
+    writer.writeRice(UINT64_C(0xffffffffffff), 0);
+    writer.write(0b11, 2);
+    writer.finish();
+
+    // every byte holds bits of a value
+    for (size_t size = 0; size < data.size(); ++size) {
+        auto reader = util::BitReader(data.data(), data.data() + size);
+        REQUIRE_THROWS([&] {
+            (void)reader.readRice(4);
+            (void)reader.readRice(0);
+            (void)reader.read(2);
+        }());
+    }
+
+    auto reader = util::BitReader(data.data(), data.data() + data.size());
+    REQUIRE(reader.readRice(4) == 1000);
+    REQUIRE(reader.readRice(0) == UINT64_C(0xffffffffffff));
+    REQUIRE(reader.read(2) == 0b11);
+
+    // only the 6 bits of padding of the last byte are left
+    REQUIRE_THROWS((void)reader.read(7));
+}
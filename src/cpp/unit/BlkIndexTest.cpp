@@ -0,0 +1,99 @@
+#include <app/BlkIndex.h>
+#include <app/BlockEncoder.h>
+#include <util/Mmap.h>
+
+#include <doctest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+auto makeBlocks(uint32_t numBlocks) -> std::vector<buv::ChangesInBlock> {
+    auto cibs = std::vector<buv::ChangesInBlock>();
+    auto cib = buv::ChangesInBlock();
+    for (uint32_t blockHeight = 0; blockHeight < numBlocks; ++blockHeight) {
+        auto& bd = cib.beginBlock(blockHeight);
+        bd.time = 1231006505 + blockHeight * 600;
+        bd.nTx = blockHeight + 1;
+        for (uint32_t i = 0; i <= blockHeight; ++i) {
+            cib.addChange(5'000'000'000 + i, blockHeight);
+            if (i < blockHeight) {
+                cib.addChange(-static_cast<int64_t>(1000 + i), i);
+            }
+        }
+        cib.finalizeBlock();
+        cibs.push_back(cib);
+    }
+    return cibs;
+}
+
+} // namespace
+
+TEST_CASE("blk_index") {
+    auto blkFilename = std::filesystem::temp_directory_path() / "buv_blk_index_test.blk";
+    auto cibs = makeBlocks(10);
+    {
+        auto fout = std::ofstream(blkFilename, std::ios::binary | std::ios::out);
+        for (auto const& cib : cibs) {
+            fout << cib.encode();
+        }
+    }
+
+    {
+        auto blkFile = util::Mmap(blkFilename);
+        REQUIRE(blkFile.is_open());
+        auto index = buv::loadOrBuildBlkIndex(blkFilename, blkFile);
+        REQUIRE(index.size() == cibs.size());
+        REQUIRE(index.matches(blkFile));
+
+        // random access, backwards
+        for (size_t h = cibs.size(); h-- > 0;) {
+            REQUIRE(index[h].blockData == cibs[h].blockData());
+            auto [cib, nextPtr] = buv::ChangesInBlock::decode(index.frame(blkFile, h));
+            REQUIRE(cib.blockData().blockHeight == h);
+            REQUIRE(cib.changeAtBlockheights() == cibs[h].changeAtBlockheights());
+            if (h + 1 < cibs.size()) {
+                REQUIRE(nextPtr == index.frame(blkFile, h + 1));
+            } else {
+                REQUIRE(nextPtr == blkFile.end());
+            }
+        }
+    }
+
+    // the .blk file grows, so the index is outdated and rebuilt
+    {
+        auto fout = std::ofstream(blkFilename, std::ios::binary | std::ios::out | std::ios::app);
+        auto more = makeBlocks(11);
+        fout << more.back().encode();
+    }
+    {
+        auto blkFile = util::Mmap(blkFilename);
+        REQUIRE(!buv::BlkIndex(buv::blkIndexFilename(blkFilename)).matches(blkFile));
+        auto index = buv::loadOrBuildBlkIndex(blkFilename, blkFile);
+        REQUIRE(index.size() == 11);
+        REQUIRE(index.matches(blkFile));
+    }
+
+    // truncating the writer removes the last entries
+    {
+        auto writer = buv::BlkIndexWriter(buv::blkIndexFilename(blkFilename));
+        auto offset = uint64_t();
+        for (auto const& cib : cibs) {
+            auto data = cib.encode();
+            writer.append(offset, static_cast<uint32_t>(data.size() - (4U + 4U + 4U)), cib.blockData());
+            offset += data.size();
+        }
+        REQUIRE_THROWS(writer.append(offset, 0, cibs[3].blockData()));
+        writer.truncate(4);
+        writer.append(offset, 0, cibs[4].blockData());
+        writer.flush();
+
+        auto index = buv::BlkIndex(buv::blkIndexFilename(blkFilename));
+        REQUIRE(index.size() == 5);
+        REQUIRE(index[4].fileOffset == offset);
+    }
+
+    std::filesystem::remove(buv::blkIndexFilename(blkFilename));
+    std::filesystem::remove(blkFilename);
+}
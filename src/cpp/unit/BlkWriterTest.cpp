@@ -0,0 +1,113 @@
+#include <app/BlkIndex.h>
+#include <app/BlkWriter.h>
+#include <app/BlockEncoder.h>
+#include <util/Mmap.h>
+
+#include <doctest.h>
+
+#include <filesystem>
+
+TEST_CASE("blk_writer") {
+    auto blkFilename = std::filesystem::temp_directory_path() / "buv_blk_writer_test.blk";
+
+    // large enough that the buffer is handed to the background thread several times
+    auto expected = std::string();
+    auto offsetAfter = std::vector<uint64_t>();
+    {
+        auto writer = buv::BlkWriter(blkFilename, buv::BlkFormat::varintRle);
+        auto cib = buv::ChangesInBlock();
+        for (uint32_t blockHeight = 0; blockHeight < 300; ++blockHeight) {
+            (void)cib.beginBlock(blockHeight);
+            for (uint32_t i = 0; i < 10'000; ++i) {
+                cib.addChange(-static_cast<int64_t>(i * 7919 + blockHeight), i % (blockHeight + 1));
+            }
+            cib.finalizeBlock();
+            cib.encodeInto(expected, buv::BlkFormat::varintRle);
+            writer.write(cib);
+            REQUIRE(writer.fileOffset() == expected.size());
+            offsetAfter.push_back(writer.fileOffset());
+
+            if (blockHeight == 150) {
+                // checkpoint: everything written so far is in the file
+                writer.flush();
+                REQUIRE(std::filesystem::file_size(blkFilename) == expected.size());
+            }
+        }
+
+        // roll back the last 10 blocks, and write them again
+        writer.truncate(290, offsetAfter[289]);
+        REQUIRE(std::filesystem::file_size(blkFilename) == offsetAfter[289]);
+        expected.resize(offsetAfter[289]);
+        for (uint32_t blockHeight = 290; blockHeight < 300; ++blockHeight) {
+            (void)cib.beginBlock(blockHeight);
+            cib.addChange(546, blockHeight);
+            cib.finalizeBlock();
+            cib.encodeInto(expected, buv::BlkFormat::varintRle);
+            writer.write(cib);
+        }
+    }
+
+    // the destructor writes the rest and cuts off the preallocated space
+    REQUIRE(std::filesystem::file_size(blkFilename) == expected.size());
+    {
+        auto blkFile = util::Mmap(blkFilename);
+        REQUIRE(std::string_view(blkFile.data(), blkFile.size()) == expected);
+
+        auto index = buv::BlkIndex(buv::blkIndexFilename(blkFilename));
+        REQUIRE(index.size() == 300);
+        REQUIRE(index.matches(blkFile));
+    }
+
+    std::filesystem::remove(blkFilename);
+    std::filesystem::remove(buv::blkIndexFilename(blkFilename));
+}
+
+TEST_CASE("blk_writer_reopen") {
+    auto blkFilename = std::filesystem::temp_directory_path() / "buv_blk_writer_reopen_test.blk";
+
+    auto expected = std::string();
+    auto offsetAfter = std::vector<uint64_t>();
+    auto cib = buv::ChangesInBlock();
+    auto writeBlock = [&](buv::BlkWriter& writer, uint32_t blockHeight) {
+        (void)cib.beginBlock(blockHeight);
+        for (uint32_t i = 0; i < 100; ++i) {
+            cib.addChange(-static_cast<int64_t>(i * 31 + blockHeight), i % (blockHeight + 1));
+        }
+        cib.finalizeBlock();
+        cib.encodeInto(expected, buv::BlkFormat::varint);
+        writer.write(cib);
+        offsetAfter.push_back(writer.fileOffset());
+    };
+
+    {
+        auto writer = buv::BlkWriter(blkFilename, buv::BlkFormat::varint);
+        for (uint32_t blockHeight = 0; blockHeight < 20; ++blockHeight) {
+            writeBlock(writer, blockHeight);
+        }
+    }
+
+    // continue after block 14, as if the process was restarted from a checkpoint
+    expected.resize(offsetAfter[14]);
+    offsetAfter.resize(15);
+    {
+        auto writer = buv::BlkWriter(blkFilename, buv::BlkFormat::varint, 15);
+        REQUIRE(writer.fileOffset() == expected.size());
+        for (uint32_t blockHeight = 15; blockHeight < 25; ++blockHeight) {
+            writeBlock(writer, blockHeight);
+        }
+    }
+    {
+        auto blkFile = util::Mmap(blkFilename);
+        REQUIRE(std::string_view(blkFile.data(), blkFile.size()) == expected);
+
+        auto index = buv::BlkIndex(buv::blkIndexFilename(blkFilename));
+        REQUIRE(index.size() == 25);
+        REQUIRE(index.matches(blkFile));
+    }
+
+    // can't continue after more blocks than there are
+    REQUIRE_THROWS(buv::BlkWriter(blkFilename, buv::BlkFormat::varint, 26));
+
+    std::filesystem::remove(blkFilename);
+    std::filesystem::remove(buv::blkIndexFilename(blkFilename));
+}
@@ -4,6 +4,9 @@
 
 #include <doctest.h>
 #include <fmt/format.h>
+#include <nanobench.h>
+
+#include <cstring>
 
 // creates the data structure
 TEST_CASE("block_encoder_test_simple") {
@@ -74,6 +77,37 @@ auto makeTwoBlocks() -> std::vector<buv::ChangesInBlock> {
     return cibs;
 }
 
+// sets the frame's payload size, so the frame ends numCut bytes early
+auto truncated(std::string frame, size_t numCut) -> std::string {
+    frame.resize(frame.size() - numCut);
+    auto numBytes = static_cast<uint32_t>(frame.size() - (4U + 4U + 4U));
+    std::memcpy(frame.data() + 4 + 4, &numBytes, sizeof(numBytes));
+    return frame;
+}
+
+// frame of an empty block in the given format, with the transaction info replaced by txData
+auto frameWithTransactions(buv::BlkFormat format, std::string const& txData) -> std::string {
+    auto cib = buv::ChangesInBlock();
+    (void)cib.beginBlock(1000);
+    cib.finalizeBlock();
+
+    // num_changes and num_spent are 0
+    auto frame = truncated(cib.encode(format), 2);
+    return truncated(frame + txData, 0);
+}
+
+// 50 changes, half of them spent
+auto makeMixedBlock() -> buv::ChangesInBlock {
+    auto cib = buv::ChangesInBlock();
+    (void)cib.beginBlock(1000);
+    for (int64_t i = 1; i <= 25; ++i) {
+        cib.addChange(i * 100'000'007, 1000);
+        cib.addChange(-i * 3'000'017, static_cast<uint32_t>(i * 37));
+    }
+    cib.finalizeBlock();
+    return cib;
+}
+
 } // namespace
 
 TEST_CASE("block_encode_and_skip") {
@@ -113,3 +147,184 @@ TEST_CASE("block_encode_and_decode") {
     REQUIRE(cib.changeAtBlockheights()[0] == buv::ChangeAtBlockheight(93888, 123457));
     REQUIRE(cib.changeAtBlockheights()[1] == buv::ChangeAtBlockheight(94888, 123457));
 }
+
+TEST_CASE("block_encode_formats") {
+    static constexpr auto formats = std::array{
+        buv::BlkFormat::varint, buv::BlkFormat::streamVByte, buv::BlkFormat::golombRice, buv::BlkFormat::varintRle};
+    auto rng = ankerl::nanobench::Rng(987);
+    auto cib = buv::ChangesInBlock();
+    auto data = std::string();
+    auto expected = std::vector<buv::ChangesInBlock>();
+
+    for (uint32_t blockHeight = 600000; blockHeight < 600050; ++blockHeight) {
+        auto& bd = cib.beginBlock(blockHeight);
+        makeBlockData(static_cast<int>(blockHeight % 10), bd);
+        bd.blockHeight = blockHeight;
+
+        auto numChanges = rng.bounded(2000);
+        for (uint32_t i = 0; i < numChanges; ++i) {
+            auto satoshi = static_cast<int64_t>(rng() >> rng.bounded(64) >> 1);
+            auto spentBlockHeight = rng.bounded(blockHeight + 1);
+
+            // some spam with identical changes
+            auto numRepeats = rng.bounded(10) == 0 ? 1 + rng.bounded(300) : 1;
+            for (uint32_t r = 0; r < numRepeats; ++r) {
+                if (satoshi % 3 == 0) {
+                    cib.addChange(satoshi, blockHeight);
+                } else {
+                    cib.addChange(-satoshi, spentBlockHeight);
+                }
+            }
+        }
+        cib.finalizeBlock();
+        expected.push_back(cib);
+
+        // mix all formats in one file
+        data += cib.encode(formats[blockHeight % formats.size()]);
+    }
+
+    auto const* ptr = data.data();
+    for (auto const& exp : expected) {
+        REQUIRE(ptr[3] == static_cast<char>(formats[exp.blockData().blockHeight % formats.size()]));
+        auto [decoded, nextPtr] = buv::ChangesInBlock::decode(ptr);
+        REQUIRE(decoded.blockData() == exp.blockData());
+        REQUIRE(decoded.changeAtBlockheights() == exp.changeAtBlockheights());
+        auto numUtxo = size_t();
+        for (auto const& change : exp.changeAtBlockheights()) {
+            numUtxo += change.count();
+        }
+        REQUIRE(decoded.numUtxoCreated() + decoded.numUtxoDestroyed() == numUtxo);
+        REQUIRE(buv::ChangesInBlock::skip(ptr).second == nextPtr);
+        ptr = nextPtr;
+    }
+    REQUIRE(ptr == data.data() + data.size());
+
+    REQUIRE(buv::parseBlkFormat("streamvbyte") == buv::BlkFormat::streamVByte);
+    REQUIRE(buv::parseBlkFormat("golombrice") == buv::BlkFormat::golombRice);
+    REQUIRE(buv::parseBlkFormat("varintrle") == buv::BlkFormat::varintRle);
+    REQUIRE_THROWS((void)buv::parseBlkFormat("asdf"));
+}
+
+TEST_CASE("block_encode_counts") {
+    auto cib = buv::ChangesInBlock();
+    (void)cib.beginBlock(1000);
+    for (int i = 0; i < 100; ++i) {
+        cib.addChange(546, 1000);
+        cib.addChange(-1000, 10);
+    }
+    cib.addChange(-1000, 11);
+    cib.addChange(-7, 12);
+    cib.addChange(-7, 12);
+    cib.addChange(5000, 1000);
+    cib.finalizeBlock();
+
+    auto expected = std::vector<buv::ChangeAtBlockheight>{
+        {-1000, 10, 100}, {-1000, 11}, {-7, 12, 2}, {546, 1000, 100}, {5000, 1000}};
+    REQUIRE(cib.changeAtBlockheights() == expected);
+
+    // columns, split into spent and created
+    REQUIRE(cib.numChanges() == 5);
+    REQUIRE(cib.spent().size() == 3);
+    REQUIRE(cib.created().size() == 2);
+    REQUIRE(cib.spent()[2] == buv::ChangeAtBlockheight(-7, 12, 2));
+    REQUIRE(cib.created()[0] == buv::ChangeAtBlockheight(546, 1000, 100));
+    REQUIRE(cib.changes().satoshis[4] == 5000);
+    REQUIRE(cib.changes().count(3) == 100);
+    REQUIRE(cib.changes().count(1) == 1);
+    REQUIRE(cib.changes().runs.size() == 3);
+    REQUIRE(cib.created().runs.size() == 1);
+    REQUIRE(cib.created().count(0) == 100);
+    REQUIRE(cib.created().count(1) == 1);
+
+    auto varint = cib.encode(buv::BlkFormat::varint);
+    auto rle = cib.encode(buv::BlkFormat::varintRle);
+    REQUIRE(rle.size() + 250 < varint.size());
+
+    for (auto const& data : {varint, rle, cib.encode(buv::BlkFormat::streamVByte), cib.encode(buv::BlkFormat::golombRice)}) {
+        auto [decoded, nextPtr] = buv::ChangesInBlock::decode(data.data());
+        REQUIRE(nextPtr == data.data() + data.size());
+        REQUIRE(decoded.changeAtBlockheights() == expected);
+        REQUIRE(decoded.spent().size() == 3);
+        REQUIRE(decoded.numUtxoCreated() == 101);
+        REQUIRE(decoded.numUtxoDestroyed() == 103);
+    }
+}
+
+TEST_CASE("block_encode_into") {
+    auto cibs = makeTwoBlocks();
+
+    // frames are appended, and the buffer's capacity is reused
+    auto data = std::string("xyz");
+    cibs[0].encodeInto(data, buv::BlkFormat::varintRle);
+    cibs[1].encodeInto(data, buv::BlkFormat::golombRice);
+    REQUIRE(data == "xyz" + cibs[0].encode(buv::BlkFormat::varintRle) + cibs[1].encode(buv::BlkFormat::golombRice));
+
+    auto const* ptr = data.data() + 3;
+    for (auto const& cib : cibs) {
+        auto [decoded, nextPtr] = buv::ChangesInBlock::decode(ptr);
+        REQUIRE(decoded.changeAtBlockheights() == cib.changeAtBlockheights());
+        ptr = nextPtr;
+    }
+    REQUIRE(ptr == data.data() + data.size());
+
+    data.clear();
+    cibs[0].encodeInto(data);
+    auto const* buffer = data.data();
+    data.clear();
+    cibs[0].encodeInto(data);
+    REQUIRE(data.data() == buffer);
+}
+
+TEST_CASE("block_decode_stream_vbyte_corrupt") {
+    auto frame = makeMixedBlock().encode(buv::BlkFormat::streamVByte);
+    REQUIRE(buv::ChangesInBlock::decode(frame.data()).first.numChanges() == 50);
+
+    // each of the last bytes is part of a column
+    for (size_t numCut = 1; numCut < 40; ++numCut) {
+        auto data = truncated(frame, numCut);
+        REQUIRE_THROWS((void)buv::ChangesInBlock::decode(data.data()));
+    }
+
+    // num_changes, num_spent, amount, amount_bytes, then the columns
+    auto moreSpentThanChanges = frameWithTransactions(buv::BlkFormat::streamVByte, std::string("\x02\x05\x02\x02\x00\x00", 6));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(moreSpentThanChanges.data()));
+    auto amountBytesTooLarge = frameWithTransactions(buv::BlkFormat::streamVByte, std::string("\x03\x01\x02\x7f\x00\x00", 6));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(amountBytesTooLarge.data()));
+    auto tooManyChanges = frameWithTransactions(buv::BlkFormat::streamVByte, std::string("\xff\xff\x7f\x00\x02\x02\x00\x00", 8));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(tooManyChanges.data()));
+
+    // amount column claims the bytes of the block column
+    auto amountIntoBlocks = frameWithTransactions(buv::BlkFormat::streamVByte, std::string("\x02\x01\x02\x01\x00\x00", 6));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(amountIntoBlocks.data()));
+    auto valid = frameWithTransactions(buv::BlkFormat::streamVByte, std::string("\x02\x01\x01\x02\x00\x05\x00\x04", 8));
+    auto [cib, ptr] = buv::ChangesInBlock::decode(valid.data());
+    REQUIRE(ptr == valid.data() + valid.size());
+    REQUIRE(cib.changeAtBlockheights() == std::vector<buv::ChangeAtBlockheight>{{-1, 2}, {4, 1000}});
+}
+
+TEST_CASE("block_decode_golomb_rice_corrupt") {
+    auto frame = makeMixedBlock().encode(buv::BlkFormat::golombRice);
+    REQUIRE(buv::ChangesInBlock::decode(frame.data()).first.numChanges() == 50);
+
+    // the bit stream is longer than that, and its last byte holds at least one bit of the last value
+    for (size_t numCut = 1; numCut < 40; ++numCut) {
+        auto data = truncated(frame, numCut);
+        REQUIRE_THROWS((void)buv::ChangesInBlock::decode(data.data()));
+    }
+
+    // num_changes, num_spent, amount, k_amount, k_block, then the bit stream
+    auto moreSpentThanChanges = frameWithTransactions(buv::BlkFormat::golombRice, std::string("\x02\x05\x01\x00\x00\x00", 6));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(moreSpentThanChanges.data()));
+    auto missingK = frameWithTransactions(buv::BlkFormat::golombRice, std::string("\x02\x01\x01\x00", 4));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(missingK.data()));
+    auto kTooLarge = frameWithTransactions(buv::BlkFormat::golombRice, std::string("\x02\x01\x01\x40\x00\x00", 6));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(kTooLarge.data()));
+    auto tooManyChanges = frameWithTransactions(buv::BlkFormat::golombRice, std::string("\xff\xff\x7f\x00\x01\x00\x00\x00", 8));
+    REQUIRE_THROWS((void)buv::ChangesInBlock::decode(tooManyChanges.data()));
+
+    // amount diff 5 with k=2: q=1 => bits 1,0 then 01. Block diff 4 with k=0: q=4 => bits 1,1,1,1,0. LSB first.
+    auto valid = frameWithTransactions(buv::BlkFormat::golombRice, std::string("\x02\x01\x01\x02\x00\xf5\x00", 7));
+    auto [cib, ptr] = buv::ChangesInBlock::decode(valid.data());
+    REQUIRE(ptr == valid.data() + valid.size());
+    REQUIRE(cib.changeAtBlockheights() == std::vector<buv::ChangeAtBlockheight>{{-1, 2}, {4, 1000}});
+}
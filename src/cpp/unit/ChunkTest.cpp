@@ -99,4 +99,29 @@ TEST_CASE("chunk_random") {
     }
 }
 
+TEST_CASE("chunk_insert_sorted") {
+    auto chunkStore = buv::ChunkStore();
+
+    buv::Chunk* root = nullptr;
+    for (uint16_t vout : {5, 1, 9, 3, 0, 7}) {
+        root = chunkStore.insertSorted(vout, vout * 1000, root);
+    }
+
+    // list is sorted, so removeAllSorted works
+    auto removed = std::vector<int64_t>();
+    root = chunkStore.removeAllSorted({0, 3, 9}, root, [&](int64_t satoshi) {
+        removed.push_back(satoshi);
+    });
+    REQUIRE(removed == std::vector<int64_t>{0, 3000, 9000});
+
+    auto vouts = std::vector<uint16_t>();
+    for (auto const* c = root; c != nullptr; c = c->next()) {
+        vouts.push_back(c->voutSatoshi().vout());
+    }
+    REQUIRE(vouts == std::vector<uint16_t>{1, 5, 7});
+
+    chunkStore.removeAll(root);
+    REQUIRE(chunkStore.numAllocatedChunks() == chunkStore.numFreeChunks());
+}
+
 static_assert(sizeof(buv::Chunk) == 16);
@@ -0,0 +1,150 @@
+#include <app/CompactUtxo.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <filesystem>
+#include <map>
+#include <optional>
+
+namespace {
+
+auto makeTxId(uint64_t n) -> buv::TxIdPrefix {
+    auto txid = buv::TxIdPrefix();
+    std::memcpy(txid.data(), &n, sizeof(n));
+    return txid;
+}
+
+} // namespace
+
+TEST_CASE("compact_utxo_random") {
+    auto dir = std::filesystem::temp_directory_path() / "buv_compact_utxo_test";
+    auto rng = ankerl::nanobench::Rng(123);
+
+    // reference: txid -> (blockHeight, amounts). Spent amounts are std::nullopt.
+    auto reference = std::map<uint64_t, std::pair<uint32_t, std::vector<std::optional<int64_t>>>>();
+
+    {
+        auto utxo = buv::CompactUtxo(dir, 1000);
+        auto nextTxId = uint64_t();
+
+        for (uint32_t blockHeight = 0; blockHeight < 300; ++blockHeight) {
+            // add a few transactions
+            auto numTx = rng.bounded(10) + 1;
+            for (uint32_t i = 0; i < numTx; ++i) {
+                auto satoshi = std::vector<int64_t>(rng.bounded(20) + 1);
+                auto& ref = reference[nextTxId];
+                ref.first = blockHeight;
+                for (auto& sat : satoshi) {
+                    sat = static_cast<int64_t>(rng.bounded(1'000'000));
+                    ref.second.emplace_back(sat);
+                }
+                utxo.insert(makeTxId(nextTxId), blockHeight, satoshi);
+                ++nextTxId;
+            }
+
+            // spend a few vouts of random transactions
+            for (int i = 0; i < 5 && !reference.empty(); ++i) {
+                auto it = reference.lower_bound(rng.bounded(static_cast<uint32_t>(nextTxId)));
+                if (it == reference.end()) {
+                    it = reference.begin();
+                }
+                auto& [refBlockHeight, refAmounts] = it->second;
+
+                auto vouts = std::vector<uint16_t>();
+                for (uint16_t vout = 0; vout < refAmounts.size(); ++vout) {
+                    if (refAmounts[vout] && rng.bounded(2) == 0) {
+                        vouts.push_back(vout);
+                    }
+                }
+
+                auto numCalls = size_t();
+                utxo.removeAllSorted(makeTxId(it->first), vouts, [&](int64_t satoshi, uint32_t bh) {
+                    REQUIRE(bh == refBlockHeight);
+                    REQUIRE(refAmounts[vouts[numCalls]] == satoshi);
+                    refAmounts[vouts[numCalls]].reset();
+                    ++numCalls;
+                });
+                REQUIRE(numCalls == vouts.size());
+
+                if (std::none_of(refAmounts.begin(), refAmounts.end(), [](auto const& a) {
+                        return a.has_value();
+                    })) {
+                    reference.erase(it);
+                }
+            }
+
+            REQUIRE(utxo.map().size() == reference.size());
+        }
+
+        // spending a vout twice is an error
+        auto const& [txid, data] = *reference.begin();
+        auto spent = std::vector<uint16_t>{0};
+        if (data.second[0]) {
+            utxo.removeAllSorted(makeTxId(txid), spent, [](int64_t /*satoshi*/, uint32_t /*blockHeight*/) {});
+        }
+        REQUIRE_THROWS(utxo.removeAllSorted(makeTxId(txid), spent, [](int64_t /*satoshi*/, uint32_t /*blockHeight*/) {}));
+
+        // unknown txid
+        REQUIRE_THROWS(utxo.removeAllSorted(makeTxId(nextTxId), spent, [](int64_t /*satoshi*/, uint32_t /*blockHeight*/) {}));
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("compact_utxo_segments") {
+    auto dir = std::filesystem::temp_directory_path() / "buv_compact_utxo_segments_test";
+    {
+        auto utxo = buv::CompactUtxo(dir);
+
+        // 3 full segments of 2^16 vouts and a bit, 2 vouts per transaction
+        auto numTx = uint64_t(100'000);
+        for (uint64_t tx = 0; tx < numTx; ++tx) {
+            utxo.insert(makeTxId(tx), static_cast<uint32_t>(tx / 1000), {static_cast<int64_t>(tx), static_cast<int64_t>(tx + 1)});
+        }
+        REQUIRE(utxo.numLiveVoutSegments() == 4);
+
+        // spending everything of the first two segments frees them
+        auto both = std::vector<uint16_t>{0, 1};
+        for (uint64_t tx = 0; tx < 65536; ++tx) {
+            auto expected = static_cast<int64_t>(tx);
+            utxo.removeAllSorted(makeTxId(tx), both, [&](int64_t satoshi, uint32_t blockHeight) {
+                REQUIRE(satoshi == expected++);
+                REQUIRE(blockHeight == tx / 1000);
+            });
+        }
+        REQUIRE(utxo.numLiveVoutSegments() == 2);
+        REQUIRE(utxo.map().size() == numTx - 65536);
+
+        // the other transactions still have their amounts
+        for (uint64_t tx = 65536; tx < numTx; tx += 1111) {
+            auto expected = static_cast<int64_t>(tx + 1);
+            utxo.removeAllSorted(makeTxId(tx), {1}, [&](int64_t satoshi, uint32_t /*blockHeight*/) {
+                REQUIRE(satoshi == expected);
+            });
+        }
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("compact_utxo_duplicate_txid") {
+    auto dir = std::filesystem::temp_directory_path() / "buv_compact_utxo_duplicate_test";
+    {
+        auto utxo = buv::CompactUtxo(dir);
+        utxo.insert(makeTxId(1), 91722, {50});
+        utxo.insert(makeTxId(2), 91800, {10, 20});
+        REQUIRE_THROWS(utxo.insert(makeTxId(2), 91801, {30}));
+
+        // BIP30: the duplicate coinbase replaces the old one
+        utxo.insert(makeTxId(1), 91880, {60, 70});
+        REQUIRE(utxo.map().size() == 2);
+        auto sum = int64_t();
+        utxo.removeAllSorted(makeTxId(1), {0, 1}, [&](int64_t satoshi, uint32_t blockHeight) {
+            REQUIRE(blockHeight == 91880);
+            sum += satoshi;
+        });
+        REQUIRE(sum == 130);
+        REQUIRE(utxo.map().size() == 1);
+    }
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,210 @@
+#include <app/BlkWriter.h>
+#include <app/CompressedBlk.h>
+#include <app/forEachChange.h>
+
+#include <doctest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+TEST_CASE("compressed_blk") {
+    auto filename = std::filesystem::temp_directory_path() / "buv_compressed_blk_test.blkz";
+
+    // 100 blocks in groups of 16, mixed formats
+    auto expected = std::vector<buv::ChangesInBlock>();
+    {
+        auto writer = buv::CompressedBlkWriter(filename, 16);
+        auto cib = buv::ChangesInBlock();
+        auto frames = std::string();
+        auto firstBlockHeight = uint32_t();
+        for (uint32_t blockHeight = 0; blockHeight < 100; ++blockHeight) {
+            (void)cib.beginBlock(blockHeight);
+            for (uint32_t i = 0; i <= blockHeight; ++i) {
+                cib.addChange(546, blockHeight);
+                cib.addChange(-static_cast<int64_t>(100'000 * i), i);
+            }
+            cib.finalizeBlock();
+            expected.push_back(cib);
+            frames += cib.encode(blockHeight % 2 == 0 ? buv::BlkFormat::varint : buv::BlkFormat::streamVByte);
+
+            if (blockHeight - firstBlockHeight + 1 == 16 || blockHeight == 99) {
+                writer.append(firstBlockHeight,
+                              blockHeight - firstBlockHeight + 1,
+                              static_cast<uint32_t>(frames.size()),
+                              buv::compressGroup(frames, 3));
+                frames.clear();
+                firstBlockHeight = blockHeight + 1;
+            }
+        }
+
+        // must continue at block 100
+        REQUIRE_THROWS(writer.append(0, 1, 0, std::string()));
+        writer.finish();
+    }
+
+    {
+        auto blk = buv::CompressedBlk(filename);
+        REQUIRE(buv::CompressedBlk::isCompressed(util::Mmap(filename)));
+        REQUIRE(blk.numBlocks() == 100);
+        REQUIRE(blk.groups().size() == 7);
+        REQUIRE(blk.blocksPerGroup() == 16);
+        REQUIRE(blk.groupOf(0) == 0);
+        REQUIRE(blk.groupOf(16) == 1);
+        REQUIRE(blk.groupOf(99) == 6);
+        REQUIRE_THROWS((void)blk.groupOf(100));
+
+        // random access
+        for (uint32_t blockHeight : {0U, 15U, 16U, 57U, 99U}) {
+            REQUIRE(blk.changesAt(blockHeight).changeAtBlockheights() == expected[blockHeight].changeAtBlockheights());
+        }
+
+        // everything, in order
+        auto nextBlockHeight = uint32_t();
+        auto lastCib = buv::forEachChange(
+            blk, 0, util::ResourceId{3}, util::ConcurrentWorkers{2}, [&](buv::ChangesInBlock const& cib) {
+                REQUIRE(cib.changeAtBlockheights() == expected[nextBlockHeight].changeAtBlockheights());
+                ++nextBlockHeight;
+                return true;
+            });
+        REQUIRE(nextBlockHeight == 100);
+        REQUIRE(lastCib.blockData().blockHeight == 99);
+
+        // start in the middle of a group, and stop early
+        nextBlockHeight = 21;
+        lastCib = buv::forEachChange(blk, 21, [&](buv::ChangesInBlock const& cib) {
+            REQUIRE(cib.changeAtBlockheights() == expected[nextBlockHeight].changeAtBlockheights());
+            ++nextBlockHeight;
+            return cib.blockData().blockHeight != 70;
+        });
+        REQUIRE(nextBlockHeight == 71);
+        REQUIRE(lastCib.blockData().blockHeight == 70);
+    }
+
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("compressed_blk_for_each_change_in_file") {
+    auto blkFilename = std::filesystem::temp_directory_path() / "buv_compressed_blk_in_file_test.blk";
+    auto blkzFilename = std::filesystem::temp_directory_path() / "buv_compressed_blk_in_file_test.blkz";
+
+    // the same blocks as plain and as compressed file
+    auto expected = std::vector<buv::ChangesInBlock>();
+    {
+        auto blkWriter = buv::BlkWriter(blkFilename, buv::BlkFormat::varintRle);
+        auto blkzWriter = buv::CompressedBlkWriter(blkzFilename, 8);
+        auto cib = buv::ChangesInBlock();
+        auto frames = std::string();
+        for (uint32_t blockHeight = 0; blockHeight < 50; ++blockHeight) {
+            (void)cib.beginBlock(blockHeight);
+            for (uint32_t i = 0; i <= blockHeight; ++i) {
+                cib.addChange(1000 + i % 3, blockHeight);
+                cib.addChange(-static_cast<int64_t>(7 * i), i);
+            }
+            cib.finalizeBlock();
+            expected.push_back(cib);
+            blkWriter.write(cib);
+            frames += cib.encode(buv::BlkFormat::varintRle);
+            if (blockHeight % 8 == 7 || blockHeight == 49) {
+                blkzWriter.append(blockHeight - blockHeight % 8,
+                                  blockHeight % 8 + 1,
+                                  static_cast<uint32_t>(frames.size()),
+                                  buv::compressGroup(frames, 3));
+                frames.clear();
+            }
+        }
+        blkzWriter.finish();
+    }
+
+    for (auto const& filename : {blkFilename, blkzFilename}) {
+        auto nextBlockHeight = uint32_t(13);
+        auto lastCib = buv::forEachChangeInFile(filename, 13, [&](buv::ChangesInBlock const& cib) {
+            REQUIRE(cib.changeAtBlockheights() == expected[nextBlockHeight].changeAtBlockheights());
+            ++nextBlockHeight;
+            return true;
+        });
+        REQUIRE(nextBlockHeight == 50);
+        REQUIRE(lastCib.blockData().blockHeight == 49);
+    }
+
+    // the plain reader refuses the compressed file with a clear error
+    REQUIRE_THROWS((void)buv::loadOrBuildBlkIndex(blkzFilename, util::Mmap(blkzFilename)));
+
+    std::filesystem::remove(blkFilename);
+    std::filesystem::remove(buv::blkIndexFilename(blkFilename));
+    std::filesystem::remove(blkzFilename);
+}
+
+TEST_CASE("compressed_blk_corrupt_index") {
+    auto filename = std::filesystem::temp_directory_path() / "buv_compressed_blk_corrupt_test.blkz";
+
+    // 2 groups of 4 blocks
+    {
+        auto writer = buv::CompressedBlkWriter(filename, 4);
+        auto cib = buv::ChangesInBlock();
+        auto frames = std::string();
+        for (uint32_t blockHeight = 0; blockHeight < 8; ++blockHeight) {
+            (void)cib.beginBlock(blockHeight);
+            cib.addChange(1000, blockHeight);
+            cib.finalizeBlock();
+            frames += cib.encode(buv::BlkFormat::varint);
+            if (blockHeight % 4 == 3) {
+                writer.append(blockHeight - 3, 4, static_cast<uint32_t>(frames.size()), buv::compressGroup(frames, 3));
+                frames.clear();
+            }
+        }
+        writer.finish();
+    }
+    auto original = std::string();
+    {
+        auto fin = std::ifstream(filename, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    }
+    REQUIRE(buv::CompressedBlk(filename).numBlocks() == 8);
+
+    // index is followed by index_offset, num_groups, "BLKZ"
+    auto indexOffset = original.size() - 16 - 2 * sizeof(buv::CompressedGroup);
+    auto withGroup = [&](size_t groupIdx, auto&& modify) {
+        auto group = buv::CompressedGroup();
+        auto* groupPtr = original.data() + indexOffset + groupIdx * sizeof(buv::CompressedGroup);
+        std::memcpy(&group, groupPtr, sizeof(group));
+        modify(group);
+        auto data = original;
+        std::memcpy(data.data() + (groupPtr - original.data()), &group, sizeof(group));
+        std::ofstream(filename, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+    };
+
+    withGroup(1, [](buv::CompressedGroup& g) {
+        g.fileOffset = 1'000'000'000;
+    });
+    REQUIRE_THROWS((void)buv::CompressedBlk(filename));
+    withGroup(1, [](buv::CompressedGroup& g) {
+        g.compressedSize += 100;
+    });
+    REQUIRE_THROWS((void)buv::CompressedBlk(filename));
+    withGroup(0, [](buv::CompressedGroup& g) {
+        g.fileOffset = 0;
+    });
+    REQUIRE_THROWS((void)buv::CompressedBlk(filename));
+    withGroup(1, [](buv::CompressedGroup& g) {
+        g.firstBlockHeight = 5;
+    });
+    REQUIRE_THROWS((void)buv::CompressedBlk(filename));
+    withGroup(0, [](buv::CompressedGroup& g) {
+        g.firstBlockHeight = 1;
+    });
+    REQUIRE_THROWS((void)buv::CompressedBlk(filename));
+
+    // only noticed when the group is read, but without allocating that much
+    withGroup(0, [](buv::CompressedGroup& g) {
+        g.decompressedSize = 0xffffffff;
+    });
+    auto blk = buv::CompressedBlk(filename);
+    REQUIRE_THROWS((void)blk.changesAt(1));
+    REQUIRE(blk.changesAt(5).blockData().blockHeight == 5);
+
+    std::filesystem::remove(filename);
+}
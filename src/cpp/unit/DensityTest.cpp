@@ -0,0 +1,128 @@
+#include <buv/Density.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+[[nodiscard]] auto densityTestCfg() -> buv::Cfg {
+    auto cfg = buv::Cfg();
+    cfg.imageWidth = 200;
+    cfg.imageHeight = 100;
+    cfg.graphRect = {0, 0, 200, 100};
+    cfg.minSatoshi = 1;
+    cfg.maxSatoshi = 1'000'000'000'000;
+    cfg.colorMap = "viridis";
+    cfg.colorUpperValueLimit = 50;
+    cfg.colorHighlightRGB = {255, 255, 255};
+    return cfg;
+}
+
+} // namespace
+
+// change(), applyBlock(), and applyBlock() with multiple stripes all give the same images
+TEST_CASE("density_apply_block") {
+    auto cfg = densityTestCfg();
+    auto numBlocks = uint32_t(100);
+    cfg.densityNumThreads = 1;
+    auto densityChange = buv::Density(cfg, numBlocks);
+    auto densityApply = buv::Density(cfg, numBlocks);
+
+    // stripes of 15 rows, the last one is smaller. Highlights cross the stripe borders.
+    cfg.densityNumThreads = 7;
+    auto densityStripes = buv::Density(cfg, numBlocks);
+
+    // spend what earlier blocks created, with duplicates, so the densities go up and down
+    auto rng = ankerl::nanobench::Rng(42);
+    auto utxos = std::vector<std::pair<int64_t, uint32_t>>();
+    auto cib = buv::ChangesInBlock();
+    for (uint32_t blockHeight = 0; blockHeight < numBlocks; ++blockHeight) {
+        (void)cib.beginBlock(blockHeight);
+        for (size_t i = 0; i < 300; ++i) {
+            auto satoshi = static_cast<int64_t>(rng.bounded(5) == 0 ? 100'000 : rng() >> rng.bounded(64) >> 24U);
+            if (satoshi == 0) {
+                continue;
+            }
+            cib.addChange(satoshi, blockHeight);
+            utxos.emplace_back(satoshi, blockHeight);
+        }
+        for (size_t i = 0; i < 200 && !utxos.empty(); ++i) {
+            auto idx = rng.bounded(static_cast<uint32_t>(utxos.size()));
+            cib.addChange(-utxos[idx].first, utxos[idx].second);
+            utxos[idx] = utxos.back();
+            utxos.pop_back();
+        }
+        cib.finalizeBlock();
+
+        auto imageChange = std::vector<uint8_t>();
+        densityChange.begin_block(blockHeight);
+        cib.changes().forEach([&](int64_t satoshi, uint32_t blockHeight, uint32_t count) {
+            densityChange.change(blockHeight, satoshi, count);
+        });
+        densityChange.end_block(blockHeight, [&](uint8_t const* data) {
+            imageChange.assign(data, data + cfg.imageWidth * cfg.imageHeight * 3);
+        });
+
+        auto imageApply = std::vector<uint8_t>();
+        densityApply.applyBlock(cib);
+        densityApply.end_block(blockHeight, [&](uint8_t const* data) {
+            imageApply.assign(data, data + cfg.imageWidth * cfg.imageHeight * 3);
+        });
+
+        REQUIRE(imageApply == imageChange);
+
+        auto imageStripes = std::vector<uint8_t>();
+        densityStripes.applyBlock(cib);
+        densityStripes.end_block(blockHeight, [&](uint8_t const* data) {
+            imageStripes.assign(data, data + cfg.imageWidth * cfg.imageHeight * 3);
+        });
+        REQUIRE(imageStripes == imageChange);
+    }
+}
+
+// drawing into the frame and invalidating that region does not change the following frames
+TEST_CASE("density_invalidate") {
+    auto cfg = densityTestCfg();
+    cfg.densityNumThreads = 3;
+    auto numBlocks = uint32_t(100);
+    auto density = buv::Density(cfg, numBlocks);
+    auto densityUntouched = buv::Density(cfg, numBlocks);
+
+    auto rng = ankerl::nanobench::Rng(123);
+    auto cib = buv::ChangesInBlock();
+    for (uint32_t blockHeight = 0; blockHeight < numBlocks; ++blockHeight) {
+        (void)cib.beginBlock(blockHeight);
+        for (size_t i = 0; i < 300; ++i) {
+            cib.addChange(static_cast<int64_t>(rng() >> rng.bounded(64) >> 24U) + 1, blockHeight);
+        }
+        cib.finalizeBlock();
+
+        auto imageUntouched = std::vector<uint8_t>();
+        densityUntouched.applyBlock(cib);
+        densityUntouched.end_block(blockHeight, [&](uint8_t const* data) {
+            imageUntouched.assign(data, data + cfg.imageWidth * cfg.imageHeight * 3);
+        });
+
+        auto image = std::vector<uint8_t>();
+        density.applyBlock(cib);
+        density.end_block(blockHeight, [&](uint8_t* data) {
+            image.assign(data, data + cfg.imageWidth * cfg.imageHeight * 3);
+
+            // some rects reach out of the image
+            for (size_t i = 0; i < 3; ++i) {
+                auto rect = buv::Rect<size_t>{rng.bounded(220), rng.bounded(110), rng.bounded(40), rng.bounded(30)};
+                for (auto y = rect.y; y < std::min(rect.y + rect.h, cfg.imageHeight); ++y) {
+                    for (auto x = rect.x; x < std::min(rect.x + rect.w, cfg.imageWidth); ++x) {
+                        std::fill_n(data + (y * cfg.imageWidth + x) * 3, 3, uint8_t(0xab));
+                    }
+                }
+                density.invalidate(rect);
+            }
+        });
+        REQUIRE(image == imageUntouched);
+    }
+}
@@ -0,0 +1,39 @@
+#include <util/ForkJoin.h>
+
+#include <doctest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("fork_join") {
+    for (size_t numWorkers : {1, 4}) {
+        auto forkJoin = util::ForkJoin(numWorkers);
+        REQUIRE(forkJoin.numWorkers() == numWorkers);
+
+        // each run sees the results of the previous one
+        auto counts = std::vector<size_t>(numWorkers);
+        for (size_t run = 0; run < 1000; ++run) {
+            forkJoin.run([&](size_t workerIdx) {
+                REQUIRE(counts[workerIdx] == run);
+                ++counts[workerIdx];
+            });
+        }
+        for (auto count : counts) {
+            REQUIRE(count == 1000);
+        }
+
+        // an exception in any worker is rethrown, and the workers can still be used afterwards
+        REQUIRE_THROWS_AS(forkJoin.run([&](size_t workerIdx) {
+            if (workerIdx == numWorkers - 1) {
+                throw std::runtime_error("fail");
+            }
+        }),
+                          std::runtime_error);
+        auto numCalls = std::atomic<size_t>();
+        forkJoin.run([&](size_t /*workerIdx*/) {
+            ++numCalls;
+        });
+        REQUIRE(numCalls == numWorkers);
+    }
+}
@@ -0,0 +1,72 @@
+#include <buv/Overlay.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Items that stay in the frame give the same image as drawing everything again
+TEST_CASE("overlay") {
+    auto width = size_t(30);
+    auto height = size_t(12);
+    auto changingArea = buv::Rect<size_t>{0, 0, 30, 6};
+    auto background = std::array<uint8_t, 3>{7, 8, 9};
+
+    // 3x2 block, and a 1x1 dot with partial coverage
+    auto blockCoverage = std::vector<uint8_t>(6, 255);
+    auto block = buv::AlphaMask(blockCoverage.data(), 3, 2, 0, -1);
+    auto dotCoverage = std::vector<uint8_t>{100};
+    auto dot = buv::AlphaMask(dotCoverage.data(), 1, 1, 0, 0);
+    auto atlas = buv::GlyphAtlas();
+    atlas.set('a', buv::AlphaMask(blockCoverage.data(), 2, 3, 0, -2), 3);
+    atlas.set('b', buv::AlphaMask(dotCoverage.data(), 1, 1, 0, 0), 2);
+
+    // like the density image: only the changing area changes, the rest is background
+    auto image = std::vector<uint8_t>(width * height * 3);
+    for (size_t i = 0; i < image.size(); ++i) {
+        image[i] = background[i % 3];
+    }
+    auto frame = image;
+    auto overlay = buv::Overlay(atlas, changingArea, background);
+
+    auto rng = ankerl::nanobench::Rng(7);
+    auto addItems = [&](buv::Overlay& o, size_t frameNr) {
+        // fixed
+        o.mask(block, 1, 10);
+        o.text(10, 11, "abba");
+
+        // slowly moving, sometimes across the border of the changing area
+        auto x = static_cast<int>(frameNr / 3 % 25);
+        o.mask(dot, x, 8);
+        o.mask(block, x, static_cast<int>(frameNr / 5 % 10));
+        if (frameNr % 7 < 3) {
+            o.textMono(x, 9, "ab", 4);
+        }
+    };
+
+    for (size_t frameNr = 0; frameNr < 200; ++frameNr) {
+        // the changing area changes, and the drawn over regions are restored
+        for (size_t i = 0; i < changingArea.h * width * 3; ++i) {
+            image[i] = static_cast<uint8_t>(rng());
+        }
+        std::copy_n(image.begin(), changingArea.h * width * 3, frame.begin());
+        for (auto const& rect : overlay.drawnRects()) {
+            for (auto y = rect.y; y < rect.y + rect.h; ++y) {
+                auto offset = static_cast<ptrdiff_t>((y * width + rect.x) * 3);
+                std::copy_n(image.begin() + offset, rect.w * 3, frame.begin() + offset);
+            }
+        }
+        addItems(overlay, frameNr);
+        overlay.draw(frame.data(), width, height);
+
+        auto expected = image;
+        auto fresh = buv::Overlay(atlas, changingArea, background);
+        addItems(fresh, frameNr);
+        fresh.draw(expected.data(), width, height);
+        REQUIRE(frame == expected);
+    }
+}
@@ -0,0 +1,79 @@
+#include <buv/PixelSet.h>
+#include <buv/PixelSetWithHistory.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+TEST_CASE("pixel_set") {
+    auto rng = ankerl::nanobench::Rng(1);
+    auto offset = size_t(1000);
+    auto ps = buv::PixelSet(500, offset);
+
+    // more clears than the epoch has values
+    for (size_t block = 0; block < 600; ++block) {
+        auto expected = std::set<size_t>();
+        for (size_t i = 0; i < 20; ++i) {
+            auto pixel_idx = offset + rng.bounded(500);
+            ps.insert(pixel_idx);
+            expected.insert(pixel_idx);
+        }
+        auto actual = std::vector<size_t>(ps.begin(), ps.end());
+        std::sort(actual.begin(), actual.end());
+        REQUIRE(actual == std::vector<size_t>(expected.begin(), expected.end()));
+        for (size_t pixel_idx = offset; pixel_idx < offset + 500; ++pixel_idx) {
+            REQUIRE(ps.contains(pixel_idx) == (expected.count(pixel_idx) == 1));
+        }
+        ps.clear();
+        REQUIRE(ps.size() == 0);
+    }
+}
+
+TEST_CASE("pixel_set_with_history") {
+    auto rng = ankerl::nanobench::Rng(2);
+    auto offset = size_t(100);
+    auto maxHistory = size_t(50);
+    auto ps = buv::PixelSetWithHistory(300, maxHistory, offset);
+
+    // reference: pixel_idx -> blockheight
+    auto expected = std::map<size_t, uint32_t>();
+    for (uint32_t blockHeight = 0; blockHeight < 2000; ++blockHeight) {
+        if (rng.bounded(100) == 0) {
+            // jump ahead, like when blocks are skipped
+            blockHeight += rng.bounded(500);
+        }
+        for (size_t i = 0; i < 10; ++i) {
+            auto pixel_idx = offset + rng.bounded(300);
+            auto pixelBlockHeight = blockHeight - std::min<uint32_t>(blockHeight, rng.bounded(3) * 8);
+            ps.insert(pixelBlockHeight, pixel_idx);
+            auto& h = expected.try_emplace(pixel_idx, pixelBlockHeight).first->second;
+            h = std::max(h, pixelBlockHeight);
+        }
+
+        ps.age(blockHeight);
+        for (auto it = expected.begin(); it != expected.end();) {
+            if (it->second + maxHistory < blockHeight) {
+                it = expected.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto actual = std::map<size_t, uint32_t>();
+        ps.forEach([&](uint32_t pixelBlockHeight, size_t pixel_idx) {
+            REQUIRE(actual.emplace(pixel_idx, pixelBlockHeight).second);
+        });
+        REQUIRE(actual == expected);
+        REQUIRE(ps.size() == expected.size());
+    }
+
+    ps.clear();
+    REQUIRE(ps.size() == 0);
+    ps.forEach([&](uint32_t /*pixelBlockHeight*/, size_t /*pixel_idx*/) {
+        REQUIRE(false);
+    });
+}
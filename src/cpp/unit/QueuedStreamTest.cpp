@@ -0,0 +1,165 @@
+#include <buv/QueuedStream.h>
+
+#include <doctest.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Collects the writes. Each write waits until it is allowed, like a slow consumer.
+class GatedStream final : public buv::SocketStream {
+    std::mutex mMutex{};
+    std::condition_variable mCondition{};
+    size_t mNumAllowed;
+    std::vector<std::string> mWrites{};
+    size_t mNumEntered = 0;
+    size_t mNumFlushes = 0;
+
+public:
+    explicit GatedStream(size_t numAllowed)
+        : mNumAllowed(numAllowed) {}
+
+    void write(uint8_t const* data, size_t size) override {
+        auto lock = std::unique_lock(mMutex);
+        ++mNumEntered;
+        mCondition.notify_all();
+        mCondition.wait(lock, [this] {
+            return mWrites.size() < mNumAllowed;
+        });
+        if (size == 0) {
+            throw std::runtime_error("empty");
+        }
+        mWrites.emplace_back(reinterpret_cast<char const*>(data), size);
+        mCondition.notify_all();
+    }
+
+    void flush() override {
+        auto lock = std::lock_guard(mMutex);
+        ++mNumFlushes;
+    }
+
+    [[nodiscard]] auto numFlushes() -> size_t {
+        auto lock = std::lock_guard(mMutex);
+        return mNumFlushes;
+    }
+
+    void allow(size_t numAllowed) {
+        {
+            auto lock = std::lock_guard(mMutex);
+            mNumAllowed = numAllowed;
+        }
+        mCondition.notify_all();
+    }
+
+    // waits until numWrites have started
+    void waitForEntered(size_t numWrites) {
+        auto lock = std::unique_lock(mMutex);
+        mCondition.wait(lock, [&] {
+            return mNumEntered >= numWrites;
+        });
+    }
+
+    // waits until numWrites are done
+    void waitFor(size_t numWrites) {
+        auto lock = std::unique_lock(mMutex);
+        mCondition.wait(lock, [&] {
+            return mWrites.size() >= numWrites;
+        });
+    }
+
+    [[nodiscard]] auto writes() -> std::vector<std::string> {
+        auto lock = std::lock_guard(mMutex);
+        return mWrites;
+    }
+};
+
+void write(buv::QueuedStream& stream, std::string const& str) {
+    stream.write(reinterpret_cast<uint8_t const*>(str.data()), str.size());
+}
+
+} // namespace
+
+TEST_CASE("queued_stream_block") {
+    auto out = std::make_unique<GatedStream>(1000);
+    auto* gated = out.get();
+    auto stream = buv::QueuedStream(std::move(out), 3, buv::QueuedStream::Policy::block);
+
+    // the data is copied, so it can be changed right away
+    auto str = std::string();
+    for (size_t i = 0; i < 100; ++i) {
+        str = "frame " + std::to_string(i);
+        write(stream, str);
+        str = "changed";
+    }
+    stream.flush();
+
+    auto writes = gated->writes();
+    REQUIRE(writes.size() == 100);
+    REQUIRE(gated->numFlushes() == 1);
+    for (size_t i = 0; i < writes.size(); ++i) {
+        REQUIRE(writes[i] == "frame " + std::to_string(i));
+    }
+    auto report = stream.report();
+    REQUIRE(report.find("queue 0/3") == 0);
+    REQUIRE(report.find("100 sent, 0 dropped") != std::string::npos);
+
+    // starts over
+    REQUIRE(stream.report().find("queue 0/3 (max 0), 0 sent, 0 dropped") == 0);
+}
+
+TEST_CASE("queued_stream_drop") {
+    auto out = std::make_unique<GatedStream>(0);
+    auto* gated = out.get();
+    auto stream = buv::QueuedStream(std::move(out), 2, buv::QueuedStream::Policy::drop);
+
+    // nothing is sent yet, so only the first 2 frames fit
+    for (size_t i = 0; i < 5; ++i) {
+        write(stream, std::to_string(i));
+    }
+    REQUIRE(stream.report().find("queue 2/2 (max 2), 0 sent, 3 dropped") == 0);
+
+    gated->allow(1);
+    gated->waitFor(1);
+    write(stream, "5");
+    gated->allow(1000);
+    stream.flush();
+    REQUIRE(gated->writes() == std::vector<std::string>{"0", "1", "5"});
+}
+
+TEST_CASE("queued_stream_error") {
+    auto stream = buv::QueuedStream(std::make_unique<GatedStream>(1000), 2, buv::QueuedStream::Policy::block);
+    write(stream, "");
+    REQUIRE_THROWS(stream.flush());
+
+    // the error is reported once, then the stream can be used again
+    write(stream, "a");
+    stream.flush();
+}
+
+TEST_CASE("queued_stream_abandon") {
+    auto out = std::make_unique<GatedStream>(0);
+    auto* gated = out.get();
+    auto stream = buv::QueuedStream(std::move(out), 3, buv::QueuedStream::Policy::block);
+    for (size_t i = 0; i < 3; ++i) {
+        write(stream, std::to_string(i));
+    }
+    gated->waitForEntered(1);
+
+    // "0" is stuck in the consumer, the others are dropped, and so is everything written afterwards
+    stream.abandon();
+    write(stream, "3");
+    auto report = stream.report();
+
+    // let the consumer go before a failing REQUIRE would wait for it forever
+    gated->allow(1000);
+    REQUIRE(report.find("queue 1/3 (max 3), 0 sent, 3 dropped") == 0);
+    stream.flush();
+    REQUIRE(stream.report().find("queue 0/3 (max 1), 1 sent, 0 dropped") == 0);
+    REQUIRE(gated->writes() == std::vector<std::string>{"0"});
+}
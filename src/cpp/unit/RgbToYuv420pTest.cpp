@@ -0,0 +1,73 @@
+#include <buv/RgbToYuv420p.h>
+#include <buv/Yuv420pStream.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("rgb_to_yuv420p") {
+    // white, black, red, and a 2x2 block of mixed colors
+    auto rgb = std::vector<uint8_t>{
+        255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 255, 0, 0, 255, 0, 0, 10, 20, 30, 40, 50, 60, //
+        255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 255, 0, 0, 255, 0, 0, 70, 80, 90, 100, 110, 121, //
+    };
+    auto yuv = std::vector<uint8_t>(buv::yuv420pSize(8, 2));
+    buv::rgbToYuv420p(rgb.data(), 8, 2, yuv.data());
+    REQUIRE(yuv == std::vector<uint8_t>{235, 235, 16, 16, 82, 82, 32, 57, //
+                                        235, 235, 16, 16, 82, 82, 83, 109, //
+                                        128, 128, 90, 134, //
+                                        128, 128, 240, 123});
+
+    // SIMD and scalar give the same, also for the columns at the end that don't fill a SIMD register
+    auto rng = ankerl::nanobench::Rng(1234);
+    for (auto [width, height] : {std::pair<size_t, size_t>{64, 4}, {50, 6}, {2, 2}, {130, 10}}) {
+        rgb.resize(width * height * 3);
+        for (auto& val : rgb) {
+            val = static_cast<uint8_t>(rng());
+        }
+        auto simd = std::vector<uint8_t>(buv::yuv420pSize(width, height));
+        auto scalar = simd;
+        buv::rgbToYuv420p(rgb.data(), width, height, simd.data());
+        buv::rgbToYuv420pScalar(rgb.data(), width, height, scalar.data());
+        REQUIRE(simd == scalar);
+    }
+}
+
+namespace {
+
+class StringStream final : public buv::SocketStream {
+    std::string& mOut;
+
+public:
+    explicit StringStream(std::string& out)
+        : mOut(out) {}
+
+    void write(uint8_t const* data, size_t size) override {
+        mOut.append(reinterpret_cast<char const*>(data), size);
+    }
+};
+
+} // namespace
+
+TEST_CASE("yuv420p_stream") {
+    auto out = std::string();
+    auto stream = buv::Yuv420pStream(std::make_unique<StringStream>(out), 4, 2, 60);
+    auto rgb = std::vector<uint8_t>(4 * 2 * 3, 255);
+    stream.write(rgb.data(), rgb.size());
+    std::fill(rgb.begin(), rgb.end(), uint8_t(0));
+    stream.write(rgb.data(), rgb.size());
+    stream.flush();
+
+    auto white = std::string(8, '\xeb') + std::string(4, '\x80');
+    auto black = std::string(8, '\x10') + std::string(4, '\x80');
+    REQUIRE(out == "YUV4MPEG2 W4 H2 F60:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\nFRAME\n" + white + "FRAME\n" + black);
+
+    REQUIRE_THROWS(stream.write(rgb.data(), rgb.size() - 1));
+    REQUIRE_THROWS(buv::Yuv420pStream(std::make_unique<StringStream>(out), 3, 2, 60));
+}
@@ -0,0 +1,65 @@
+#include <buv/SatoshiBlockheightToPixel.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+void requireSameSatoshiPixel(buv::SatoshiBlockheightToPixel const& sbp, int64_t satoshi) {
+    REQUIRE(sbp.satoshiToPixelHeight(satoshi) == sbp.satoshiToPixelHeightByLog(satoshi));
+    REQUIRE(sbp.satoshiToPixelHeight(-satoshi) == sbp.satoshiToPixelHeightByLog(-satoshi));
+}
+
+} // namespace
+
+TEST_CASE("satoshi_blockheight_to_pixel") {
+    auto cfg = buv::Cfg();
+    cfg.graphRect = {0, 10, 3720, 2072};
+    cfg.minSatoshi = 1;
+    cfg.maxSatoshi = 1'000'000'000'000;
+    auto numBlocks = uint32_t(700'000);
+    auto sbp = buv::SatoshiBlockheightToPixel(cfg, numBlocks);
+
+    // all small amounts, and every amount around each power of two
+    for (int64_t satoshi = 1; satoshi < 100'000; ++satoshi) {
+        requireSameSatoshiPixel(sbp, satoshi);
+    }
+    for (int shift = 0; shift < 63; ++shift) {
+        auto pow2 = int64_t(1) << shift;
+        for (int64_t d = -3; d <= 3; ++d) {
+            if (pow2 + d > 0) {
+                requireSameSatoshiPixel(sbp, pow2 + d);
+            }
+        }
+    }
+    requireSameSatoshiPixel(sbp, std::numeric_limits<int64_t>::max());
+    REQUIRE(sbp.satoshiToPixelHeight(std::numeric_limits<int64_t>::min()) == cfg.graphRect.y);
+
+    // log-uniform over the whole int64 range, and around the row boundaries
+    auto rng = ankerl::nanobench::Rng(1234);
+    for (size_t i = 0; i < 1'000'000; ++i) {
+        auto satoshi = static_cast<int64_t>(rng() >> rng.bounded(64) >> 1U);
+        requireSameSatoshiPixel(sbp, satoshi);
+    }
+    for (uint32_t y = 1; y < cfg.graphRect.h - 1; ++y) {
+        // a fractional part of the row boundary amount is between two integers
+        auto boundary = static_cast<int64_t>(std::exp((static_cast<double>(y) - 2072.0) * std::log(1e12) / -2072.0));
+        for (int64_t d = -2; d <= 2; ++d) {
+            requireSameSatoshiPixel(sbp, boundary + d);
+        }
+    }
+
+    // the extremes are clamped
+    REQUIRE(sbp.satoshiToPixelHeight(0) == cfg.graphRect.y + cfg.graphRect.h - 1);
+    REQUIRE(sbp.satoshiToPixelHeight(1) == cfg.graphRect.y + cfg.graphRect.h - 1);
+    REQUIRE(sbp.satoshiToPixelHeight(cfg.maxSatoshi * 10) == cfg.graphRect.y);
+
+    for (uint32_t blockHeight = 0; blockHeight < numBlocks + 1000; ++blockHeight) {
+        REQUIRE(sbp.blockheightToPixelWidth(blockHeight) == sbp.blockheightToPixelWidthByFma(blockHeight));
+    }
+    REQUIRE(sbp.blockheightToPixelWidth(std::numeric_limits<uint32_t>::max()) == cfg.graphRect.w - 1);
+}
@@ -0,0 +1,237 @@
+#include <buv/SharedMemoryRing.h>
+#include <buv/SocketStream.h>
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// larger than the pipe and socket buffers, so the writer has to wait for the reader
+auto makeData(size_t size) -> std::vector<uint8_t> {
+    auto data = std::vector<uint8_t>(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(i * 7 + i / 251);
+    }
+    return data;
+}
+
+auto readAll(int fd) -> std::vector<uint8_t> {
+    auto result = std::vector<uint8_t>();
+    auto buffer = std::vector<uint8_t>(65536);
+    auto numBytes = ssize_t();
+    while ((numBytes = ::read(fd, buffer.data(), buffer.size())) > 0) {
+        result.insert(result.end(), buffer.begin(), buffer.begin() + numBytes);
+    }
+    return result;
+}
+
+auto tmpPath(char const* name) -> std::string {
+    return std::string("/tmp/buv_test_") + std::to_string(getpid()) + "_" + name;
+}
+
+} // namespace
+
+TEST_CASE("socket_stream_fifo") {
+    auto path = tmpPath("fifo");
+    auto data = makeData(5'000'000);
+
+    auto tail = data.end() - 1000;
+    auto received = std::vector<uint8_t>();
+    auto reader = std::thread([&] {
+        // wait until the stream has created the fifo
+        auto fd = -1;
+        while ((fd = open(path.c_str(), O_RDONLY)) < 0) {
+            std::this_thread::yield();
+        }
+        received = readAll(fd);
+        close(fd);
+    });
+
+    {
+        auto stream = buv::SocketStream::createFifo(path);
+        stream->write(data.data(), data.size());
+
+        // the reader has consumed the spliced pages, so all of data can be changed. The last ones are the ones still in the pipe.
+        std::fill(data.begin(), tail, uint8_t());
+        std::iota(tail, data.end(), uint8_t());
+        stream->write(&*tail, 1000);
+    }
+    reader.join();
+    std::remove(path.c_str());
+
+    REQUIRE(received.size() == data.size() + 1000);
+    auto expected = makeData(data.size());
+    REQUIRE(std::equal(expected.begin(), expected.end(), received.begin()));
+    REQUIRE(std::equal(tail, data.end(), received.begin() + static_cast<ptrdiff_t>(data.size())));
+}
+
+TEST_CASE("socket_stream_fifo_regular_file") {
+    auto path = tmpPath("file");
+    auto data = makeData(100'000);
+    {
+        auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        REQUIRE(fd >= 0);
+        close(fd);
+    }
+    buv::SocketStream::createFifo(path)->write(data.data(), data.size());
+
+    auto fd = open(path.c_str(), O_RDONLY);
+    REQUIRE(fd >= 0);
+    REQUIRE(readAll(fd) == data);
+    close(fd);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("socket_stream_unix") {
+    auto path = tmpPath("sock");
+    auto data = makeData(5'000'000);
+
+    auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(server >= 0);
+    auto addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+    REQUIRE(0 == bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+    REQUIRE(0 == listen(server, 1));
+
+    auto received = std::vector<uint8_t>();
+    auto reader = std::thread([&] {
+        auto fd = accept(server, nullptr, nullptr);
+        received = readAll(fd);
+        close(fd);
+    });
+    buv::SocketStream::createUnix(path)->write(data.data(), data.size());
+    reader.join();
+    close(server);
+    std::remove(path.c_str());
+
+    REQUIRE(received == data);
+    REQUIRE_THROWS(buv::SocketStream::createUnix(path));
+}
+
+TEST_CASE("socket_stream_null") {
+    auto data = makeData(1000);
+    buv::SocketStream::createNull()->write(data.data(), data.size());
+}
+
+TEST_CASE("shared_memory_ring") {
+    auto name = "/buv_test_" + std::to_string(getpid());
+    auto data = makeData(10'000);
+
+    // the reader can be started first, it waits for the writer
+    auto received = std::vector<std::vector<uint8_t>>();
+    auto reader = std::thread([&] {
+        auto ring = buv::SharedMemoryRingReader(name);
+        while (ring.read([&](uint8_t const* d, size_t size) {
+            received.emplace_back(d, d + size);
+        })) {
+        }
+    });
+
+    {
+        auto ring = buv::SharedMemoryRingWriter(name, data.size(), 3);
+        REQUIRE_THROWS(ring.write(data.data(), data.size() + 1));
+
+        // more writes than slots, of different sizes
+        for (size_t i = 0; i < 100; ++i) {
+            data[0] = static_cast<uint8_t>(i);
+            ring.write(data.data(), data.size() - i);
+        }
+    }
+    reader.join();
+
+    REQUIRE(received.size() == 100);
+    for (size_t i = 0; i < received.size(); ++i) {
+        REQUIRE(received[i].size() == data.size() - i);
+        REQUIRE(received[i][0] == static_cast<uint8_t>(i));
+        REQUIRE(std::equal(received[i].begin() + 1, received[i].end(), data.begin() + 1));
+    }
+
+    REQUIRE_THROWS(buv::SharedMemoryRingWriter(name, 100, 0));
+}
+
+TEST_CASE("shared_memory_ring_reader_gone") {
+    auto name = "/buv_test_gone_" + std::to_string(getpid());
+    auto data = makeData(100);
+
+    // nobody reads, so the third write waits for a reader until the timeout
+    {
+        auto ring = buv::SharedMemoryRingWriter(name, data.size(), 2, std::chrono::milliseconds(50));
+        ring.write(data.data(), data.size());
+        ring.write(data.data(), data.size());
+        REQUIRE_THROWS(ring.write(data.data(), data.size()));
+    }
+
+    // the reader leaves before the ring is full
+    auto ring = buv::SharedMemoryRingWriter(name, data.size(), 2);
+    (void)buv::SharedMemoryRingReader(name);
+    ring.write(data.data(), data.size());
+    ring.write(data.data(), data.size());
+    REQUIRE_THROWS(ring.write(data.data(), data.size()));
+}
+
+TEST_CASE("shared_memory_ring_crashed_writer") {
+    auto name = "/buv_test_crash_" + std::to_string(getpid());
+    auto data = makeData(100);
+
+    // the writer is a child process that exits without cleaning up, like after a crash, once the pipe is closed
+    auto fds = std::array<int, 2>();
+    REQUIRE(0 == pipe(fds.data()));
+    auto pid = fork();
+    if (pid == 0) {
+        close(fds[1]);
+        auto ring = buv::SharedMemoryRingWriter(name, data.size(), 2);
+        ring.write(data.data(), data.size());
+        auto c = char();
+        (void)::read(fds[0], &c, 1);
+        _exit(0);
+    }
+    close(fds[0]);
+
+    {
+        auto ring = buv::SharedMemoryRingReader(name);
+        auto received = std::vector<uint8_t>();
+        REQUIRE(ring.read([&](uint8_t const* d, size_t size) {
+            received.assign(d, d + size);
+        }));
+        REQUIRE(received == data);
+
+        close(fds[1]);
+        REQUIRE(pid == waitpid(pid, nullptr, 0));
+        REQUIRE_THROWS(ring.read([](uint8_t const* /*d*/, size_t /*size*/) {}));
+    }
+
+    // the crashed writer's ring is still there. The reader waits for the next writer instead of attaching to it.
+    auto numReceived = size_t();
+    auto reader = std::thread([&] {
+        auto ring = buv::SharedMemoryRingReader(name);
+        while (ring.read([&](uint8_t const* /*d*/, size_t /*size*/) {
+            ++numReceived;
+        })) {
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    {
+        auto ring = buv::SharedMemoryRingWriter(name, data.size(), 2);
+        for (size_t i = 0; i < 5; ++i) {
+            ring.write(data.data(), data.size());
+        }
+    }
+    reader.join();
+    REQUIRE(numReceived == 5);
+}
@@ -0,0 +1,69 @@
+#include <util/StreamVByte.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// encodes and decodes count random values of all byte lengths
+template <typename T, typename Encode, typename Decode>
+void testEncodeDecode(size_t count, Encode encode, Decode decode) {
+    auto rng = ankerl::nanobench::Rng(static_cast<uint64_t>(count));
+    auto values = std::vector<T>(count);
+    for (auto& val : values) {
+        val = static_cast<T>(rng() >> rng.bounded(64));
+    }
+
+    auto data = std::string("xyz");
+    encode(values.data(), values.size(), data);
+
+    // some data afterwards, decoding must stop at the correct position
+    auto dataSize = data.size();
+    data += "trailing data";
+
+    auto decoded = std::vector<T>(count);
+    auto const* ptr = decode(data.data() + 3, data.data() + data.size(), decoded.size(), decoded.data());
+    REQUIRE(ptr == data.data() + dataSize);
+    REQUIRE(decoded == values);
+
+    // also works when the buffer ends right after the data, where SIMD can't be used
+    data.resize(dataSize);
+    decoded.assign(count, 0);
+    ptr = decode(data.data() + 3, data.data() + data.size(), decoded.size(), decoded.data());
+    REQUIRE(ptr == data.data() + dataSize);
+    REQUIRE(decoded == values);
+}
+
+} // namespace
+
+TEST_CASE("stream_vbyte") {
+    for (size_t count : {0, 1, 3, 4, 5, 7, 8, 31, 1000, 1001}) {
+        testEncodeDecode<uint32_t>(count, util::streamVByteEncode32, util::streamVByteDecode32);
+        testEncodeDecode<uint64_t>(count, util::streamVByteEncode64, util::streamVByteDecode64);
+    }
+}
+
+TEST_CASE("stream_vbyte_lengths") {
+    auto data = std::string();
+    auto values = std::vector<uint64_t>{0, 255, 256, 65535, 65536, 0xffffffff, UINT64_C(0x100000000), UINT64_MAX};
+    util::streamVByteEncode64(values.data(), values.size(), data);
+
+    // 2 control bytes, then 1+1+2+2+4+4+8+8 bytes
+    REQUIRE(data.size() == 2 + 30);
+}
+
+TEST_CASE("stream_vbyte_truncated") {
+    auto values = std::vector<uint32_t>(100, 0x12345678);
+    auto data = std::string();
+    util::streamVByteEncode32(values.data(), values.size(), data);
+
+    auto decoded = std::vector<uint32_t>(values.size());
+    for (size_t size : {size_t(0), size_t(10), util::streamVByteNumControlBytes(values.size()), data.size() - 1}) {
+        REQUIRE_THROWS((void)util::streamVByteDecode32(data.data(), data.data() + size, decoded.size(), decoded.data()));
+    }
+    REQUIRE(util::streamVByteDecode32(data.data(), data.data() + data.size(), decoded.size(), decoded.data()) ==
+            data.data() + data.size());
+}
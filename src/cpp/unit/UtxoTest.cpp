@@ -0,0 +1,58 @@
+#include <app/Utxo.h>
+
+#include <doctest.h>
+
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+auto txid(uint8_t x) -> buv::TxIdPrefix {
+    return buv::TxIdPrefix{x, 0, 0, 0, 0, 0, 0, 0};
+}
+
+// removes all given vouts, and returns the (satoshi, blockHeight) of each
+auto spend(buv::Utxo& utxo, uint8_t x, std::vector<uint16_t> const& vouts) -> std::vector<std::pair<int64_t, uint32_t>> {
+    auto spent = std::vector<std::pair<int64_t, uint32_t>>();
+    utxo.removeAllSorted(txid(x), vouts, [&](int64_t satoshi, uint32_t blockHeight) {
+        spent.emplace_back(satoshi, blockHeight);
+    });
+    return spent;
+}
+
+} // namespace
+
+TEST_CASE("utxo_serialize_load") {
+    auto filename = std::filesystem::temp_directory_path() / "buv_utxo_test.utxo";
+
+    {
+        auto utxo = buv::Utxo(100);
+        utxo.insert(txid(1), 10, {100, 101});
+        utxo.insert(txid(2), 11, {200});
+        utxo.insert(txid(3), 12, {300, 301, 302, 303, 304});
+        utxo.insert(txid(4), 13, {400, 401, 402});
+
+        // only vout 0 and 1 are left, so this is loaded as a small utxo
+        REQUIRE(spend(utxo, 4, {2}) == std::vector<std::pair<int64_t, uint32_t>>{{402, 13}});
+        REQUIRE(spend(utxo, 1, {0}) == std::vector<std::pair<int64_t, uint32_t>>{{100, 10}});
+        REQUIRE(spend(utxo, 3, {1, 3}) == std::vector<std::pair<int64_t, uint32_t>>{{301, 12}, {303, 12}});
+        buv::serialize(1234, utxo, filename);
+    }
+
+    auto [blockHeight, utxo] = buv::load(filename);
+    REQUIRE(blockHeight == 1234);
+    REQUIRE(utxo.map().size() == 4);
+    REQUIRE(utxo.map().at(txid(3)).blockHeight() == 12);
+
+    REQUIRE(spend(utxo, 1, {1}) == std::vector<std::pair<int64_t, uint32_t>>{{101, 10}});
+    REQUIRE(spend(utxo, 2, {0}) == std::vector<std::pair<int64_t, uint32_t>>{{200, 11}});
+    REQUIRE(spend(utxo, 3, {0, 2, 4}) == std::vector<std::pair<int64_t, uint32_t>>{{300, 12}, {302, 12}, {304, 12}});
+    REQUIRE(utxo.map().size() == 1);
+
+    // undo of the spend before serialization
+    utxo.restore(txid(4), 13, 2, 402);
+    REQUIRE(spend(utxo, 4, {0, 1, 2}) == std::vector<std::pair<int64_t, uint32_t>>{{400, 13}, {401, 13}, {402, 13}});
+    REQUIRE(utxo.map().empty());
+
+    std::filesystem::remove(filename);
+}
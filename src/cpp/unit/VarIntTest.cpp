@@ -3,6 +3,11 @@
 
 #include <doctest.h>
 #include <fmt/format.h>
+#include <nanobench.h>
+
+#include <numeric>
+#include <string>
+#include <vector>
 
 template <typename T>
 void testEncDec(T val) {
@@ -50,3 +55,85 @@ TEST_CASE("varint") {
     testEncDec(std::numeric_limits<uint8_t>::min());
     testEncDec(std::numeric_limits<uint8_t>::max());
 }
+
+namespace {
+
+// decodes all values with decodeUint and decodeUintFast, they have to give exactly the same result
+template <typename UT>
+void testFastSameAsSlow(std::string const& data) {
+    auto const* end = data.data() + data.size();
+    auto const* slowPtr = data.data();
+    auto const* fastPtr = data.data();
+    while (slowPtr < end) {
+        auto slowVal = util::decodeUint<UT>(slowPtr);
+        auto fastVal = util::decodeUintFast<UT>(fastPtr, end);
+        REQUIRE(slowVal == fastVal);
+        REQUIRE(slowPtr == fastPtr);
+    }
+}
+
+} // namespace
+
+TEST_CASE("varint_fast") {
+    auto rng = ankerl::nanobench::Rng(123);
+    auto varint = util::VarInt();
+
+    auto data64 = std::string();
+    auto data32 = std::string();
+    auto data16 = std::string();
+    for (int i = 0; i < 100000; ++i) {
+        // random bit length, so all varint sizes are covered
+        auto val = rng() >> rng.bounded(64);
+        data64 += varint.encode(val);
+        data32 += varint.encode(static_cast<uint32_t>(val));
+        data16 += varint.encode(static_cast<uint16_t>(val));
+    }
+    testFastSameAsSlow<uint64_t>(data64);
+    testFastSameAsSlow<uint32_t>(data32);
+    testFastSameAsSlow<uint16_t>(data16);
+
+    // too many continuation bytes for uint16_t is handled the same way too
+    testFastSameAsSlow<uint16_t>(std::string("\xff\xff\xff\xff\x01\x00\x00\x00\x00\x00\x00\x00\x00", 13));
+}
+
+TEST_CASE("varint_amount_block_diffs") {
+    auto rng = ankerl::nanobench::Rng(321);
+    auto varint = util::VarInt();
+
+    // encode the same way as ChangesInBlock::encode: block diff only while amount <= 0
+    auto data = std::string();
+    auto amount = -static_cast<int64_t>(rng.bounded(1'000'000'000));
+    auto expectedAmountDiffs = std::vector<uint64_t>();
+    auto expectedBlockDiffs = std::vector<int64_t>();
+    for (int i = 0; i < 1000; ++i) {
+        auto amountDiff = uint64_t(rng.bounded(10'000'000));
+        amount += static_cast<int64_t>(amountDiff);
+        data += varint.encode(amountDiff);
+        expectedAmountDiffs.push_back(amountDiff);
+
+        auto blockDiff = int64_t();
+        if (amount <= 0) {
+            blockDiff = static_cast<int64_t>(rng.bounded(600'000)) - 300'000;
+            data += varint.encode(blockDiff);
+        }
+        expectedBlockDiffs.push_back(blockDiff);
+    }
+
+    auto amountDiffs = std::vector<uint64_t>(expectedAmountDiffs.size());
+    auto blockDiffs = std::vector<int64_t>(expectedBlockDiffs.size());
+    auto const* ptr = data.data();
+    auto const* end = data.data() + data.size();
+    auto decodedAmount = amount - std::accumulate(expectedAmountDiffs.begin(), expectedAmountDiffs.end(), int64_t());
+
+    // decode in uneven batches
+    auto numDecoded = size_t();
+    while (ptr < end) {
+        numDecoded += util::decodeAmountBlockDiffs(
+            ptr, end, decodedAmount, amountDiffs.data() + numDecoded, blockDiffs.data() + numDecoded, 77);
+    }
+    REQUIRE(ptr == end);
+    REQUIRE(numDecoded == expectedAmountDiffs.size());
+    REQUIRE(decodedAmount == amount);
+    REQUIRE(amountDiffs == expectedAmountDiffs);
+    REQUIRE(blockDiffs == expectedBlockDiffs);
+}
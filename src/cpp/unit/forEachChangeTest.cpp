@@ -0,0 +1,147 @@
+#include <app/forEachChange.h>
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// encodes numBlocks blocks, with increasing number of changes
+auto encodeBlocks(uint32_t numBlocks) -> std::string {
+    auto data = std::string();
+    auto cib = buv::ChangesInBlock();
+    for (uint32_t blockHeight = 0; blockHeight < numBlocks; ++blockHeight) {
+        (void)cib.beginBlock(blockHeight);
+        for (uint32_t i = 0; i <= blockHeight % 50; ++i) {
+            cib.addChange(1000 + i, blockHeight);
+            cib.addChange(-static_cast<int64_t>(2000 + i), blockHeight / 2);
+        }
+        cib.finalizeBlock();
+        data += cib.encode();
+    }
+    return data;
+}
+
+auto framePointers(std::string const& data) -> std::vector<char const*> {
+    auto frames = std::vector<char const*>();
+    auto const* ptr = data.data();
+    while (ptr != data.data() + data.size()) {
+        frames.push_back(ptr);
+        ptr = buv::ChangesInBlock::skip(ptr).second;
+    }
+    return frames;
+}
+
+} // namespace
+
+TEST_CASE("parallel_for_each_change") {
+    auto data = encodeBlocks(500);
+    auto frames = framePointers(data);
+    REQUIRE(frames.size() == 500);
+
+    auto expected = std::vector<std::vector<buv::ChangeAtBlockheight>>();
+    buv::forEachChange(data.data(), data.data() + data.size(), [&](buv::ChangesInBlock const& cib) {
+        expected.push_back(cib.changeAtBlockheights());
+        return true;
+    });
+
+    // strict order, same content
+    auto nextBlockHeight = uint32_t();
+    auto lastCib =
+        buv::parallelForEachChange(frames, util::ResourceId{7}, util::ConcurrentWorkers{4}, [&](buv::ChangesInBlock const& cib) {
+            REQUIRE(cib.blockData().blockHeight == nextBlockHeight);
+            REQUIRE(cib.changeAtBlockheights() == expected[nextBlockHeight]);
+            ++nextBlockHeight;
+            return true;
+        });
+    REQUIRE(nextBlockHeight == 500);
+    REQUIRE(lastCib.blockData().blockHeight == 499);
+
+    // stops early, and returns the block where it stopped
+    nextBlockHeight = 0;
+    lastCib = buv::parallelForEachChange(frames, [&](buv::ChangesInBlock const& cib) {
+        REQUIRE(cib.blockData().blockHeight == nextBlockHeight);
+        ++nextBlockHeight;
+        return cib.blockData().blockHeight != 123;
+    });
+    REQUIRE(nextBlockHeight == 124);
+    REQUIRE(lastCib.blockData().blockHeight == 123);
+    REQUIRE(lastCib.changeAtBlockheights() == expected[123]);
+
+    // nothing to do
+    lastCib = buv::parallelForEachChange(std::vector<char const*>(), [&](buv::ChangesInBlock const& /*cib*/) {
+        return true;
+    });
+    REQUIRE(lastCib.changeAtBlockheights().empty());
+}
+
+TEST_CASE("for_each_change_lazy_and_stream") {
+    auto data = encodeBlocks(500);
+    auto filename = std::filesystem::temp_directory_path() / "buv_for_each_change_test.blk";
+    {
+        auto fout = std::ofstream(filename, std::ios::binary | std::ios::out);
+        fout << data;
+    }
+
+    auto expected = std::vector<std::vector<buv::ChangeAtBlockheight>>();
+    buv::forEachChange(data.data(), data.data() + data.size(), [&](buv::ChangesInBlock const& cib) {
+        expected.push_back(cib.changeAtBlockheights());
+        return true;
+    });
+
+    {
+        auto file = util::Mmap(filename, util::MmapMode::lazy);
+        REQUIRE(file.view() == data);
+        auto nextBlockHeight = uint32_t();
+        buv::forEachChange(file, [&](buv::ChangesInBlock const& cib) {
+            REQUIRE(cib.changeAtBlockheights() == expected[nextBlockHeight]);
+            ++nextBlockHeight;
+            return true;
+        });
+        REQUIRE(nextBlockHeight == 500);
+
+        // the window moves through the whole file, and dropped pages are read again when needed
+        for (auto const* ptr = file.begin(); ptr < file.end(); ptr += 4096) {
+            file.readahead(ptr);
+        }
+        REQUIRE(file.view() == data);
+    }
+    {
+        // parallel readers: the window starts at the furthest one, pages are dropped behind the slowest one
+        auto file = util::Mmap(filename, util::MmapMode::lazy);
+        for (auto const* ptr = file.begin(); ptr < file.end(); ptr += 4096) {
+            file.readahead(ptr, std::min(ptr + 100'000, file.end() - 1));
+        }
+        REQUIRE(file.view() == data);
+    }
+
+    // a tiny buffer, so it has to grow for the larger frames
+    for (auto bufferSize : {size_t(16), size_t(1000), size_t(1) << 20U}) {
+        auto stream = util::PreadStream(filename, bufferSize);
+        auto nextBlockHeight = uint32_t();
+        auto lastCib = buv::forEachChange(stream, [&](buv::ChangesInBlock const& cib) {
+            REQUIRE(cib.blockData().blockHeight == nextBlockHeight);
+            REQUIRE(cib.changeAtBlockheights() == expected[nextBlockHeight]);
+            ++nextBlockHeight;
+            return cib.blockData().blockHeight != 300;
+        });
+        REQUIRE(nextBlockHeight == 301);
+        REQUIRE(lastCib.blockData().blockHeight == 300);
+    }
+
+    {
+        auto stream = util::PreadStream(filename, 100);
+        auto numBlocks = size_t();
+        buv::forEachChange(stream, [&](buv::ChangesInBlock const& /*cib*/) {
+            ++numBlocks;
+            return true;
+        });
+        REQUIRE(numBlocks == 500);
+        REQUIRE(stream.fileOffset() == data.size());
+    }
+    std::filesystem::remove(filename);
+}
@@ -0,0 +1,68 @@
+#include <app/BlockEncoder.h>
+#include <util/radixSort.h>
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+TEST_CASE("radix_sort_uint16") {
+    auto rng = ankerl::nanobench::Rng(123);
+    auto scratch = std::vector<uint16_t>();
+
+    // small sizes use insertion sort, larger ones the radix passes
+    for (size_t size : {0, 1, 2, 5, 63, 64, 65, 1000, 100'000}) {
+        auto data = std::vector<uint16_t>();
+        for (size_t i = 0; i < size; ++i) {
+            data.push_back(static_cast<uint16_t>(rng()));
+        }
+        auto expected = data;
+        std::sort(expected.begin(), expected.end());
+        util::radixSort(data, scratch);
+        REQUIRE(data == expected);
+    }
+}
+
+TEST_CASE("radix_sort_stable") {
+    // only sort by the lowest 4 bits, the upper bits must keep their order
+    auto data = std::vector<uint32_t>();
+    for (uint32_t i = 0; i < 1000; ++i) {
+        data.push_back(((i * 7U) % 16U) | (i << 4U));
+    }
+    auto expected = data;
+    std::stable_sort(expected.begin(), expected.end(), [](uint32_t a, uint32_t b) {
+        return (a & 15U) < (b & 15U);
+    });
+    auto scratch = std::vector<uint32_t>();
+    util::radixSort(data, scratch, 4, [](uint32_t val) {
+        return val & 15U;
+    });
+    REQUIRE(data == expected);
+
+    REQUIRE(util::radixKeyBits(0) == 0);
+    REQUIRE(util::radixKeyBits(1) == 1);
+    REQUIRE(util::radixKeyBits(2047) == 11);
+    REQUIRE(util::radixKeyBits(2048) == 12);
+    REQUIRE(util::radixKeyBits(UINT64_MAX) == 64);
+}
+
+TEST_CASE("sort_changes") {
+    auto rng = ankerl::nanobench::Rng(321);
+    for (size_t size : {0, 10, 100, 10'000}) {
+        auto changes = std::vector<buv::ChangeAtBlockheight>();
+        for (size_t i = 0; i < size; ++i) {
+            // few different heights and amounts, so there are many ties. Some extreme amounts to test the key range.
+            auto satoshi = static_cast<int64_t>(rng.bounded(1000)) - 500;
+            if (rng.bounded(100) == 0) {
+                satoshi = rng.bounded(2) == 0 ? INT64_MIN : INT64_MAX;
+            }
+            changes.emplace_back(satoshi, rng.bounded(20) + (rng.bounded(2) == 0 ? 0U : 0xfff00000U));
+        }
+        auto expected = changes;
+        std::sort(expected.begin(), expected.end());
+        buv::sortChanges(changes);
+        REQUIRE(changes == expected);
+    }
+}
@@ -0,0 +1,96 @@
+#include "AppendOnlyMmap.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace util {
+
+namespace {
+
+// grow by at least 64 MB, and at most 4 GB at a time
+constexpr auto minGrowth = size_t(64) * 1024 * 1024;
+constexpr auto maxGrowth = size_t(4) * 1024 * 1024 * 1024;
+
+} // namespace
+
+AppendOnlyMmap::AppendOnlyMmap(std::filesystem::path const& filename) {
+    // NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    mFileDescriptor = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFileDescriptor == -1) {
+        throw std::runtime_error(fmt::format("AppendOnlyMmap: could not open '{}'", filename.string()));
+    }
+    reserve(minGrowth);
+}
+
+AppendOnlyMmap::~AppendOnlyMmap() {
+    if (mData != nullptr) {
+        ::munmap(mData, mCapacity);
+    }
+    if (mFileDescriptor != -1) {
+        // cut off the preallocated but unused part
+        (void)::ftruncate(mFileDescriptor, static_cast<off_t>(mSize));
+        ::close(mFileDescriptor);
+    }
+}
+
+void AppendOnlyMmap::reserve(size_t capacity) {
+    if (capacity <= mCapacity) {
+        return;
+    }
+    if (0 != ::ftruncate(mFileDescriptor, static_cast<off_t>(capacity))) {
+        throw std::runtime_error(fmt::format("AppendOnlyMmap: could not resize file to {} bytes", capacity));
+    }
+
+    void* newData = nullptr;
+    if (mData == nullptr) {
+        // NOLINTNEXTLINE(hicpp-signed-bitwise)
+        newData = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFileDescriptor, 0);
+    } else {
+        newData = ::mremap(mData, mCapacity, capacity, MREMAP_MAYMOVE);
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
+    if (newData == MAP_FAILED) {
+        throw std::runtime_error(fmt::format("AppendOnlyMmap: could not map {} bytes", capacity));
+    }
+    mData = newData;
+    mCapacity = capacity;
+}
+
+void AppendOnlyMmap::append(void const* data, size_t size) {
+    if (mSize + size > mCapacity) {
+        auto growth = std::clamp(mCapacity, minGrowth, maxGrowth);
+        reserve(std::max(mSize + size, mCapacity + growth));
+    }
+    std::memcpy(static_cast<char*>(mData) + mSize, data, size);
+    mSize += size;
+}
+
+void AppendOnlyMmap::discard(size_t offset, size_t size) {
+    auto pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    auto begin = (offset + pageSize - 1) / pageSize * pageSize;
+    auto end = std::min(offset + size, mSize) / pageSize * pageSize;
+    if (begin < end) {
+        // also drops the pages from the mapping
+        // NOLINTNEXTLINE(hicpp-signed-bitwise)
+        (void)::fallocate(mFileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(begin),
+                          static_cast<off_t>(end - begin));
+    }
+}
+
+auto AppendOnlyMmap::data() const -> char const* {
+    return static_cast<char const*>(mData);
+}
+
+auto AppendOnlyMmap::size() const -> size_t {
+    return mSize;
+}
+
+} // namespace util
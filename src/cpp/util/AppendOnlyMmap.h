@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace util {
+
+// File backed, append-only memory. Data is appended at the end and can be read back through data() at any time. The file is
+// grown in large steps and remapped, so pointers from data() are only valid until the next append().
+//
+// Since the mapping is shared with the file, the kernel can evict pages that are not used any more. Resident memory only
+// consists of the pages that are actually accessed.
+class AppendOnlyMmap {
+    void* mData = nullptr;
+    size_t mSize = 0;
+    size_t mCapacity = 0;
+    int mFileDescriptor = -1;
+
+public:
+    // Creates (or truncates) the file.
+    explicit AppendOnlyMmap(std::filesystem::path const& filename);
+    ~AppendOnlyMmap();
+
+    AppendOnlyMmap(AppendOnlyMmap const&) = delete;
+    auto operator=(AppendOnlyMmap const&) -> AppendOnlyMmap& = delete;
+    AppendOnlyMmap(AppendOnlyMmap&&) = delete;
+    auto operator=(AppendOnlyMmap&&) -> AppendOnlyMmap& = delete;
+
+    // Appends size bytes, grows the file if necessary.
+    void append(void const* data, size_t size);
+
+    [[nodiscard]] auto data() const -> char const*;
+
+    // Frees the disk space and memory of the whole pages in [offset, offset + size). They read as zeros afterwards. Does nothing
+    // when the filesystem doesn't support that.
+    void discard(size_t offset, size_t size);
+
+    // Number of bytes appended so far
+    [[nodiscard]] auto size() const -> size_t;
+
+private:
+    void reserve(size_t capacity);
+};
+
+} // namespace util
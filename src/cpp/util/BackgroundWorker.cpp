@@ -0,0 +1,71 @@
+#include "BackgroundWorker.h"
+
+#include <utility>
+
+namespace util {
+
+BackgroundWorker::BackgroundWorker() {
+    mThread = std::thread([this] {
+        workerLoop();
+    });
+}
+
+BackgroundWorker::~BackgroundWorker() {
+    {
+        auto lock = std::unique_lock(mMutex);
+        mCondition.wait(lock, [this] {
+            return !mHasJob;
+        });
+        mIsStopped = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+void BackgroundWorker::submit(std::function<void()> job) {
+    wait();
+    {
+        auto lock = std::lock_guard(mMutex);
+        mJob = std::move(job);
+        mHasJob = true;
+    }
+    mCondition.notify_all();
+}
+
+void BackgroundWorker::wait() {
+    auto lock = std::unique_lock(mMutex);
+    mCondition.wait(lock, [this] {
+        return !mHasJob;
+    });
+    if (auto error = std::exchange(mError, nullptr)) {
+        std::rethrow_exception(error);
+    }
+}
+
+void BackgroundWorker::workerLoop() {
+    auto lock = std::unique_lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] {
+            return mHasJob || mIsStopped;
+        });
+        if (mIsStopped) {
+            return;
+        }
+
+        lock.unlock();
+        auto error = std::exception_ptr();
+        try {
+            mJob();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        mJob = nullptr;
+        mError = error;
+        mHasJob = false;
+        mCondition.notify_all();
+    }
+}
+
+} // namespace util
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace util {
+
+// Runs jobs one at a time on a background thread, so the caller can already work on the next job while the current one runs.
+// E.g. a frame is sent while the next one is computed.
+class BackgroundWorker {
+    std::mutex mMutex{};
+    std::condition_variable mCondition{};
+    std::function<void()> mJob{};
+    bool mHasJob = false;
+    bool mIsStopped = false;
+    std::exception_ptr mError{};
+    std::thread mThread{};
+
+public:
+    BackgroundWorker();
+
+    // Waits until the current job is done. Its exception is lost.
+    ~BackgroundWorker();
+
+    BackgroundWorker(BackgroundWorker const&) = delete;
+    BackgroundWorker(BackgroundWorker&&) = delete;
+    auto operator=(BackgroundWorker const&) -> BackgroundWorker& = delete;
+    auto operator=(BackgroundWorker&&) -> BackgroundWorker& = delete;
+
+    // Waits until the previous job is done, then runs job in the background. Rethrows the previous job's exception instead.
+    void submit(std::function<void()> job);
+
+    // Waits until the current job is done. Rethrows its exception.
+    void wait();
+
+private:
+    void workerLoop();
+};
+
+} // namespace util
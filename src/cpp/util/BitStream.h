@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// Bit level writing & reading, least significant bit first. Used for Golomb-Rice coding, see
+// https://en.wikipedia.org/wiki/Golomb_coding#Rice_coding
+namespace util {
+
+// Quotients >= this are escaped: riceEscape one bits, followed by the raw 64 bit value. This limits the size of huge outliers.
+static constexpr auto riceEscape = uint64_t(32);
+
+// Appends bits to a string
+class BitWriter {
+    std::string& mOut;
+    uint64_t mBuf{};
+    uint64_t mNumBits{};
+
+public:
+    explicit BitWriter(std::string& out)
+        : mOut(out) {}
+
+    // writes the lowest numBits of val, numBits <= 32
+    void write(uint64_t val, uint64_t numBits) {
+        mBuf |= (val & ((uint64_t(1) << numBits) - 1)) << mNumBits;
+        mNumBits += numBits;
+        while (mNumBits >= 8) {
+            mOut += static_cast<char>(static_cast<uint8_t>(mBuf));
+            mBuf >>= 8U;
+            mNumBits -= 8;
+        }
+    }
+
+    void write64(uint64_t val) {
+        write(val, 32);
+        write(val >> 32U, 32);
+    }
+
+    // quotient in unary (ones terminated by a zero), followed by the k <= 32 lowest bits.
+    void writeRice(uint64_t val, uint64_t k) {
+        auto q = val >> k;
+        if (q >= riceEscape) {
+            write(UINT64_C(0xffffffff), riceEscape);
+            write64(val);
+            return;
+        }
+        write(UINT64_C(0xffffffff), q);
+        write(0, 1);
+        write(val, k);
+    }
+
+    // writes the last partial byte
+    void finish() {
+        if (mNumBits > 0) {
+            mOut += static_cast<char>(static_cast<uint8_t>(mBuf));
+            mBuf = 0;
+            mNumBits = 0;
+        }
+    }
+};
+
+// Reads bits written by BitWriter. Never reads at or past end, throws std::runtime_error when the data ends before the value.
+class BitReader {
+    char const* mPtr;
+    char const* mEnd;
+    uint64_t mBuf{};
+    uint64_t mNumBits{};
+
+public:
+    BitReader(char const* ptr, char const* end)
+        : mPtr(ptr)
+        , mEnd(end) {}
+
+    // reads numBits <= 32
+    [[nodiscard]] auto read(uint64_t numBits) -> uint64_t {
+        refill();
+        if (numBits > mNumBits) {
+            throwTruncated();
+        }
+        auto val = mBuf & ((uint64_t(1) << numBits) - 1);
+        mBuf >>= numBits;
+        mNumBits -= numBits;
+        return val;
+    }
+
+    [[nodiscard]] auto read64() -> uint64_t {
+        auto lo = read(32);
+        return lo | (read(32) << 32U);
+    }
+
+    // k <= 32
+    [[nodiscard]] auto readRice(uint64_t k) -> uint64_t {
+        refill();
+
+        // count the ones. After refill() there are at least riceEscape + 1 bits available, unless the data ends. Bits above
+        // mNumBits are either zero or the same data that is refilled later, so the terminating zero has to be below mNumBits.
+        auto q = ~mBuf == 0 ? riceEscape : static_cast<uint64_t>(__builtin_ctzll(~mBuf));
+        if (std::min(q + 1, riceEscape) > mNumBits) {
+            throwTruncated();
+        }
+        if (q >= riceEscape) {
+            mBuf >>= riceEscape;
+            mNumBits -= riceEscape;
+            return read64();
+        }
+        mBuf >>= q + 1;
+        mNumBits -= q + 1;
+        return (q << k) | read(k);
+    }
+
+private:
+    [[noreturn]] static void throwTruncated() {
+        throw std::runtime_error("Decoding error, bit stream is truncated");
+    }
+
+    // makes sure at least 57 bits are available, if there is enough data
+    void refill() {
+        if (mEnd - mPtr >= 8) {
+            auto word = uint64_t();
+            std::memcpy(&word, mPtr, sizeof(word));
+            mBuf |= word << mNumBits;
+            mPtr += (63 - mNumBits) >> 3U;
+            mNumBits |= 56U;
+            return;
+        }
+        while (mNumBits <= 56 && mPtr != mEnd) {
+            mBuf |= uint64_t(static_cast<uint8_t>(*mPtr)) << mNumBits;
+            ++mPtr;
+            mNumBits += 8;
+        }
+    }
+};
+
+// Number of bits writeRice needs for val
+[[nodiscard]] constexpr auto riceNumBits(uint64_t val, uint64_t k) -> uint64_t {
+    auto q = val >> k;
+    if (q >= riceEscape) {
+        return riceEscape + 64;
+    }
+    return q + 1 + k;
+}
+
+// Finds the k in [0, 32] that needs the least bits to rice encode all values. Starts with an estimate from the mean, and checks
+// the neighbors.
+[[nodiscard]] inline auto optimalRiceK(uint64_t const* values, size_t count) -> uint64_t {
+    if (count == 0) {
+        return 0;
+    }
+    auto sum = double();
+    for (size_t i = 0; i < count; ++i) {
+        sum += static_cast<double>(values[i]);
+    }
+    auto mean = sum / static_cast<double>(count);
+    auto estimate = mean < 2.0 ? 0 : std::min(static_cast<int>(std::log2(mean * 0.69)), 32);
+
+    auto bestK = uint64_t();
+    auto bestNumBits = std::numeric_limits<uint64_t>::max();
+    for (auto k = std::max(estimate - 2, 0); k <= std::min(estimate + 2, 32); ++k) {
+        auto numBits = uint64_t();
+        for (size_t i = 0; i < count; ++i) {
+            numBits += riceNumBits(values[i], static_cast<uint64_t>(k));
+        }
+        if (numBits < bestNumBits) {
+            bestNumBits = numBits;
+            bestK = static_cast<uint64_t>(k);
+        }
+    }
+    return bestK;
+}
+
+} // namespace util
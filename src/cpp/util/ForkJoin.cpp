@@ -0,0 +1,100 @@
+#include "ForkJoin.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace util {
+
+ForkJoin::ForkJoin(size_t numWorkers) {
+    if (numWorkers == 0) {
+        numWorkers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    for (size_t workerIdx = 1; workerIdx < numWorkers; ++workerIdx) {
+        mThreads.emplace_back([this, workerIdx] {
+            workerLoop(workerIdx);
+        });
+    }
+}
+
+ForkJoin::~ForkJoin() {
+    {
+        auto lock = std::lock_guard(mMutex);
+        mIsStopped = true;
+    }
+    mStartCondition.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+auto ForkJoin::numWorkers() const -> size_t {
+    return mThreads.size() + 1;
+}
+
+void ForkJoin::run(std::function<void(size_t)> const& fn) {
+    if (mThreads.empty()) {
+        fn(0);
+        return;
+    }
+
+    {
+        auto lock = std::lock_guard(mMutex);
+        mFn = &fn;
+        mNumBusy = mThreads.size();
+        ++mGeneration;
+    }
+    mStartCondition.notify_all();
+
+    auto error = std::exception_ptr();
+    try {
+        fn(0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    auto lock = std::unique_lock(mMutex);
+    mDoneCondition.wait(lock, [this] {
+        return mNumBusy == 0;
+    });
+    mFn = nullptr;
+    if (!error) {
+        error = std::exchange(mError, nullptr);
+    }
+    mError = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ForkJoin::workerLoop(size_t workerIdx) {
+    auto generation = size_t();
+    auto lock = std::unique_lock(mMutex);
+    while (true) {
+        mStartCondition.wait(lock, [&] {
+            return mGeneration != generation || mIsStopped;
+        });
+        if (mIsStopped) {
+            return;
+        }
+        generation = mGeneration;
+        auto const* fn = mFn;
+
+        lock.unlock();
+        auto error = std::exception_ptr();
+        try {
+            (*fn)(workerIdx);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && !mError) {
+            mError = error;
+        }
+        if (--mNumBusy == 0) {
+            mDoneCondition.notify_all();
+        }
+    }
+}
+
+} // namespace util
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// Runs a function on a fixed set of workers in parallel, and waits until all of them are done.
+//
+// The threads are kept alive between runs, so run() is cheap enough to be called several times per frame. The calling thread is
+// worker 0, so with one worker no thread is created at all.
+class ForkJoin {
+    std::vector<std::thread> mThreads{};
+
+    std::mutex mMutex{};
+    std::condition_variable mStartCondition{};
+    std::condition_variable mDoneCondition{};
+    std::function<void(size_t)> const* mFn = nullptr;
+    size_t mGeneration = 0;
+    size_t mNumBusy = 0;
+    bool mIsStopped = false;
+    std::exception_ptr mError{};
+
+public:
+    // numWorkers 0 uses all cores
+    explicit ForkJoin(size_t numWorkers);
+    ~ForkJoin();
+
+    ForkJoin(ForkJoin const&) = delete;
+    ForkJoin(ForkJoin&&) = delete;
+    auto operator=(ForkJoin const&) -> ForkJoin& = delete;
+    auto operator=(ForkJoin&&) -> ForkJoin& = delete;
+
+    [[nodiscard]] auto numWorkers() const -> size_t;
+
+    // Calls fn(workerIdx) for each worker in parallel and waits for all of them. Rethrows the first exception.
+    void run(std::function<void(size_t)> const& fn);
+
+private:
+    void workerLoop(size_t workerIdx);
+};
+
+} // namespace util
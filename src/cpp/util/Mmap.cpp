@@ -1,5 +1,6 @@
 #include "Mmap.h"
 
+#include <algorithm>
 #include <exception>
 #include <utility>
 
@@ -9,10 +10,27 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+namespace {
+
+// prefetch up to 64 MB ahead of the reader, in steps of 16 MB
+constexpr auto readaheadWindow = size_t(64) * 1024 * 1024;
+constexpr auto readaheadStep = size_t(16) * 1024 * 1024;
+
+// keep 16 MB behind the reader
+constexpr auto keepBehind = size_t(16) * 1024 * 1024;
+
+[[nodiscard]] auto pageAlignDown(size_t offset) -> size_t {
+    static auto const pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return offset - offset % pageSize;
+}
+
+} // namespace
+
 namespace util {
 
 // See https://techoverflow.net/2013/08/21/a-simple-mmap-readonly-example/
-Mmap::Mmap(std::filesystem::path const& f) {
+Mmap::Mmap(std::filesystem::path const& f, MmapMode mode)
+    : mMode(mode) {
     auto ec = std::error_code();
     mSize = std::filesystem::file_size(f, ec);
     if (ec) {
@@ -29,7 +47,8 @@ Mmap::Mmap(std::filesystem::path const& f) {
     }
 
     // NOLINTNEXTLINE(hicpp-signed-bitwise)
-    mData = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, mFileDescriptor, 0);
+    auto flags = mode == MmapMode::populate ? MAP_PRIVATE | MAP_POPULATE : MAP_PRIVATE;
+    mData = ::mmap(nullptr, mSize, PROT_READ, flags, mFileDescriptor, 0);
 
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
     if (mData == MAP_FAILED) {
@@ -37,6 +56,11 @@ Mmap::Mmap(std::filesystem::path const& f) {
         ::close(mFileDescriptor);
         mData = nullptr;
         mFileDescriptor = -1;
+        return;
+    }
+    if (mode == MmapMode::lazy) {
+        // more aggressive readahead, and pages can be freed soon after they were read
+        ::madvise(mData, mSize, MADV_SEQUENTIAL);
     }
 }
 
@@ -55,7 +79,10 @@ Mmap::~Mmap() {
 Mmap::Mmap(Mmap&& other) noexcept
     : mData(std::exchange(other.mData, nullptr))
     , mSize(std::exchange(other.mSize, 0U))
-    , mFileDescriptor(std::exchange(other.mFileDescriptor, -1)) {}
+    , mFileDescriptor(std::exchange(other.mFileDescriptor, -1))
+    , mMode(other.mMode)
+    , mReadaheadEnd(std::exchange(other.mReadaheadEnd, 0U))
+    , mDroppedEnd(std::exchange(other.mDroppedEnd, 0U)) {}
 
 auto Mmap::operator=(Mmap&& other) noexcept -> Mmap& {
     if (this != &other) {
@@ -63,6 +90,9 @@ auto Mmap::operator=(Mmap&& other) noexcept -> Mmap& {
         mData = std::exchange(other.mData, nullptr);
         mSize = std::exchange(other.mSize, 0U);
         mFileDescriptor = std::exchange(other.mFileDescriptor, -1);
+        mMode = other.mMode;
+        mReadaheadEnd = std::exchange(other.mReadaheadEnd, 0U);
+        mDroppedEnd = std::exchange(other.mDroppedEnd, 0U);
     }
     return *this;
 }
@@ -83,11 +113,36 @@ auto Mmap::end() const -> char const* {
     return static_cast<char const*>(mData) + mSize;
 }
 
-
 auto Mmap::view() const -> std::string_view {
     return std::string_view(static_cast<char const*>(mData), mSize);
 }
 
+void Mmap::readahead(char const* pos) {
+    readahead(pos, pos);
+}
+
+void Mmap::readahead(char const* pos, char const* aheadPos) {
+    if (mMode != MmapMode::lazy || mData == nullptr) {
+        return;
+    }
+    auto offset = static_cast<size_t>(pos - data());
+    auto aheadOffset = static_cast<size_t>(aheadPos - data());
+
+    // only move the window in steps, so most calls don't need a syscall
+    if (mReadaheadEnd < mSize && aheadOffset + readaheadWindow >= mReadaheadEnd + readaheadStep) {
+        auto begin = pageAlignDown(std::max(aheadOffset, mReadaheadEnd));
+        auto end = std::min(aheadOffset + readaheadWindow, mSize);
+        ::madvise(static_cast<char*>(mData) + begin, end - begin, MADV_WILLNEED);
+        mReadaheadEnd = end;
+    }
+
+    if (offset >= mDroppedEnd + keepBehind + readaheadStep) {
+        auto end = pageAlignDown(offset - keepBehind);
+        ::madvise(static_cast<char*>(mData) + mDroppedEnd, end - mDroppedEnd, MADV_DONTNEED);
+        mDroppedEnd = end;
+    }
+}
+
 auto Mmap::is_open() const -> bool {
     return mFileDescriptor != -1;
 }
@@ -1,22 +1,35 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <string_view>
 
 namespace util {
 
+enum class MmapMode : uint8_t {
+    // reads the whole file into memory before the constructor returns (MAP_POPULATE)
+    populate,
+
+    // pages are read on demand, use readahead() to read ahead of a sequential reader
+    lazy,
+};
+
 // memory maps a file for read only access
 class Mmap {
     void* mData = nullptr;
     size_t mSize = 0;
     int mFileDescriptor = -1;
+    MmapMode mMode = MmapMode::populate;
+
+    // readahead() window: [mDroppedEnd, mReadaheadEnd) is what the reader might still need
+    size_t mReadaheadEnd = 0;
+    size_t mDroppedEnd = 0;
 
 public:
     ~Mmap();
 
-    // if pool is not specified, it allocates one itself.
-    explicit Mmap(std::filesystem::path const& filename);
+    explicit Mmap(std::filesystem::path const& filename, MmapMode mode = MmapMode::populate);
 
     // no copy is allowed
     Mmap(Mmap const&) = delete;
@@ -37,6 +50,15 @@ public:
     // Gets a std::string_view of the whole mmaped file
     [[nodiscard]] auto view() const -> std::string_view;
 
+    // For MmapMode::lazy: tells the kernel that the reader is now at pos and moves forward. Prefetches a window ahead of pos
+    // (MADV_WILLNEED), and drops pages far behind it (MADV_DONTNEED) so a file larger than RAM does not push everything else
+    // out. Cheap enough to call for every block. Does nothing for MmapMode::populate.
+    void readahead(char const* pos);
+
+    // Same as readahead(pos), for readers that work on several positions in parallel: prefetches a window ahead of the furthest
+    // position aheadPos, and drops pages far behind the slowest position pos.
+    void readahead(char const* pos, char const* aheadPos);
+
 private:
     void close() noexcept;
 };
@@ -0,0 +1,85 @@
+#include "PreadStream.h"
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace util {
+
+PreadStream::PreadStream(std::filesystem::path const& filename, size_t bufferSize)
+    : mBuffer(bufferSize) {
+    // NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    mFileDescriptor = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFileDescriptor == -1) {
+        throw std::runtime_error(fmt::format("PreadStream: could not open '{}'", filename.string()));
+    }
+    mFileSize = std::filesystem::file_size(filename);
+    ::posix_fadvise(mFileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+PreadStream::~PreadStream() {
+    ::close(mFileDescriptor);
+}
+
+auto PreadStream::peek(size_t numBytes) -> char const* {
+    if (mEnd - mBegin < numBytes) {
+        fill(numBytes);
+        if (mEnd - mBegin < numBytes) {
+            return nullptr;
+        }
+    }
+    return mBuffer.data() + mBegin;
+}
+
+void PreadStream::consume(size_t numBytes) {
+    if (mEnd - mBegin < numBytes) {
+        throw std::runtime_error(fmt::format("PreadStream: can't consume {} bytes, only {} available", numBytes, mEnd - mBegin));
+    }
+    mBegin += numBytes;
+}
+
+auto PreadStream::fileOffset() const -> uint64_t {
+    return mFileOffset - (mEnd - mBegin);
+}
+
+void PreadStream::fill(size_t numBytes) {
+    // move the remaining bytes to the front, and make room for numBytes
+    std::memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+    mEnd -= mBegin;
+    mBegin = 0;
+    if (mBuffer.size() < numBytes) {
+        mBuffer.resize(numBytes);
+    }
+
+    // fill up the whole buffer, so there are few large reads
+    while (mEnd < mBuffer.size() && mFileOffset < mFileSize) {
+        auto numRead = ::pread(mFileDescriptor, mBuffer.data() + mEnd, mBuffer.size() - mEnd, static_cast<off_t>(mFileOffset));
+        if (numRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(fmt::format("PreadStream: read failed: {}", std::strerror(errno)));
+        }
+        if (numRead == 0) {
+            // file is shorter than it was when opened
+            break;
+        }
+        mEnd += static_cast<size_t>(numRead);
+        mFileOffset += static_cast<uint64_t>(numRead);
+    }
+
+    // everything before the buffer has been read, no need to keep it cached. A length of 0 would mean until the end of the file.
+    auto dropEnd = fileOffset();
+    if (dropEnd > mDroppedEnd) {
+        ::posix_fadvise(
+            mFileDescriptor, static_cast<off_t>(mDroppedEnd), static_cast<off_t>(dropEnd - mDroppedEnd), POSIX_FADV_DONTNEED);
+        mDroppedEnd = dropEnd;
+    }
+}
+
+} // namespace util
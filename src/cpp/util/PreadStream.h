@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace util {
+
+// Sequential reading of a file with pread into a buffer, for files that are larger than RAM. Already read parts of the file are
+// dropped from the page cache, so reading does not push everything else out of memory.
+class PreadStream {
+    int mFileDescriptor = -1;
+    uint64_t mFileSize = 0;
+
+    // file offset of mBuffer[mEnd]
+    uint64_t mFileOffset = 0;
+    uint64_t mDroppedEnd = 0;
+
+    std::vector<char> mBuffer{};
+    size_t mBegin = 0;
+    size_t mEnd = 0;
+
+public:
+    explicit PreadStream(std::filesystem::path const& filename, size_t bufferSize = size_t(16) * 1024 * 1024);
+    ~PreadStream();
+
+    PreadStream(PreadStream const&) = delete;
+    PreadStream(PreadStream&&) = delete;
+    auto operator=(PreadStream const&) -> PreadStream& = delete;
+    auto operator=(PreadStream&&) -> PreadStream& = delete;
+
+    // Makes sure at least numBytes are available at the returned pointer, reading more of the file if necessary. Returns nullptr
+    // if the file ends before. The pointer is valid until the next call to peek().
+    [[nodiscard]] auto peek(size_t numBytes) -> char const*;
+
+    // skips numBytes, which have to be available through peek()
+    void consume(size_t numBytes);
+
+    // file offset of the pointer returned by peek()
+    [[nodiscard]] auto fileOffset() const -> uint64_t;
+
+private:
+    void fill(size_t numBytes);
+};
+
+} // namespace util
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace util {
+
+// Non-owning view of contiguous elements, like C++20's std::span
+template <typename T>
+class Span {
+    T* mData = nullptr;
+    size_t mSize = 0;
+
+public:
+    constexpr Span() noexcept = default;
+
+    constexpr Span(T* data, size_t size) noexcept
+        : mData(data)
+        , mSize(size) {}
+
+    template <typename U>
+    Span(std::vector<U> const& vec) noexcept // NOLINT(hicpp-explicit-conversions)
+        : mData(vec.data())
+        , mSize(vec.size()) {}
+
+    [[nodiscard]] constexpr auto data() const noexcept -> T* {
+        return mData;
+    }
+
+    [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+        return mSize;
+    }
+
+    [[nodiscard]] constexpr auto empty() const noexcept -> bool {
+        return mSize == 0;
+    }
+
+    [[nodiscard]] constexpr auto begin() const noexcept -> T* {
+        return mData;
+    }
+
+    [[nodiscard]] constexpr auto end() const noexcept -> T* {
+        return mData + mSize;
+    }
+
+    [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> T& {
+        return mData[idx];
+    }
+
+    // count elements starting at offset
+    [[nodiscard]] constexpr auto subspan(size_t offset, size_t count) const noexcept -> Span {
+        return Span(mData + offset, count);
+    }
+};
+
+} // namespace util
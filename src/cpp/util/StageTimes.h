@@ -0,0 +1,54 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Sums up the time spent in each stage of a pipeline, so the slowest stage can be found. Not thread safe, use one per thread.
+class StageTimes {
+    std::vector<char const*> mNames{};
+    std::vector<std::chrono::nanoseconds> mDurations{};
+    size_t mNumRounds = 0;
+
+public:
+    explicit StageTimes(std::vector<char const*> names)
+        : mNames(std::move(names))
+        , mDurations(mNames.size()) {}
+
+    void add(size_t stageIdx, std::chrono::nanoseconds duration) {
+        mDurations[stageIdx] += duration;
+    }
+
+    // runs op and adds the time it took to the stage
+    template <typename Op>
+    void measure(size_t stageIdx, Op&& op) {
+        auto begin = std::chrono::steady_clock::now();
+        op();
+        add(stageIdx, std::chrono::steady_clock::now() - begin);
+    }
+
+    // one round through all stages, e.g. a frame
+    void endRound() {
+        ++mNumRounds;
+    }
+
+    // Average time of each stage per round, like "decode 1.23ms, send 4.56ms". Starts over.
+    [[nodiscard]] auto report() -> std::string {
+        auto str = std::string();
+        for (size_t i = 0; i < mNames.size(); ++i) {
+            auto ms = std::chrono::duration<double, std::milli>(mDurations[i]).count();
+            str += fmt::format("{}{} {:.2f}ms", i == 0 ? "" : ", ", mNames[i], mNumRounds == 0 ? 0.0 : ms / mNumRounds);
+            mDurations[i] = {};
+        }
+        mNumRounds = 0;
+        return str;
+    }
+};
+
+} // namespace util
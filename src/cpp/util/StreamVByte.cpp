@@ -0,0 +1,194 @@
+#include "StreamVByte.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSSE3__
+#    include <tmmintrin.h>
+#endif
+
+namespace {
+
+constexpr auto lengths32 = std::array<uint8_t, 4>{1, 2, 3, 4};
+constexpr auto lengths64 = std::array<uint8_t, 4>{1, 2, 4, 8};
+
+[[nodiscard]] auto code32(uint32_t val) -> uint8_t {
+    if (val < (1U << 8U)) {
+        return 0;
+    }
+    if (val < (1U << 16U)) {
+        return 1;
+    }
+    if (val < (1U << 24U)) {
+        return 2;
+    }
+    return 3;
+}
+
+[[nodiscard]] auto code64(uint64_t val) -> uint8_t {
+    if (val < (UINT64_C(1) << 8U)) {
+        return 0;
+    }
+    if (val < (UINT64_C(1) << 16U)) {
+        return 1;
+    }
+    if (val < (UINT64_C(1) << 32U)) {
+        return 2;
+    }
+    return 3;
+}
+
+template <typename T, typename CodeFn>
+void encode(T const* in, size_t count, std::string& out, CodeFn codeFn, std::array<uint8_t, 4> const& lengths) {
+    auto ctrlPos = out.size();
+    out.append(util::streamVByteNumControlBytes(count), '\0');
+    for (size_t i = 0; i < count; ++i) {
+        auto code = codeFn(in[i]);
+        out[ctrlPos + i / 4] = static_cast<char>(static_cast<uint8_t>(out[ctrlPos + i / 4]) | (code << (2 * (i % 4))));
+
+        // little endian, so the lowest bytes come first
+        out.append(reinterpret_cast<char const*>(&in[i]), lengths[code]);
+    }
+}
+
+[[noreturn]] void throwTruncated() {
+    throw std::runtime_error("Decoding error, stream vbyte data is truncated");
+}
+
+// scalar decoding of a single integer
+template <typename T>
+[[nodiscard]] auto decodeOne(char const*& data, char const* end, uint8_t code, std::array<uint8_t, 4> const& lengths) -> T {
+    if (end - data < lengths[code]) {
+        throwTruncated();
+    }
+    auto val = T();
+    std::memcpy(&val, data, lengths[code]);
+    data += lengths[code];
+    return val;
+}
+
+#ifdef __SSSE3__
+
+struct ShuffleTables32 {
+    std::array<std::array<uint8_t, 16>, 256> shuffle{};
+    std::array<uint8_t, 256> length{};
+};
+
+// for each control byte: shuffle mask that moves 4 integers with their lengths into 4x4 bytes. 0x80 sets a byte to zero.
+constexpr auto makeShuffleTables32() -> ShuffleTables32 {
+    auto tables = ShuffleTables32();
+    for (size_t ctrl = 0; ctrl < 256; ++ctrl) {
+        auto src = uint8_t();
+        for (size_t i = 0; i < 4; ++i) {
+            auto len = lengths32[(ctrl >> (2 * i)) & 3U];
+            for (size_t b = 0; b < 4; ++b) {
+                tables.shuffle[ctrl][i * 4 + b] = b < len ? src++ : 0x80;
+            }
+        }
+        tables.length[ctrl] = src;
+    }
+    return tables;
+}
+
+struct ShuffleTables64 {
+    std::array<std::array<uint8_t, 16>, 16> shuffle{};
+    std::array<uint8_t, 16> length{};
+};
+
+// for each 4 bit of a control byte: shuffle mask that moves 2 integers into 2x8 bytes.
+constexpr auto makeShuffleTables64() -> ShuffleTables64 {
+    auto tables = ShuffleTables64();
+    for (size_t ctrl = 0; ctrl < 16; ++ctrl) {
+        auto src = uint8_t();
+        for (size_t i = 0; i < 2; ++i) {
+            auto len = lengths64[(ctrl >> (2 * i)) & 3U];
+            for (size_t b = 0; b < 8; ++b) {
+                tables.shuffle[ctrl][i * 8 + b] = b < len ? src++ : 0x80;
+            }
+        }
+        tables.length[ctrl] = src;
+    }
+    return tables;
+}
+
+constexpr auto shuffleTables32 = makeShuffleTables32();
+constexpr auto shuffleTables64 = makeShuffleTables64();
+
+// decodes 4 integers
+inline void decode4x32(char const*& data, uint8_t ctrl, uint32_t* out) {
+    auto in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data));
+    auto shuffle = _mm_loadu_si128(reinterpret_cast<__m128i const*>(shuffleTables32.shuffle[ctrl].data()));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(in, shuffle));
+    data += shuffleTables32.length[ctrl];
+}
+
+// decodes 2 integers, ctrl has 4 bits
+inline void decode2x64(char const*& data, uint8_t ctrl, uint64_t* out) {
+    auto in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data));
+    auto shuffle = _mm_loadu_si128(reinterpret_cast<__m128i const*>(shuffleTables64.shuffle[ctrl].data()));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(in, shuffle));
+    data += shuffleTables64.length[ctrl];
+}
+
+#endif
+
+} // namespace
+
+namespace util {
+
+void streamVByteEncode32(uint32_t const* in, size_t count, std::string& out) {
+    encode(in, count, out, code32, lengths32);
+}
+
+void streamVByteEncode64(uint64_t const* in, size_t count, std::string& out) {
+    encode(in, count, out, code64, lengths64);
+}
+
+auto streamVByteDecode32(char const* ptr, char const* end, size_t count, uint32_t* out) -> char const* {
+    if (static_cast<size_t>(end - ptr) < streamVByteNumControlBytes(count)) {
+        throwTruncated();
+    }
+    auto const* ctrl = reinterpret_cast<uint8_t const*>(ptr);
+    auto const* data = ptr + streamVByteNumControlBytes(count);
+    auto i = size_t();
+
+#ifdef __SSSE3__
+    // each step reads at most 16 bytes
+    while (i + 4 <= count && end - data >= 16) {
+        decode4x32(data, ctrl[i / 4], out + i);
+        i += 4;
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = decodeOne<uint32_t>(data, end, (ctrl[i / 4] >> (2 * (i % 4))) & 3U, lengths32);
+    }
+    return data;
+}
+
+auto streamVByteDecode64(char const* ptr, char const* end, size_t count, uint64_t* out) -> char const* {
+    if (static_cast<size_t>(end - ptr) < streamVByteNumControlBytes(count)) {
+        throwTruncated();
+    }
+    auto const* ctrl = reinterpret_cast<uint8_t const*>(ptr);
+    auto const* data = ptr + streamVByteNumControlBytes(count);
+    auto i = size_t();
+
+#ifdef __SSSE3__
+    // each half of a control byte reads at most 16 bytes
+    while (i + 4 <= count && end - data >= 32) {
+        auto c = ctrl[i / 4];
+        decode2x64(data, c & 0xfU, out + i);
+        decode2x64(data, c >> 4U, out + i + 2);
+        i += 4;
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = decodeOne<uint64_t>(data, end, (ctrl[i / 4] >> (2 * (i % 4))) & 3U, lengths64);
+    }
+    return data;
+}
+
+} // namespace util
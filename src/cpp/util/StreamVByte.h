@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Stream VByte encoding, see https://arxiv.org/abs/1709.08990
+//
+// Integers are stored in two blocks: first all control bytes, then all data bytes. Each control byte has 2 bits for 4 integers,
+// which tell the number of bytes of the integer. Since the lengths are known up front, decoding needs no branch per integer and
+// can be done with SIMD shuffles.
+//
+// * 32bit: 2 bit code => 1, 2, 3 or 4 bytes
+// * 64bit: 2 bit code => 1, 2, 4 or 8 bytes
+namespace util {
+
+// number of control bytes for count integers
+[[nodiscard]] constexpr auto streamVByteNumControlBytes(size_t count) -> size_t {
+    return (count + 3) / 4;
+}
+
+// appends count integers to out
+void streamVByteEncode32(uint32_t const* in, size_t count, std::string& out);
+void streamVByteEncode64(uint64_t const* in, size_t count, std::string& out);
+
+// Decodes count integers from ptr into out, and returns pointer after the last data byte. Never reads at or past end; SIMD is
+// used as long as enough bytes are readable. Throws std::runtime_error when the data ends before all integers are decoded.
+[[nodiscard]] auto streamVByteDecode32(char const* ptr, char const* end, size_t count, uint32_t* out) -> char const*;
+[[nodiscard]] auto streamVByteDecode64(char const* ptr, char const* end, size_t count, uint64_t* out) -> char const*;
+
+} // namespace util
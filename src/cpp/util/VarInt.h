@@ -3,9 +3,14 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <istream>
 #include <string_view>
 
+#ifdef __BMI2__
+#    include <immintrin.h>
+#endif
+
 // Encodes & decodes varint, in LEB128 format. See https://en.wikipedia.org/wiki/LEB128
 //
 // each byte has 7 bit of contents, and the highest bit is 1. If highest bit is 0, this is the last byte of the int.
@@ -97,6 +102,81 @@ template <typename UT>
     return val;
 }
 
+// Same result as decodeUint, but reads 8 bytes at once and finds the terminating byte without a branch per byte. Needs 8 readable
+// bytes at ptr, otherwise (close to end) falls back to decodeUint. Also falls back for varints longer than 8 bytes.
+template <typename UT>
+[[nodiscard]] auto decodeUintFast(char const*& ptr, char const* end) -> UT {
+    static_assert(std::is_unsigned_v<UT>);
+    static constexpr auto maxBytes = (sizeof(UT) * 8 + 6) / 7;
+
+    if (end - ptr < 8) {
+        return decodeUint<UT>(ptr);
+    }
+
+    auto word = uint64_t();
+    std::memcpy(&word, ptr, sizeof(word));
+
+    // highest bit is 0 for the last byte
+    auto stopBits = ~word & UINT64_C(0x8080808080808080);
+    if (stopBits == 0) {
+        return decodeUint<UT>(ptr);
+    }
+    auto numBytes = static_cast<size_t>(__builtin_ctzll(stopBits) / 8 + 1);
+    if (numBytes > maxBytes) {
+        // not a valid encoding, decodeUint knows how to deal with that
+        return decodeUint<UT>(ptr);
+    }
+
+    // all bits up to and including the stop bit
+    auto bytes = word & (stopBits ^ (stopBits - 1));
+
+#ifdef __BMI2__
+    auto val = _pext_u64(bytes, UINT64_C(0x7f7f7f7f7f7f7f7f));
+#else
+    // compact 7 bit groups: 8x7 => 4x14 => 2x28 => 56 bits
+    auto val = bytes & UINT64_C(0x7f7f7f7f7f7f7f7f);
+    val = ((val & UINT64_C(0x7f007f007f007f00)) >> 1U) | (val & UINT64_C(0x007f007f007f007f));
+    val = ((val & UINT64_C(0x3fff00003fff0000)) >> 2U) | (val & UINT64_C(0x00003fff00003fff));
+    val = ((val & UINT64_C(0x0fffffff00000000)) >> 4U) | (val & UINT64_C(0x000000000fffffff));
+#endif
+
+    ptr += numBytes;
+    return static_cast<UT>(val);
+}
+
+// zigzag decoding of an unsigned value
+template <typename T>
+[[nodiscard]] constexpr auto zigzagDecode(std::make_unsigned_t<T> uVal) -> T {
+    return static_cast<T>((uVal >> 1U) ^ -(uVal & 1U));
+}
+
+// Batch decoding of a run of (amount_diff, block_diff) varint pairs, as written by ChangesInBlock::encode: amount diffs are
+// unsigned, and each one is followed by a zigzag block diff as long as the accumulated amount is <= 0.
+//
+// Decodes until end, or until maxCount amounts were decoded, and returns that count. blockDiffs is 0 where no block diff was
+// stored. amount is the accumulated amount, and is updated.
+[[nodiscard]] inline auto decodeAmountBlockDiffs(char const*& ptr,
+                                                 char const* end,
+                                                 int64_t& amount,
+                                                 uint64_t* amountDiffs,
+                                                 int64_t* blockDiffs,
+                                                 size_t maxCount) -> size_t {
+    auto count = size_t();
+    while (count < maxCount && ptr < end) {
+        auto amountDiff = decodeUintFast<uint64_t>(ptr, end);
+        amount += static_cast<int64_t>(amountDiff);
+        amountDiffs[count] = amountDiff;
+
+        auto blockDiff = int64_t();
+        if (amount <= 0) {
+            blockDiff = zigzagDecode<int64_t>(decodeUintFast<uint64_t>(ptr, end));
+        }
+        blockDiffs[count] = blockDiff;
+        ++count;
+    }
+    return count;
+}
+
 // writes varint into an internal buffer. Will be overwritten every call to encode()
 class VarInt {
     std::array<uint8_t, 10> mData{};
@@ -131,8 +211,18 @@ public:
         } else {
             // zig zag decode
             using UT = std::make_unsigned_t<T>;
-            auto uVal = decodeUint<UT>(ptr);
-            val = static_cast<T>((uVal >> 1U) ^ -(uVal & 1));
+            val = zigzagDecode<T>(decodeUint<UT>(ptr));
+        }
+    }
+
+    // Same as decode, but uses decodeUintFast
+    template <typename T>
+    static void decode(T& val, char const*& ptr, char const* end) {
+        if constexpr (std::is_unsigned_v<T>) {
+            val = decodeUintFast<T>(ptr, end);
+        } else {
+            using UT = std::make_unsigned_t<T>;
+            val = zigzagDecode<T>(decodeUintFast<UT>(ptr, end));
         }
     }
 };
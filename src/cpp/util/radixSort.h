@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// LSD radix sort, see https://en.wikipedia.org/wiki/Radix_sort#Least_significant_digit
+//
+// Each pass distributes the values by 11 bits of the key, so a 64 bit key needs 6 passes. Passes where all keys have the same
+// digit are skipped, so e.g. block heights < 4M need only 2 passes. The sort is stable, so sorting by multiple keys is done by
+// sorting by the least important key first.
+namespace util {
+
+namespace detail {
+
+static constexpr auto radixDigitBits = size_t(11);
+static constexpr auto radixNumBuckets = size_t(1) << radixDigitBits;
+
+// below that size insertion sort is faster than the histogram overhead
+static constexpr auto radixMinSize = size_t(64);
+
+} // namespace detail
+
+// Stable sort of data by the lowest numKeyBits (<= 64) of keyFn(value), which returns an unsigned integer. scratch is resized to
+// data's size; reuse it across calls so sorting does not need to allocate.
+template <typename T, typename KeyFn>
+void radixSort(std::vector<T>& data, std::vector<T>& scratch, size_t numKeyBits, KeyFn keyFn) {
+    using namespace detail;
+
+    auto const size = data.size();
+    if (size < radixMinSize) {
+        // stable insertion sort
+        for (size_t i = 1; i < size; ++i) {
+            auto val = std::move(data[i]);
+            auto key = keyFn(val);
+            auto j = i;
+            while (j > 0 && key < keyFn(data[j - 1])) {
+                data[j] = std::move(data[j - 1]);
+                --j;
+            }
+            data[j] = std::move(val);
+        }
+        return;
+    }
+
+    // histograms of all digits in one pass
+    static constexpr auto maxNumDigits = (64 + radixDigitBits - 1) / radixDigitBits;
+    auto numDigits = (numKeyBits + radixDigitBits - 1) / radixDigitBits;
+    std::array<std::array<uint32_t, radixNumBuckets>, maxNumDigits> histograms; // only the used digits are cleared
+    for (size_t d = 0; d < numDigits; ++d) {
+        histograms[d].fill(0);
+    }
+    for (auto const& val : data) {
+        auto key = static_cast<uint64_t>(keyFn(val));
+        for (size_t d = 0; d < numDigits; ++d) {
+            ++histograms[d][(key >> (d * radixDigitBits)) & (radixNumBuckets - 1)];
+        }
+    }
+
+    // every element is overwritten, the value does not matter
+    scratch.resize(size, data.front());
+    auto* src = &data;
+    auto* dst = &scratch;
+    for (size_t d = 0; d < numDigits; ++d) {
+        auto& histogram = histograms[d];
+        auto shift = d * radixDigitBits;
+        auto firstDigit = (static_cast<uint64_t>(keyFn((*src)[0])) >> shift) & (radixNumBuckets - 1);
+        if (histogram[firstDigit] == size) {
+            // all keys have the same digit, nothing to do
+            continue;
+        }
+
+        // bucket counts to bucket offsets
+        auto offset = uint32_t();
+        for (auto& count : histogram) {
+            offset += std::exchange(count, offset);
+        }
+        for (auto& val : *src) {
+            auto digit = (static_cast<uint64_t>(keyFn(val)) >> shift) & (radixNumBuckets - 1);
+            (*dst)[histogram[digit]++] = std::move(val);
+        }
+        std::swap(src, dst);
+    }
+
+    // the buffers are swapped, so both keep their capacity
+    if (src != &data) {
+        data.swap(scratch);
+    }
+}
+
+// Number of bits needed for keys up to maxKey, so that radixSort() does not need more passes than necessary
+[[nodiscard]] constexpr auto radixKeyBits(uint64_t maxKey) -> size_t {
+    auto numBits = size_t();
+    while (maxKey != 0) {
+        ++numBits;
+        maxKey >>= 1U;
+    }
+    return numBits;
+}
+
+// Sorts small arrays of e.g. vout numbers. scratch is only used for large arrays.
+inline void radixSort(std::vector<uint16_t>& data, std::vector<uint16_t>& scratch) {
+    radixSort(data, scratch, 16, [](uint16_t val) {
+        return val;
+    });
+}
+
+} // namespace util
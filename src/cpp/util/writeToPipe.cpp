@@ -0,0 +1,69 @@
+#include "writeToPipe.h"
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h> // vmsplice, F_GETPIPE_SZ, F_SETPIPE_SZ
+#include <sys/uio.h> // iovec
+#include <unistd.h> // write
+
+namespace {
+
+void writeAll(int fd, uint8_t const* data, size_t size) {
+    while (size != 0) {
+        auto numBytes = ::write(fd, data, size);
+        if (numBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(fmt::format("writeToPipe: write failed: {}", std::strerror(errno)));
+        }
+        data += numBytes;
+        size -= static_cast<size_t>(numBytes);
+    }
+}
+
+} // namespace
+
+namespace util {
+
+void writeToPipe(int fd, uint8_t const* data, size_t size) {
+#ifdef __linux__
+    // The pipe references spliced pages until the reader has copied them. So only the head is spliced, and the last pipeSize
+    // bytes are copied with write(). That completes only when the whole pipe is free for them, i.e. when the reader has consumed
+    // every spliced page. The kernel does the waiting, at the cost of copying one pipe buffer per call.
+    if (auto pipeSize = fcntl(fd, F_GETPIPE_SZ); pipeSize > 0 && size > static_cast<size_t>(pipeSize)) {
+        auto numToSplice = size - static_cast<size_t>(pipeSize);
+        while (numToSplice != 0) {
+            // vmsplice only reads the iovec
+            auto iov = iovec{const_cast<uint8_t*>(data), numToSplice};
+            auto numBytes = vmsplice(fd, &iov, 1, 0);
+            if (numBytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(fmt::format("writeToPipe: vmsplice failed: {}", std::strerror(errno)));
+            }
+            data += numBytes;
+            size -= static_cast<size_t>(numBytes);
+            numToSplice -= static_cast<size_t>(numBytes);
+        }
+    }
+#endif
+    writeAll(fd, data, size);
+}
+
+void growPipe(int fd) {
+#ifdef __linux__
+    auto maxSize = 0;
+    if (auto fin = std::ifstream("/proc/sys/fs/pipe-max-size"); fin >> maxSize) {
+        fcntl(fd, F_SETPIPE_SZ, maxSize);
+    }
+#endif
+}
+
+} // namespace util
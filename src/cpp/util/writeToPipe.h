@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+// Writes all data to fd. When fd is a pipe, on Linux the pages are handed to the pipe with vmsplice() instead of copying them
+// into the pipe's buffer, so the reader copies the data only once. Only the last pipe buffer's worth is copied with write(),
+// which blocks until the reader has consumed all spliced pages. So data can be changed as soon as this returns. Other files are
+// written with write().
+void writeToPipe(int fd, uint8_t const* data, size_t size);
+
+// Makes the pipe's buffer as large as the system allows, so fewer wakeups are needed per frame. Does nothing if that fails.
+void growPipe(int fd);
+
+} // namespace util